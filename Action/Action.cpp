@@ -5,120 +5,326 @@
  *  @brief Action.h implementation
  */
 
-#include <fcntl.h>
 #include <cassert>
+#include <sys/epoll.h>
 
 #include "Action.h"
 
 #include "ActionData.h"
+#include "ActionJournal.h"
+#include "ActionTracer.h"
+#include "ControlArbiter.h"
 #include "../Aircraft/FlightController.h"
 #include "../Aircraft/Watchdog.h"
+#include "../util/EventLoop.h"
 #include "../util/Log.h"
+#include "../util/timer.h"
 
 using namespace M210;
 
-pthread_mutex_t Action::mutex = PTHREAD_MUTEX_INITIALIZER;
-
 Action::Action() {
     flightController = nullptr;
-    // actionQueue is a blocking queue
-    actionQueueAttr.mq_flags = 0;
-    actionQueueAttr.mq_maxmsg = 10;
-    // Queue contains a pointer to an ActionData object
-    actionQueueAttr.mq_msgsize = sizeof(void*);
-    actionQueueAttr.mq_curmsgs = 0;
-    // Queue are files shared between programs, ensure that queue
-    // is empty at the beginning
-    mq_unlink(ACTION_QUEUE_NAME);
-    // Open queue
-    actionQueue = mq_open(ACTION_QUEUE_NAME, O_CREAT | O_RDWR,
-                    0666, &actionQueueAttr);
-    if(actionQueue == -1) {
-        int errsv = errno;  // save error code
-        DERROR("Action queue creation failed, error : %i", errsv);
-    }
+    arbiter = new ControlArbiter();
+    for(std::atomic<ActionData*> &slot : latestSetpoints)
+        slot.store(nullptr);
 }
 
 Action::~Action() {
-    mq_close(actionQueue);
-    mq_unlink(ACTION_QUEUE_NAME);
-}
-
-bool Action::add(const ActionData *actionData) {
-    pthread_mutex_lock(&mutex);
-    static struct timespec sendTimeout;
-    sendTimeout.tv_sec = 0;
-    sendTimeout.tv_nsec = 250000;
-    // mq_timedsend() behaves just like mq_send(), except that if the queue is full, sendTimeout specifies
-    // the time for which the call will block
-    int status = mq_timedsend(actionQueue, (const char *)&actionData, sizeof(void *), 1, &sendTimeout);
-    if(status == -1) {
-        int errsv = errno;  // save error code
-        DERROR("Action added to queue failed, error : %i", errsv);
+    delete arbiter;
+}
+
+void Action::setFlightController(FlightController *flightController) {
+    this->flightController = flightController;
+    executor.start("executorThread", runLongAction, this);
+}
+
+bool Action::add(ActionData *actionData) {
+    // new returns nullptr if ActionDataPool is full and rejects allocation
+    if(actionData == nullptr) {
+        DERROR("Action added to queue failed, no action data");
+        return false;
+    }
+    // Source without control lease, dropped before using a queue slot
+    if(!arbiter->admit(actionData)) {
         delete actionData;
-        pthread_mutex_unlock(&mutex);
         return false;
-    } else {
-        //DSTATUS("Action added to queue");
     }
-    pthread_mutex_unlock(&mutex);
+    // Setpoint becomes the latest one before being queued, so that
+    // consumer never sees it queued and not yet latest
+    int slot = coalescing.load() ? coalescingSlot(actionData) : -1;
+    if(slot >= 0)
+        latestSetpoints[slot].store(actionData);
+    // Action belongs to consumer once pushed, it is copied before
+    ActionJournal::Entry entry;
+    bool journaled = journaling.load(std::memory_order_relaxed) &&
+                     ActionJournal::instance().capture(actionData, entry);
+    ActionQueue::Lane lane = laneOf(actionData);
+    if(!actionQueue.push(actionData, lane)) {
+        DERROR("Action added to queue failed, %s lane is full", ActionQueue::laneName(lane));
+        // Slot must not keep a deleted action. Pending setpoint of the same
+        // type, if any, is then processed
+        ActionData *expected = actionData;
+        if(slot >= 0)
+            latestSetpoints[slot].compare_exchange_strong(expected, nullptr);
+        delete actionData;
+        return false;
+    }
+    if(journaled)
+        ActionJournal::instance().append(entry);
+    return true;
+}
+
+size_t Action::queuedCount() const {
+    size_t count = 0;
+    for(int lane = 0; lane < ActionQueue::LANE_COUNT; lane++)
+        count += actionQueue.count((ActionQueue::Lane)lane);
+    return count;
+}
+
+ActionQueue::Lane Action::laneOf(const ActionData *action) {
+    switch(action->getActionId()) {
+        case ActionData::ActionId::stopAircraft:
+        case ActionData::ActionId::emergencyStop:
+        case ActionData::ActionId::emergencyRelease:
+            return ActionQueue::SAFETY;
+        case ActionData::ActionId::takeOff:
+        case ActionData::ActionId::landing:
+        case ActionData::ActionId::mission:
+        case ActionData::ActionId::watchdog:
+        case ActionData::ActionId::obtainControlAuthority:
+            return ActionQueue::CONTROL;
+        default:
+            return ActionQueue::HOUSEKEEPING;
+    }
+}
+
+bool Action::isSuperseded(const ActionData *action) {
+    if(action->getSequence() < lastStopSequence) {
+        supersededCnt.fetch_add(1, std::memory_order_relaxed);
+        unsigned long skipped;
+        if(isDropReported(skipped))
+            LSTATUS("Movement dropped, aircraft stopped after it was sent (%lu more dropped)", skipped);
+        return true;
+    }
+    return false;
+}
+
+int Action::coalescingSlot(const ActionData *action) {
+    if(action->getActionId() != ActionData::ActionId::mission ||
+       action->getMissionTask() != MissionAction::START)
+        return -1;
+    switch(action->getMissionType()) {
+        case MissionType::VELOCITY:
+            return 0;
+        case MissionType::POSITION:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+bool Action::isCoalesced(const ActionData *action) {
+    int slot = coalescingSlot(action);
+    if(slot < 0)
+        return false;
+    // Actions of a slot share the same lane, a newer setpoint in slot
+    // is still queued behind this one. Slot is only compared, never
+    // dereferenced, and cleared before its setpoint is deleted
+    ActionData *latest = latestSetpoints[slot].load();
+    if(latest != nullptr && latest != action) {
+        coalescedCnt.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    ActionData *expected = const_cast<ActionData *>(action);
+    latestSetpoints[slot].compare_exchange_strong(expected, nullptr);
+    return false;
+}
+
+long long Action::timeToLiveMs(const ActionData *action) {
+    if(action->getActionId() != ActionData::ActionId::mission ||
+       action->getMissionTask() != MissionAction::START)
+        return 0;
+    switch(action->getMissionType()) {
+        case MissionType::VELOCITY:
+            return VELOCITY_TTL_MS;
+        case MissionType::POSITION:
+            return POSITION_TTL_MS;
+        case MissionType::POSITION_OFFSET:
+            return POSITION_OFFSET_TTL_MS;
+        default:
+            return 0;
+    }
+}
+
+bool Action::isExpired(const ActionData *action) {
+    long long ttl = timeToLiveMs(action);
+    if(ttl == 0)
+        return false;
+    long long ageMs = (getMonotonicNs() - action->getReceiveTime()) / 1000000;
+    if(ageMs > ttl) {
+        expiredCnt.fetch_add(1, std::memory_order_relaxed);
+        unsigned long skipped;
+        if(isDropReported(skipped))
+            LSTATUS("Movement dropped, received %lld ms ago (%lu more dropped)", ageMs, skipped);
+        return true;
+    }
+    return false;
+}
+
+bool Action::isDropReported(unsigned long &skipped) {
+    long long now = getMonotonicNs();
+    long long last = lastDropReport.load(std::memory_order_relaxed);
+    if(now - last < DROP_REPORT_PERIOD_MS * 1000000LL ||
+       !lastDropReport.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        unreportedDrops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    skipped = unreportedDrops.exchange(0, std::memory_order_relaxed);
     return true;
 }
 
-void Action::process() const {
-    if(flightController == nullptr) {
+bool Action::isLongAction(const ActionData *action) {
+    switch(action->getActionId()) {
+        case ActionData::ActionId::takeOff:
+        case ActionData::ActionId::landing:
+        case ActionData::ActionId::obtainControlAuthority:
+            return true;
+        case ActionData::ActionId::mission:
+            // All waypoints tasks wait for ACKs, they stay ordered in executor
+            return action->getMissionType() == MissionType::WAYPOINTS;
+        default:
+            return false;
+    }
+}
+
+bool Action::runLongAction(ActionData *action, const ActionToken &token, void *arg) {
+    auto self = (Action *) arg;
+    switch(action->getActionId()) {
+        case ActionData::ActionId::takeOff:
+            return self->flightController->takeOff(&token);
+        case ActionData::ActionId::landing:
+            return self->flightController->landing(&token);
+        case ActionData::ActionId::obtainControlAuthority:
+            return self->flightController->obtainCtrlAuthority(&token);
+        case ActionData::ActionId::mission:
+            return self->flightController->waypointsMissionAction(action->getMissionTask(), &token);
+        default:
+            LERROR("Unknown long action");
+            return false;
+    }
+}
+
+void Action::printStats() const {
+    actionQueue.printStats();
+    executor.printStats();
+    arbiter->printStats();
+    DSTATUS("Movements superseded by a stop : %lu", supersededCnt.load(std::memory_order_relaxed));
+    DSTATUS("Setpoints coalesced : %lu (coalescing %s)", coalescedCnt.load(std::memory_order_relaxed),
+            coalescing.load() ? "enabled" : "disabled");
+    DSTATUS("Movements expired : %lu", expiredCnt.load(std::memory_order_relaxed));
+    if(dryRun.load())
+        DSTATUS("Actions dispatched in dry-run : %lu", dryRunCnt.load(std::memory_order_relaxed));
+    if(flightController != nullptr) {
+        long long age = flightController->getSetpointAge();
+        if(age >= 0)
+            DSTATUS("Flown setpoint age : %lld ms", age / 1000000);
+        else
+            DSTATUS("Flown setpoint age : no setpoint flown");
+    }
+}
+
+void Action::process() {
+    if(flightController == nullptr && !dryRun.load()) {
         DERROR("Please call setFlightController() first");
         return;
     }
 
-    ActionData *action;
     // Blocking call, wait for data added in queue
-    int status = mq_receive(actionQueue, (char *)&action, sizeof(void *), NULL);
+    dispatch(actionQueue.pop());
+}
+
+void Action::processReady() {
+    if(flightController == nullptr && !dryRun.load()) {
+        DERROR("Please call setFlightController() first");
+        return;
+    }
+    ActionData *action;
+    while(actionQueue.tryPopOrArm(action))
+        dispatch(action);
+}
+
+void Action::shutdown() {
+    executor.stop();
+}
 
-    // Queue had a message, safety verification
-    if(status >= 0) {
+bool Action::attach(EventLoop &loop) {
+    if(!loop.add(actionQueue.getEventFd(), EPOLLIN, queueHandler, this))
+        return false;
+    // Empty queue, consumer is announced as sleeping
+    processReady();
+    return true;
+}
+
+void Action::queueHandler(int fd, uint32_t events, void *arg) {
+    (void)fd;
+    (void)events;
+    auto self = (Action *) arg;
+    self->actionQueue.clearWakeUp();
+    self->processReady();
+}
+
+void Action::dispatch(ActionData *action) {
+    // Safety verification
+    if(action != nullptr) {
+        // A newer setpoint of the same type is queued, only the newer is flown
+        if(isCoalesced(action) || isExpired(action)) {
+            delete action;
+            return;
+        }
+        ActionTracer::instance().dispatched(action);
+        if(dryRun.load(std::memory_order_relaxed)) {
+            dryRunCnt.fetch_add(1, std::memory_order_relaxed);
+            delete action;
+            return;
+        }
+        // Executor owns long actions, they are deleted once done
+        if(isLongAction(action)) {
+            if(executor.submit(action) == nullptr)
+                LERROR("Action rejected, executor is busy");
+            return;
+        }
         // Call desired action depending on action id
         switch(action->getActionId()) {
-            case ActionData::ActionId::takeOff:
-                flightController->takeOff();
-                break;
-            case ActionData::ActionId::landing:
-                flightController->landing();
-                break;
-            case ActionData::ActionId::mission: {
-                char mission;
-                // When action id is a mission, last byte indicates mission kind
+            case ActionData::ActionId::mission:
                 // Call dedicated mission function
-                if(action->popChar(mission)) {
-                    switch ((unsigned) mission){
-                        case MissionType::VELOCITY:         // Velocity mission
-                            velocityMission(action);
-                            break;
-                        case MissionType::POSITION :        // Position mission
-                            positionMission(action);
-                            break;
-                        case MissionType::POSITION_OFFSET:  // Position offset mission
-                            positionOffsetMission(action);
-                            break;
-                        case MissionType::WAYPOINTS:        // Waypoints mission
-                            waypointsMission(action);
-                            break;
-                        default:
-                            LERROR("Mission - Unknown mission kind");
-                            break;
-                    }
-                } else {
-                    LERROR("Mission - Unable to determine mission type");
+                switch (action->getMissionType()){
+                    case MissionType::VELOCITY:         // Velocity mission
+                        velocityMission(action);
+                        break;
+                    case MissionType::POSITION :        // Position mission
+                        positionMission(action);
+                        break;
+                    case MissionType::POSITION_OFFSET:  // Position offset mission
+                        positionOffsetMission(action);
+                        break;
+                    default:
+                        LERROR("Mission - Unknown mission kind");
+                        break;
                 }
-            }
                 break;
             case ActionData::ActionId::sendDataToMSDK:
                 // Not yet implemented by action queue
                 break;
             case ActionData::ActionId::stopAircraft:
+                // Movements added before the stop may still be queued in a
+                // lower priority lane, they are dropped when dequeued
+                lastStopSequence = action->getSequence();
+                executor.cancelBefore(lastStopSequence);
                 flightController->stopAircraft();
                 break;
             case ActionData::ActionId::emergencyStop:
+                lastStopSequence = action->getSequence();
+                executor.cancelBefore(lastStopSequence);
                 flightController->emergencyStop();
                 break;
             case ActionData::ActionId::emergencyRelease:
@@ -135,11 +341,6 @@ void Action::process() const {
                 flightController->sendDataToMSDK(reinterpret_cast<const uint8_t *>(hw), strlen(hw));
             }
                 break;
-            case ActionData::ActionId::obtainControlAuthority : {
-                // @todo blocking call, to replace
-                flightController->obtainCtrlAuthority();
-                break;
-            }
             default:
                 LERROR("Unknown action to process");
         }
@@ -147,88 +348,48 @@ void Action::process() const {
     }
 }
 
-void Action::velocityMission(ActionData *action) const {
-    char task;
-    Vector3f v;
-    float yaw;
-    // Last byte indicated mission task
-    if(action->popChar(task)) {
-        if(task == MissionAction::START) {
-            // Get parameters
-            bool b = true;
-            b &= action->popFloat(yaw);
-            b &= action->popVector3f(v);
-            // Only if all parameters have been recovered return true
-            if(b) {
-                flightController->moveByVelocity(&v, yaw);
-            } else {
-                LERROR("Velocity mission - Unable to get parameters");
-            }
-        } else {
-            LERROR("Velocity mission - Unknown task");
-        }
-    } else {
-        LERROR("Velocity mission - Unable to determine task");
-    }
-}
-
-void Action::positionMission(ActionData *action) const {
-    char task;
-    Vector3f v;
-    float yaw;
-    // Last byte indicated mission task
-    if(action->popChar(task)) {
-        if(task == MissionAction::START) {
-            // Get parameters
-            bool b = true;
-            b &= action->popFloat(yaw);
-            b &= action->popVector3f(v);
-            // Only if all parameters have been recovered return true
-            if(b) {
-                flightController->moveByPosition(&v, yaw);
-            } else {
-                LERROR("Position mission - Unable to get parameters");
-            }
+void Action::velocityMission(ActionData *action) {
+    if(action->getMissionTask() == MissionAction::START) {
+        // Get parameters
+        MovementPayload payload{};
+        if(action->decodeMission<VELOCITY>(payload)) {
+            if(!isSuperseded(action))
+                flightController->moveByVelocity(&payload.vector, payload.yaw, action->getReceiveTime());
         } else {
-            LERROR("Position mission - Unknown task");
+            LERROR("Velocity mission - Unable to get parameters");
         }
     } else {
-        LERROR("Position mission - Unable to determine task");
-    }
-}
-
-void Action::positionOffsetMission(ActionData *action) const {
-    char task;
-    Vector3f v;
-    float yaw;
-    // Last byte indicated mission task
-    if(action->popChar(task)) {
-        if(task == MissionAction::START) {
-            // Get parameters
-            bool b = true;
-            b &= action->popFloat(yaw);
-            b &= action->popVector3f(v);
-            // Only if all parameters have been recovered return true
-            if(b) {
-                flightController->moveByPositionOffset(&v, yaw);
-            } else {
-                LERROR("Position offset mission - Unable to get parameters");
-            }
+        LERROR("Velocity mission - Unknown task");
+    }
+}
+
+void Action::positionMission(ActionData *action) {
+    if(action->getMissionTask() == MissionAction::START) {
+        // Get parameters
+        MovementPayload payload{};
+        if(action->decodeMission<POSITION>(payload)) {
+            if(!isSuperseded(action))
+                flightController->moveByPosition(&payload.vector, payload.yaw, action->getReceiveTime());
         } else {
-            LERROR("Position offset mission - Unknown task");
+            LERROR("Position mission - Unable to get parameters");
         }
     } else {
-        LERROR("Position offset mission - Unable to determine task");
+        LERROR("Position mission - Unknown task");
     }
 }
 
-void Action::waypointsMission(ActionData *action) const {
-    char task;
-    // Last byte indicated mission task
-    if(action->popChar(task)) {
-        flightController->waypointsMissionAction((unsigned) task);
+void Action::positionOffsetMission(ActionData *action) {
+    if(action->getMissionTask() == MissionAction::START) {
+        // Get parameters
+        MovementPayload payload{};
+        if(action->decodeMission<POSITION_OFFSET>(payload)) {
+            if(!isSuperseded(action))
+                flightController->moveByPositionOffset(&payload.vector, payload.yaw, action->getReceiveTime());
+        } else {
+            LERROR("Position offset mission - Unable to get parameters");
+        }
     } else {
-        LERROR("waypoints mission - Unable to determine task");
+        LERROR("Position offset mission - Unknown task");
     }
 }
 
@@ -239,4 +400,41 @@ void Action::unitTest() {
     actionQueue = Action::instance().add(actionData);
 
     assert(actionQueue);
+
+    // Coalescing, only the last velocity setpoint is kept
+    Action action;
+    MovementPayload payload{};
+    ActionData *setpoints[3];
+    for(ActionData *&setpoint : setpoints)
+        setpoint = new ActionData(ActionData::ActionId::mission);
+    setpoints[0]->encodeMission<VELOCITY>(MissionAction::START, payload);
+    setpoints[1]->encodeMission<POSITION>(MissionAction::START, payload);
+    setpoints[2]->encodeMission<VELOCITY>(MissionAction::START, payload);
+    for(ActionData *setpoint : setpoints)
+        assert(action.add(setpoint));
+    for(ActionData *setpoint : setpoints) {
+        ActionData *dequeued = action.actionQueue.pop();
+        assert(dequeued == setpoint);
+        assert(action.isCoalesced(dequeued) == (dequeued == setpoints[0]));
+        delete dequeued;
+    }
+    assert(action.coalescedCnt.load() == 1);
+    for(std::atomic<ActionData*> &slot : action.latestSetpoints)
+        assert(slot.load() == nullptr);
+
+    // Time-to-live, a velocity received too long ago is dropped
+    ActionData velocity(ActionData::ActionId::mission);
+    velocity.encodeMission<VELOCITY>(MissionAction::START, payload);
+    assert(!action.isExpired(&velocity));
+    velocity.setReceiveTime(getMonotonicNs() - (VELOCITY_TTL_MS + 1) * 1000000LL);
+    assert(action.isExpired(&velocity));
+    assert(action.expiredCnt.load() == 1);
+
+    // Only the first drop of a period is sent to mobile, next ones are counted
+    assert(action.isExpired(&velocity) && action.isExpired(&velocity));
+    assert(action.unreportedDrops.load() == 2);
+    unsigned long skipped = 0;
+    action.lastDropReport.store(getMonotonicNs() - DROP_REPORT_PERIOD_MS * 1000000LL);
+    assert(action.isDropReported(skipped) && skipped == 2);
+    assert(action.unreportedDrops.load() == 0);
 }
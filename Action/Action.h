@@ -7,24 +7,44 @@
  *  Queue is filled on data reception from mobile SDK or console
  *  Queue is continuously processed in main
  *  Action are ActionData objects, see ActionData.h
- *  mqueue.h is used
+ *  Queue is an in-process lock-free ActionQueue, see ActionQueue.h
+ *  Long actions (take-off, landing, control authority, waypoints mission)
+ *  are given to an ActionExecutor so process never stalls, see ActionExecutor.h
+ *
+ *  When coalescing is enabled, a velocity or position setpoint replaces the
+ *  pending one of the same mission type : the replaced setpoint is dropped
+ *  when dequeued, so a burst of streamed setpoints does not add lag.
+ *
+ *  Movements have a time-to-live counted from their reception. A movement
+ *  dequeued after its time-to-live is dropped instead of being flown.
+ *
+ *  Actions moving the aircraft are only added if their source owns the
+ *  control lease, see ControlArbiter.h.
  */
 
 #ifndef MATRICE210_ACTION_H
 #define MATRICE210_ACTION_H
 
-#include <pthread.h>
-#include <mqueue.h>
+#include <atomic>
 
 #include <dji_vehicle.hpp>
 
-#define ACTION_QUEUE_NAME "/actionQueue"
+#include "ActionExecutor.h"
+#include "ActionQueue.h"
+
+#define COALESCING_SLOTS 2      /*!< Number of coalesced mission types (velocity, position) */
+#define VELOCITY_TTL_MS 300         /*!< Time-to-live of a velocity setpoint, mobile streams them [ms] */
+#define POSITION_TTL_MS 1000        /*!< Time-to-live of a position setpoint [ms] */
+#define POSITION_OFFSET_TTL_MS 1000 /*!< Time-to-live of a position offset [ms] */
+#define DROP_REPORT_PERIOD_MS 1000  /*!< Minimal time between two dropped movement messages sent to mobile [ms] */
 
 using namespace DJI::OSDK;
 
 namespace M210 {
     class FlightController;
     class ActionData;
+    class ControlArbiter;
+    class EventLoop;
 
     class Action : public Singleton<Action> {
     public:
@@ -45,38 +65,130 @@ namespace M210 {
             RESUME
         };
     private:
-        mqd_t actionQueue;              /*!< Action queue */
-        mq_attr actionQueueAttr;                /*!< Action queue attributes */
-        static pthread_mutex_t mutex;   /*!< Action queue mutex, mqueue are supposed to be protected but safety first */
+        ActionQueue actionQueue;                /*!< Action queue */
+        ActionExecutor executor;                /*!< Runs long actions */
+        ControlArbiter *arbiter;                /*!< Grants control lease to command sources */
         FlightController *flightController;     /*!< Flight controller concerned by the actions */
+        unsigned long lastStopSequence{0};      /*!< Sequence number of the last stop processed */
+        std::atomic<unsigned long> supersededCnt{0};  /*!< Movements dropped because a later stop was processed first */
+        std::atomic<ActionData*> latestSetpoints[COALESCING_SLOTS];  /*!< Last added setpoint not yet processed, by coalescing slot */
+        std::atomic<bool> coalescing{true};           /*!< Coalescing mode, see setCoalescing() */
+        std::atomic<unsigned long> coalescedCnt{0};   /*!< Setpoints dropped because a newer one was added */
+        std::atomic<unsigned long> expiredCnt{0};     /*!< Movements dropped because their time-to-live elapsed */
+        std::atomic<long long> lastDropReport{0};     /*!< Monotonic time of the last dropped movement message [ns] */
+        std::atomic<unsigned long> unreportedDrops{0};/*!< Movements dropped since the last message */
+        std::atomic<bool> dryRun{false};              /*!< Dry-run mode, see setDryRun() */
+        std::atomic<unsigned long> dryRunCnt{0};      /*!< Actions dispatched in dry-run mode */
+        std::atomic<bool> journaling{true};           /*!< Added actions are recorded by ActionJournal, see setJournaling() */
 
         /**
-         * Dedicated function when action is a position mission.
-         * Gets all parameters and calls FlightController method
-         * @param action ActionData pointer to get parameters
+         * Choose priority lane of an action
+         * @param action Action to add to queue
+         * @return Priority lane
          */
-        void positionMission(ActionData *action) const;
+        static ActionQueue::Lane laneOf(const ActionData *action);
 
         /**
-         * Dedicated function when action is a velocity mission.
+         * Verify if a movement has been added to queue before a stop that
+         * overtook it in a higher priority lane. Such a movement must not
+         * be flown
+         * @param action Movement action
+         * @return true if movement has to be dropped
+         */
+        bool isSuperseded(const ActionData *action);
+
+        /**
+         * Get coalescing slot of an action. Only velocity and position
+         * setpoints are coalesced, position offsets add up and are all kept
+         * @param action Action to add to queue
+         * @return Slot index, -1 if action is never coalesced
+         */
+        static int coalescingSlot(const ActionData *action);
+
+        /**
+         * Verify if a setpoint has been replaced by a newer one of the
+         * same mission type. Called on each dequeued setpoint, whatever the
+         * coalescing mode, so that slots never point to a deleted action
+         * @param action Setpoint action
+         * @return true if setpoint has to be dropped
+         */
+        bool isCoalesced(const ActionData *action);
+
+        /**
+         * Time-to-live of an action, counted from its reception
+         * @param action Action to process
+         * @return Time-to-live [ms], 0 if action never expires
+         */
+        static long long timeToLiveMs(const ActionData *action);
+
+        /**
+         * Verify if a movement has been received more than its time-to-live ago.
+         * Such a movement must not be flown
+         * @param action Action to process
+         * @return true if action has to be dropped
+         */
+        bool isExpired(const ActionData *action);
+
+        /**
+         * Limit dropped movement messages to one per DROP_REPORT_PERIOD_MS,
+         * so that a stream of stale setpoints does not flood mobile link
+         * @param skipped Movements dropped without message since the last one
+         * @return true if drop has to be reported, false if it is only counted
+         */
+        bool isDropReported(unsigned long &skipped);
+
+        /**
+         * Verify if an action waits for the aircraft during seconds
+         * and has to be run by executor
+         * @param action Action to process
+         * @return true if action is run by executor
+         */
+        static bool isLongAction(const ActionData *action);
+
+        /**
+         * Executor job routine, calls blocking FlightController methods
+         * @param action Long action to run
+         * @param token Cancelled when aircraft is stopped
+         * @param arg Action instance
+         * @return true if action succeeded
+         */
+        static bool runLongAction(ActionData *action, const ActionToken &token, void *arg);
+
+        /**
+         * Drop, execute or give to executor a dequeued action.
+         * Action is deleted once processed
+         * @param action Dequeued action
+         */
+        void dispatch(ActionData *action);
+
+        /**
+         * Event loop handler, processes all queued actions
+         * @param fd Action queue eventfd
+         * @param events Ready events
+         * @param arg Action instance
+         */
+        static void queueHandler(int fd, uint32_t events, void *arg);
+
+        /**
+         * Dedicated function when action is a position mission.
          * Gets all parameters and calls FlightController method
          * @param action ActionData pointer to get parameters
          */
-        void velocityMission(ActionData *action) const;
+        void positionMission(ActionData *action);
 
         /**
-         * Dedicated function when action is a position offset mission.
+         * Dedicated function when action is a velocity mission.
          * Gets all parameters and calls FlightController method
          * @param action ActionData pointer to get parameters
          */
-        void positionOffsetMission(ActionData *action) const;
+        void velocityMission(ActionData *action);
 
         /**
-         * Dedicated function when action is a waypoints mission.
+         * Dedicated function when action is a position offset mission.
          * Gets all parameters and calls FlightController method
          * @param action ActionData pointer to get parameters
          */
-        void waypointsMission(ActionData *action) const;
+        void positionOffsetMission(ActionData *action);
 
     public:
         /**
@@ -84,27 +196,99 @@ namespace M210 {
          */
         Action();
 
-        /**
-         * Close action queue and unlink it.
-         */
         ~Action();
+
         /**
          * Define the FlightController to whom the action should be transmitted
+         * and launch executor thread
          * @param flightController Pointer to used FlightController
          */
-        void setFlightController(FlightController *flightController) { this->flightController = flightController; }
+        void setFlightController(FlightController *flightController);
 
         /**
-         * Add action data to queue
+         * Add action data to queue. Never blocks, can be called from
+         * any thread. Action data is deleted if queue is full or if its
+         * source does not own the control lease
          * @param actionData Pointer to ActionData object to add
          * @return true if action data has been added to queue, false otherwise
          */
-        bool add(const ActionData *actionData);
+        bool add(ActionData *actionData);
+
+        /**
+         * Control lease arbitration, used to set priorities and lease duration
+         * @return Arbiter used by add()
+         */
+        ControlArbiter &getArbiter() { return *arbiter; }
+
+        /**
+         * Enable or disable coalescing mode. When enabled, a velocity or position
+         * setpoint replaces the pending one of the same mission type
+         * @param enable Coalescing mode
+         */
+        void setCoalescing(bool enable) { coalescing.store(enable); }
+
+        bool isCoalescing() const { return coalescing.load(); }
+
+        /**
+         * Enable or disable dry-run mode. In dry-run mode, actions go through
+         * the whole pipeline but are not given to FlightController, so
+         * no aircraft is needed. Used to replay a journal
+         * @param enable Dry-run mode
+         */
+        void setDryRun(bool enable) { dryRun.store(enable); }
+
+        bool isDryRun() const { return dryRun.load(); }
+
+        /**
+         * Enable or disable recording of added actions by ActionJournal.
+         * Disabled on benchmark instances, so that their synthetic actions
+         * never reach the flight journal
+         * @param enable Journaling state
+         */
+        void setJournaling(bool enable) { journaling.store(enable); }
+
+        /**
+         * Approximate number of actions waiting in action queue
+         * @return Number of actions, all lanes
+         */
+        size_t queuedCount() const;
 
         /**
          *  Receive message from queue a process it. Blocking call.
+         *  Must always be called from the same thread
+         */
+        void process();
+
+        /**
+         * Process all queued actions without waiting. Must always be
+         * called from the same thread
+         */
+        void processReady();
+
+        /**
+         * Make a waiting process() return without action, used to
+         * end the action loop. Never blocks, can be called from any thread
+         */
+        void interrupt() { actionQueue.interrupt(); }
+
+        /**
+         * Cancel long actions and stop executor thread, at most
+         * THREAD_JOIN_TIMEOUT_MS. Called once action loop has ended
+         */
+        void shutdown();
+
+        /**
+         * Process action queue from event loop instead of calling
+         * process() continuously
+         * @param loop Event loop of the single-threaded runtime
+         * @return false if action queue cannot be watched
+         */
+        bool attach(EventLoop &loop);
+
+        /**
+         * Display action queue and executor counters on console
          */
-        void process() const;
+        void printStats() const;
 
         /**
          * Unit test to check that class is working. Called at the
@@ -7,158 +7,234 @@
 
 #include "ActionData.h"
 
+#include "ActionDataPool.h"
+
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <cstddef>
+#include <pthread.h>
 
-using namespace M210;
-
-pthread_mutex_t ActionData::mutex = PTHREAD_MUTEX_INITIALIZER;
-
-ActionData::ActionData(ActionId actionId, size_t size) {
-    this->actionId = actionId;
-    this->dataSize = size;
-    this->dataPosCnt = 0;
-    this->dataPtr = nullptr;
-    if(size > 0)
-        dataPtr = new char[size];
-}
-
-ActionData::~ActionData() {
-    delete[] dataPtr;
-}
-
-bool ActionData::checkSize(size_t size) const{
-    return (dataPosCnt + size <= dataSize);
-}
+#include "../Managers/ThreadManager.h"
+#include "../util/timer.h"
 
-bool ActionData::push(char c) {
-    _push(&c, char);
-}
+#define BENCHMARK_THREADS 3
+#define BENCHMARK_ITERATIONS 20000
+#define BENCHMARK_OPERATIONS 2  /*!< encode and decode operations in one iteration */
 
-bool ActionData::push(int i) {
-    _push(&i, int);
-}
-
-bool ActionData::push(unsigned u) {
-    _push(&u, unsigned);
-}
-
-bool ActionData::push(float f) {
-    _push(&f, float);
-}
-
-bool ActionData::push(const Telemetry::Vector3f &v) {
-    _push(&v, Telemetry::Vector3f);
-}
-
-bool ActionData::push(const uint8_t *data, size_t length) {
-    __push(data, length);
-}
+using namespace M210;
 
-bool ActionData::popChar(char &c) {
-    _pop(c, char);
+ActionData::ActionData(ActionId actionId, Source source) {
+    this->actionId = actionId;
+    this->source = source;
+    this->receiveTime = getMonotonicNs();
+    this->sequence = 0;
+    this->enqueueTime = 0;
+    this->dequeueTime = 0;
+    this->missionType = 0;
+    this->missionTask = 0;
+    this->payloadSize = 0;
 }
 
-bool ActionData::popInt(int &i) {
-    _pop(i, int);
+const char *ActionData::getActionName(ActionId actionId) {
+    switch(actionId) {
+        case takeOff:
+            return "takeOff";
+        case landing:
+            return "landing";
+        case mission:
+            return "mission";
+        case sendDataToMSDK:
+            return "sendDataToMSDK";
+        case stopAircraft:
+            return "stopAircraft";
+        case emergencyStop:
+            return "emergencyStop";
+        case emergencyRelease:
+            return "emergencyRelease";
+        case watchdog:
+            return "watchdog";
+        case obtainControlAuthority:
+            return "obtainCtrlAuthority";
+        case helloWorld:
+            return "helloWorld";
+        default:
+            return "unknown";
+    }
 }
 
-bool ActionData::popUnsigned(unsigned &u) {
-    _pop(u, unsigned);
+void *ActionData::operator new(size_t size) noexcept {
+    return ActionDataPool::instance().allocate(size);
 }
 
-bool ActionData::popFloat(float &f) {
-    _pop(f, float);
+void ActionData::operator delete(void *ptr) noexcept {
+    ActionDataPool::instance().deallocate(ptr);
 }
 
-bool ActionData::popVector3f(Telemetry::Vector3f &v) {
-    _pop(v, Telemetry::Vector3f);
+bool ActionData::encodeMission(unsigned type, unsigned task, const uint8_t *data, size_t length) {
+    missionType = type;
+    missionTask = task;
+    // Mission layout is selected at runtime, size is known at compile time
+    switch(type) {
+        case Action::MissionType::VELOCITY:
+            return encodeRaw<MissionLayout<Action::VELOCITY>::type>(data, length);
+        case Action::MissionType::POSITION:
+            return encodeRaw<MissionLayout<Action::POSITION>::type>(data, length);
+        case Action::MissionType::POSITION_OFFSET:
+            return encodeRaw<MissionLayout<Action::POSITION_OFFSET>::type>(data, length);
+        case Action::MissionType::WAYPOINTS:
+            return encodeRaw<MissionLayout<Action::WAYPOINTS>::type>(data, length);
+        default:
+            DERROR("Unable to encode unknown mission type %u", type);
+            return false;
+    }
 }
 
 void ActionData::unitTest() {
-    char c = 'k';
-    int i = -25178;
-    unsigned u = 5891;
     float x = 2.52;
     float y = 5.17;
     float z = 78.35;
     float yaw = 45.25;
 
-    M210::ActionData::ActionId id = M210::ActionData::ActionId::stopAircraft;
-    // Allocate dynamic memory
-    ActionData ad(id, sizeof(uint8_t) + sizeof(float) * 4);
-    ad.push(c);
-    /*/ Push float array
-    auto ch = new char[16];
-    memcpy(ch, reinterpret_cast<char*>(&x), 4);
-    memcpy(ch+4, reinterpret_cast<char*>(&y), 4);
-    memcpy(ch+8, reinterpret_cast<char*>(&z), 4);
-    memcpy(ch+12, reinterpret_cast<char*>(&yaw), 4);
-    ad.push(reinterpret_cast<uint8_t*>(ch), 16);
-    //*/
-
-    // Push float 1 by 1
-    ad.push(x);
-    ad.push(y);
-    ad.push(z);
-    ad.push(yaw);
-    //*/
-
-    // Try to push i, has to return false
-    // because memory allocation was to small
-    bool push = ad.push(i);
-
-    // Try to get all data back
-    // /!\ Lifo !
-    M210::ActionData::ActionId id2 = ad.getActionId();
-    int i2 = 0;
-    unsigned u2 = 0;
-    char c2 = 0;
-    float x2 = 0, y2 = 0, z2 = 0, yaw2 = 0;
-    Telemetry::Vector3f v2;
-
-    ad.popFloat(yaw2);
-    ad.popFloat(z2);
-    ad.popFloat(y2);
-    ad.popFloat(x2);
-
-    // Get Vector3f instead of three float
-    ad.push(x);
-    ad.push(y);
-    ad.push(z);
-    ad.popVector3f(v2);
-
-    ad.popChar(c2);
-
-    // Push and instant pop data
-    ad.push(i);
-    ad.push(u);
-
-    ad.popUnsigned(u2);
-    ad.popInt(i2);
-
-    // Try to pop char, has to return false
-    // because all data have been popped
-    char c3;
-    bool pop = ad.popChar(c3);
-    //*/
+    // Typed mission
+    ActionData ad(ActionData::ActionId::mission);
+    MovementPayload sent{{x, y, z}, yaw};
+    bool encoded = ad.encodeMission<Action::POSITION_OFFSET>(Action::MissionAction::START, sent);
+    MovementPayload received{};
+    bool decoded = ad.decodeMission<Action::POSITION_OFFSET>(received);
+
+    // Same layout but another mission type, has to return false
+    MovementPayload wrongType{};
+    bool decodedWrongType = ad.decodeMission<Action::VELOCITY>(wrongType);
+
+    // Raw mobile frame parameters : x, y, z, yaw
+    float frame[] = {x, y, z, yaw};
+    ActionData raw(ActionData::ActionId::mission);
+    bool rawEncoded = raw.encodeMission(Action::MissionType::VELOCITY, Action::MissionAction::START,
+                                        reinterpret_cast<uint8_t *>(frame), sizeof(frame));
+    MovementPayload rawReceived{};
+    bool rawDecoded = raw.decodeMission<Action::VELOCITY>(rawReceived);
+
+    // Raw frame too short, has to return false
+    ActionData shortRaw(ActionData::ActionId::mission);
+    bool shortEncoded = shortRaw.encodeMission(Action::MissionType::VELOCITY, Action::MissionAction::START,
+                                               reinterpret_cast<uint8_t *>(frame), sizeof(frame) - 1);
+
+    // Raw frame with trailing padding, extra bytes are ignored
+    float paddedFrame[] = {x, y, z, yaw, 0.0f};
+    ActionData padded(ActionData::ActionId::mission);
+    bool paddedEncoded = padded.encodeMission(Action::MissionType::VELOCITY, Action::MissionAction::START,
+                                              reinterpret_cast<uint8_t *>(paddedFrame), sizeof(paddedFrame));
+    MovementPayload paddedReceived{};
+    bool paddedDecoded = padded.decodeMission<Action::VELOCITY>(paddedReceived);
+
+    // Mission without parameters
+    ActionData waypoints(ActionData::ActionId::mission);
+    bool waypointsEncoded = waypoints.encodeMission<Action::WAYPOINTS>(Action::MissionAction::ADD);
+    NoPayload none{};
+    bool waypointsDecoded = waypoints.decodeMission<Action::WAYPOINTS>(none);
 
     // Verify that all data recovered are identical to initials ones
-    //assert(!push);
-    assert(id == id2);
-    assert(yaw == yaw2);
-    assert(z == z2);
-    assert(y == y2);
-    assert(x == x2);
-    assert(x == v2.x);
-    assert(y == v2.y);
-    assert(z == v2.z);
-    assert(c == c2);
-    assert(u == u2);
-    assert(i == i2);
-    assert(!pop);
+    assert(ad.getActionId() == ActionData::ActionId::mission);
+    assert(ad.getReceiveTime() > 0 && ad.getReceiveTime() <= getMonotonicNs());
+    assert(encoded);
+    assert(decoded);
+    assert(ad.getMissionType() == Action::MissionType::POSITION_OFFSET);
+    assert(ad.getMissionTask() == Action::MissionAction::START);
+    assert(received.vector.x == x);
+    assert(received.vector.y == y);
+    assert(received.vector.z == z);
+    assert(received.yaw == yaw);
+    assert(!decodedWrongType);
+    assert(rawEncoded);
+    assert(rawDecoded);
+    assert(rawReceived.vector.x == x);
+    assert(rawReceived.vector.y == y);
+    assert(rawReceived.vector.z == z);
+    assert(rawReceived.yaw == yaw);
+    assert(!shortEncoded);
+    assert(paddedEncoded && paddedDecoded);
+    assert(paddedReceived.yaw == yaw && paddedReceived.vector.x == x);
+    assert(waypointsEncoded);
+    assert(waypointsDecoded);
+    assert(waypoints.getMissionTask() == Action::MissionAction::ADD);
 
     DSTATUS("ActionData test passed");
     DERROR("Please do not pay attention to the last two errors if ActionData test passed");
-}
\ No newline at end of file
+}
+
+namespace {
+    pthread_mutex_t benchmarkMutex = PTHREAD_MUTEX_INITIALIZER;  /*!< Emulates previous process-wide mutex */
+    std::atomic<bool> benchmarkStart;   /*!< Released when all threads are created */
+
+    /**
+     * Lock process-wide mutex if previous implementation is emulated
+     * @param globalLock Previous implementation emulated
+     */
+    inline void benchmarkLock(bool globalLock) {
+        if(globalLock)
+            pthread_mutex_lock(&benchmarkMutex);
+    }
+
+    inline void benchmarkUnlock(bool globalLock) {
+        if(globalLock)
+            pthread_mutex_unlock(&benchmarkMutex);
+    }
+
+    /**
+     * Build and decode a mission, as Console/Mobile and Action::process do
+     * @param param bool* indicating if previous implementation is emulated
+     * @return -
+     */
+    void *benchmarkProducer(void *param) {
+        bool globalLock = *static_cast<bool*>(param);
+        Telemetry::Vector3f v{1.0, 2.0, 3.0};
+        float yaw = 4.0;
+        while(!benchmarkStart.load())
+            sched_yield();
+        for(int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+            ActionData ad(ActionData::ActionId::mission);
+            MovementPayload payload{v, yaw};
+            benchmarkLock(globalLock);
+            ad.encodeMission<Action::VELOCITY>(Action::MissionAction::START, payload);
+            benchmarkUnlock(globalLock);
+            benchmarkLock(globalLock);
+            ad.decodeMission<Action::VELOCITY>(payload);
+            benchmarkUnlock(globalLock);
+            v = payload.vector;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Run producers and return mean duration of one operation
+     * @param globalLock Emulate previous process-wide mutex
+     * @return Mean operation duration [ns], -1 if threads cannot be created
+     */
+    double benchmarkRun(bool globalLock) {
+        pthread_t threadID[BENCHMARK_THREADS];
+        pthread_attr_t threadAttr[BENCHMARK_THREADS];
+        benchmarkStart.store(false);
+        int started = 0;
+        for(int i = 0; i < BENCHMARK_THREADS; i++) {
+            if(ThreadManager::start("adBenchmark", &threadID[i], &threadAttr[i],
+                                    benchmarkProducer, &globalLock))
+                started++;
+        }
+        long long startTime = getMonotonicNs();
+        benchmarkStart.store(true);
+        for(int i = 0; i < started; i++)
+            pthread_join(threadID[i], nullptr);
+        long long elapsed = getMonotonicNs() - startTime;
+        if(started != BENCHMARK_THREADS)
+            return -1;
+        return (double)elapsed / (BENCHMARK_THREADS * BENCHMARK_ITERATIONS * BENCHMARK_OPERATIONS);
+    }
+}
+
+void ActionData::benchmark() {
+    double before = benchmarkRun(true);
+    double after = benchmarkRun(false);
+    DSTATUS("ActionData encode/decode, %d threads : %.1f ns/op with process-wide mutex, %.1f ns/op without",
+            BENCHMARK_THREADS, before, after);
+}
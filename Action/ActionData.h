@@ -3,81 +3,34 @@
  *  @date Jul 20 2018
  *  @author Jonathan Michel
  *  @brief ActionData objects are added in Action queue (Action.h)
- *  The goal is to provide an object with variable data size.
+ *  The goal is to provide an object carrying the parameters of an action.
  *
- *  It is useful because all actions doesn't need the same amount of
- *  data.
- *  On object creation, dynamic memory is allocated. Size depends of user
- *  need. Data can next be pushed (not all type are yet supported,
- *  only main ones). Then, data can be recovered with pop method.
- *  /!\ Push/Pop methods works as a lifo, last pushed value will be first
- *  popped
+ *  Mission actions carry their mission type, their mission task and a
+ *  payload whose layout is declared once by mission type in ActionMessage.h.
+ *  Payload is encoded and decoded as a whole with a single bounds-checked
+ *  copy, layout is checked at compile time by encodeMission() and
+ *  decodeMission(). Raw mobile frames are checked against the same layouts
+ *  at runtime.
+ *  Data is stored in a buffer inside the object, objects created with new
+ *  come from ActionDataPool so no heap allocation is done.
+ *  An object is owned by one thread at a time and is not locked: it is
+ *  filled by its creator, then Action::add() gives it to the action queue
+ *  which publishes it to Action::process(). Creator must not use it after
+ *  Action::add()
  *  Example of use in unitTest() method
  */
 
 #ifndef MATRICE210_ACTIONDATA_H
 #define MATRICE210_ACTIONDATA_H
 
-#include <pthread.h>
+#include <cstring>
+#include <type_traits>
 
 #include <dji_vehicle.hpp>
 
-/**
- * Copy data to allocated dynamic memory
- * @param _data_ Pointer to data to copy
- * @param _length_ Length of data to copy [bytes]
- * @return False if there is not enough memory allocated, true otherwise
- */
-#define __push(_data_, _length_)                        \
-{                                                       \
-    pthread_mutex_lock(&mutex);                         \
-    /* Copy data in dynamic memory allocated if there */\
-    /* is enough place                                */\
-    auto ptr = reinterpret_cast<const char *>(_data_);  \
-    if(!checkSize(_length_)) {                          \
-        DERROR("Unable to push data");                  \
-        pthread_mutex_unlock(&mutex);                   \
-        return false;                                   \
-    }                                                   \
-    memcpy(dataPtr + dataPosCnt, ptr, _length_);        \
-    dataPosCnt += (_length_);                             \
-    pthread_mutex_unlock(&mutex);                       \
-    return true;                                        \
-}
-
-/**
- * Copy data to allocated dynamic memory
- * @param _data_ Pointer to data to copy
- * @param _type_ Type of data to copy
- * @return False if there is not enough memory allocated, true otherwise
- */
-#define _push(_data_, _type_)           \
-{                                       \
-    __push(_data_, sizeof(_type_));     \
-}
+#include "ActionMessage.h"
 
-/**
- * Read data from dynamic memory
- * @param _data_ Pointer to data where write result
- * @param _type_ Type of data to read
- * @return False if there is no more data to read in allocated dynamic memory, true otherwise
- */
-#define _pop(_data_, _type_)                        \
-{                                                   \
-    pthread_mutex_lock(&mutex);                     \
-    /* Pop data from dynamic memory allocated if */ \
-    /* there is remaining data                   */ \
-    size_t length = sizeof(_type_);                 \
-    if(dataPosCnt < length) {                       \
-        DERROR("Unable to pop %s", #_type_);        \
-        pthread_mutex_unlock(&mutex);               \
-        return false;                               \
-    }                                               \
-    dataPosCnt -= length;                           \
-    memcpy(&(_data_), dataPtr + dataPosCnt, length);  \
-    pthread_mutex_unlock(&mutex);                   \
-    return true;                                    \
-}
+#define ACTION_DATA_PAYLOAD_SIZE 128  /*!< Size of the data buffer included in each object [bytes] */
 
 using namespace DJI::OSDK;
 
@@ -95,33 +48,103 @@ namespace M210 {
             emergencyRelease,
             watchdog,
             obtainControlAuthority,
-            helloWorld
+            helloWorld,
+            actionIdCount   /*!< Number of action ids, not an action */
+        };
+        enum Source {       /*!< Where action comes from */
+            INTERNAL,
+            MOBILE,
+            CONSOLE,
+            UART,
+            REPLAY,
+            sourceCount     /*!< Number of sources, not a source */
         };
     private:
-        char *dataPtr;      /*!< Pointer to dynamic memory allocated */
-        size_t dataPosCnt;  /*!< Current numbers of bytes used */
-        size_t dataSize;    /*!< Size allocated in dynamic memory [bytes] */
         ActionId actionId;  /*!< Action id concerned by current action data */
-        static pthread_mutex_t mutex; /*!< Mutex to ensure dynamic memory operations */
+        Source source;      /*!< Where action comes from */
+        long long receiveTime;  /*!< Monotonic time action has been created, on data reception [ns] */
+        unsigned long sequence; /*!< Number given by action queue, increases with each added action */
+        long long enqueueTime;  /*!< Monotonic time action has been added to action queue [ns] */
+        long long dequeueTime;  /*!< Monotonic time action has been removed from action queue [ns] */
+        unsigned missionType;   /*!< Action::MissionType value, 0 if action is not a mission */
+        unsigned missionTask;   /*!< Action::MissionAction value, 0 if action is not a mission */
+        size_t payloadSize;     /*!< Numbers of payload bytes used */
+        char payload[ACTION_DATA_PAYLOAD_SIZE]; /*!< Data memory included in object */
 
         /**
-         * Check if enough place has been allocated to copy data
-         * @param size Size of data to copy [bytes]
-         * @return True if enough place is available
+         * Copy payload in object
+         * @param data Payload to copy
+         * @return Always true, payload size is checked at compile time
          */
-        bool checkSize(size_t size) const;
+        template <typename T>
+        bool encode(const T &data) {
+            static_assert(std::is_trivially_copyable<T>::value, "Payload must be a POD structure");
+            static_assert(PayloadSize<T>::value <= ACTION_DATA_PAYLOAD_SIZE, "Payload is too big");
+            memcpy(payload, &data, PayloadSize<T>::value);
+            payloadSize = PayloadSize<T>::value;
+            return true;
+        }
+
+        /**
+         * Copy payload from object
+         * @param data Copied payload
+         * @return False if stored payload size does not match T, true otherwise
+         */
+        template <typename T>
+        bool decode(T &data) const {
+            static_assert(std::is_trivially_copyable<T>::value, "Payload must be a POD structure");
+            if(payloadSize != PayloadSize<T>::value) {
+                DERROR("Unable to decode payload, %u bytes stored, %u bytes expected",
+                       (unsigned)payloadSize, (unsigned)PayloadSize<T>::value);
+                return false;
+            }
+            memcpy(&data, payload, PayloadSize<T>::value);
+            return true;
+        }
+
+        /**
+         * Copy raw data in object if length matches T
+         * @param data Raw data
+         * @param length Raw data length [bytes]
+         * @return False if length does not match T, true otherwise
+         */
+        template <typename T>
+        bool encodeRaw(const uint8_t *data, size_t length) {
+            static_assert(PayloadSize<T>::value <= ACTION_DATA_PAYLOAD_SIZE, "Payload is too big");
+            if(length < PayloadSize<T>::value) {
+                DERROR("Unable to encode payload, %u bytes received, %u bytes expected",
+                       (unsigned)length, (unsigned)PayloadSize<T>::value);
+                return false;
+            }
+            // Trailing padding of the frame is ignored
+            memcpy(payload, data, PayloadSize<T>::value);
+            payloadSize = PayloadSize<T>::value;
+            return true;
+        }
     public:
         /**
-         * Allocate dynamic memory for specified action
+         * Create action without parameters, stamped with its receive time
          * @param actionId Action id concerned by current action data
-         * @param size Size to allocate in dynamic memory [bytes]
+         * @param source Where action comes from
          */
-        explicit ActionData(ActionId actionId, size_t size = 0);
+        explicit ActionData(ActionId actionId, Source source = INTERNAL);
+
+        ActionData(const ActionData &) = delete;
+        ActionData &operator=(const ActionData &) = delete;
 
         /**
-         * Delete dynamic memory allocated
+         * Get object memory from ActionDataPool
+         * @param size Object size [bytes]
+         * @return Object memory, nullptr if pool is full and overflow
+         * policy is ActionDataPool::REJECT. new then returns nullptr
          */
-        ~ActionData();
+        static void *operator new(size_t size) noexcept;
+
+        /**
+         * Give object memory back to ActionDataPool
+         * @param ptr Object memory
+         */
+        static void operator delete(void *ptr) noexcept;
 
         /**
          * Return action id concerned by current action data
@@ -129,37 +152,151 @@ namespace M210 {
          */
         ActionId getActionId() const { return actionId; }
 
+        Source getSource() const { return source; }
+
+        /**
+         * Stored payload, used to save action
+         * @return Payload bytes, getPayloadSize() bytes are used
+         */
+        const char *getPayload() const { return payload; }
+
+        size_t getPayloadSize() const { return payloadSize; }
+
+        /**
+         * Action id name, used to display statistics
+         * @param actionId Action id
+         * @return Action id name
+         */
+        static const char *getActionName(ActionId actionId);
+
+        /**
+         * Save action queue information, called when action is added to queue
+         * @param sequence Number given by action queue
+         * @param enqueueTime Monotonic time action has been added [ns]
+         */
+        void setEnqueueInfo(unsigned long sequence, long long enqueueTime) {
+            this->sequence = sequence;
+            this->enqueueTime = enqueueTime;
+        }
+
+        /**
+         * Return number given by action queue. An action added after
+         * another one always has a bigger number
+         * @return Sequence number
+         */
+        unsigned long getSequence() const { return sequence; }
+
+        /**
+         * Return time action has been added to action queue
+         * @return Monotonic time [ns]
+         */
+        long long getEnqueueTime() const { return enqueueTime; }
+
+        /**
+         * Save time action has been removed from action queue
+         * @param dequeueTime Monotonic time [ns]
+         */
+        void setDequeueTime(long long dequeueTime) { this->dequeueTime = dequeueTime; }
+
+        /**
+         * Return time action has been removed from action queue
+         * @return Monotonic time [ns], 0 if action is still queued
+         */
+        long long getDequeueTime() const { return dequeueTime; }
+
+        /**
+         * Return time action has been created, on data reception
+         * @return Monotonic time [ns]
+         */
+        long long getReceiveTime() const { return receiveTime; }
+
+        /**
+         * Overwrite receive time, used when action is built from stored data
+         * @param receiveTime Monotonic time [ns]
+         */
+        void setReceiveTime(long long receiveTime) { this->receiveTime = receiveTime; }
+
         /**
          * Unit test to check that class is working. Called at the
          * beginning of the program. Assert if a test fails
          */
         static void unitTest();
 
-        // todo find a way to implement all push methods with RTTI (Templates?)
         /**
-         * Dedicated push methods
-         * See _push() macro for details
-         * @param data to push
-         * @return False if there is not enough memory allocated, true otherwise
+         * Measure encode/decode duration with 3 threads building and decoding
+         * their own objects, with and without the process-wide mutex used
+         * by previous implementation. Results are displayed on console
+         */
+        static void benchmark();
+
+        /**
+         * Set mission type and task and copy mission parameters.
+         * Parameters structure is checked at compile time, see ActionMessage.h
+         * @param task Mission task, value of Action::MissionAction
+         * @param data Mission parameters
+         * @return true if parameters have been copied
+         */
+        template <Action::MissionType Type>
+        bool encodeMission(unsigned task, const typename MissionLayout<Type>::type &data) {
+            missionType = Type;
+            missionTask = task;
+            return encode(data);
+        }
+
+        /**
+         * Set mission type and task of a mission without parameters
+         * @param task Mission task, value of Action::MissionAction
+         * @return true
+         */
+        template <Action::MissionType Type>
+        bool encodeMission(unsigned task) {
+            static_assert(std::is_same<typename MissionLayout<Type>::type, NoPayload>::value,
+                          "Mission requires parameters");
+            missionType = Type;
+            missionTask = task;
+            return encode(NoPayload());
+        }
+
+        /**
+         * Set mission type and task and copy raw mission parameters received
+         * from a frame. Length is checked against mission layout, extra
+         * bytes after parameters are ignored
+         * @param type Mission type, value of Action::MissionType
+         * @param task Mission task, value of Action::MissionAction
+         * @param data Raw mission parameters
+         * @param length Raw mission parameters length [bytes]
+         * @return False if mission type is unknown or frame is shorter
+         * than mission layout, true otherwise
+         */
+        bool encodeMission(unsigned type, unsigned task, const uint8_t *data, size_t length);
+
+        /**
+         * Copy mission parameters
+         * Parameters structure is checked at compile time, see ActionMessage.h
+         * @param data Mission parameters
+         * @return False if action is not a Type mission or if parameters are
+         * missing, true otherwise
+         */
+        template <Action::MissionType Type>
+        bool decodeMission(typename MissionLayout<Type>::type &data) const {
+            if(missionType != Type) {
+                DERROR("Unable to decode mission %u as mission %u", missionType, (unsigned)Type);
+                return false;
+            }
+            return decode(data);
+        }
+
+        /**
+         * Return mission type
+         * @return Action::MissionType value, 0 if action is not a mission
          */
-        bool push(char c);
-        bool push(int i);
-        bool push(unsigned u);
-        bool push(float f);
-        bool push(const Telemetry::Vector3f &v);
-        bool push(const uint8_t *data, size_t length);
+        unsigned getMissionType() const { return missionType; }
 
         /**
-         * Dedicated pop methods
-         * See _pop() macro for details
-         * @param return variable
-         * @return False if there is no more data to read, true otherwise
+         * Return mission task
+         * @return Action::MissionAction value, 0 if action is not a mission
          */
-        bool popChar(char &c);
-        bool popInt(int &i);
-        bool popUnsigned(unsigned &u);
-        bool popFloat(float &f);
-        bool popVector3f(Telemetry::Vector3f &v);
+        unsigned getMissionTask() const { return missionTask; }
     };
 }
 
@@ -0,0 +1,134 @@
+/*! @file ActionDataPool.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ActionDataPool.h implementation
+ */
+
+#include "ActionDataPool.h"
+
+#include <cassert>
+#include <new>
+
+#include "ActionData.h"
+
+using namespace M210;
+
+ActionDataPool::ActionDataPool() {
+    // Round slot size to keep each slot aligned for ActionData
+    slotSize = (sizeof(ActionData) + alignof(ActionData) - 1) / alignof(ActionData) * alignof(ActionData);
+    storage = static_cast<char *>(::operator new(slotSize * ACTION_DATA_POOL_SIZE));
+    for(uint16_t i = 0; i < ACTION_DATA_POOL_SIZE; i++)
+        freeSlots.push(i);
+    policy.store(HEAP_FALLBACK);
+    inUse.store(0);
+    highWater.store(0);
+    allocations.store(0);
+    heapFallbacks.store(0);
+    failures.store(0);
+}
+
+ActionDataPool::~ActionDataPool() {
+    ::operator delete(storage);
+}
+
+bool ActionDataPool::isSlot(const void *ptr) const {
+    auto p = static_cast<const char *>(ptr);
+    return p >= storage && p < storage + slotSize * ACTION_DATA_POOL_SIZE;
+}
+
+void *ActionDataPool::allocate(size_t size) {
+    if(size > slotSize) {
+        DERROR("ActionDataPool - Requested size %u is bigger than slot size", (unsigned)size);
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    uint16_t index;
+    if(freeSlots.pop(index)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        unsigned used = inUse.fetch_add(1, std::memory_order_relaxed) + 1;
+        unsigned high = highWater.load(std::memory_order_relaxed);
+        while(used > high &&
+              !highWater.compare_exchange_weak(high, used, std::memory_order_relaxed));
+        return storage + index * slotSize;
+    }
+    // Pool is empty, apply overflow policy
+    if(policy.load() == HEAP_FALLBACK) {
+        heapFallbacks.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size, std::nothrow);
+    }
+    failures.fetch_add(1, std::memory_order_relaxed);
+    DERROR("ActionDataPool - All slots are used, allocation rejected");
+    return nullptr;
+}
+
+void ActionDataPool::deallocate(void *ptr) {
+    if(ptr == nullptr)
+        return;
+    if(isSlot(ptr)) {
+        auto index = (uint16_t)((static_cast<char *>(ptr) - storage) / slotSize);
+        inUse.fetch_sub(1, std::memory_order_relaxed);
+        // Cannot fail, there is a place for each slot
+        freeSlots.push(index);
+    } else {
+        ::operator delete(ptr);
+    }
+}
+
+void ActionDataPool::getStats(Stats &stats) const {
+    stats.inUse = inUse.load(std::memory_order_relaxed);
+    stats.highWater = highWater.load(std::memory_order_relaxed);
+    stats.allocations = allocations.load(std::memory_order_relaxed);
+    stats.heapFallbacks = heapFallbacks.load(std::memory_order_relaxed);
+    stats.failures = failures.load(std::memory_order_relaxed);
+}
+
+void ActionDataPool::printStats() const {
+    Stats stats{};
+    getStats(stats);
+    DSTATUS("ActionData pool : %u/%u slots used (high-water %u), %lu allocations, "
+            "%lu heap fallbacks, %lu failures",
+            stats.inUse, ACTION_DATA_POOL_SIZE, stats.highWater, stats.allocations,
+            stats.heapFallbacks, stats.failures);
+}
+
+void ActionDataPool::unitTest() {
+    ActionDataPool pool;
+    void *slots[ACTION_DATA_POOL_SIZE];
+    Stats stats{};
+
+    // Use all slots
+    for(void *&slot : slots) {
+        slot = pool.allocate(sizeof(ActionData));
+        assert(slot != nullptr);
+    }
+    pool.getStats(stats);
+    assert(stats.inUse == ACTION_DATA_POOL_SIZE);
+    assert(stats.highWater == ACTION_DATA_POOL_SIZE);
+
+    // Pool is full, heap is used
+    void *heap = pool.allocate(sizeof(ActionData));
+    assert(heap != nullptr);
+    assert(!pool.isSlot(heap));
+    pool.deallocate(heap);
+
+    // Pool is full, allocation is rejected
+    pool.setOverflowPolicy(REJECT);
+    assert(pool.allocate(sizeof(ActionData)) == nullptr);
+
+    // Give back one slot, it can be used again
+    pool.deallocate(slots[0]);
+    slots[0] = pool.allocate(sizeof(ActionData));
+    assert(slots[0] != nullptr);
+
+    for(void *slot : slots)
+        pool.deallocate(slot);
+    pool.getStats(stats);
+    assert(stats.inUse == 0);
+    assert(stats.highWater == ACTION_DATA_POOL_SIZE);
+    assert(stats.heapFallbacks == 1);
+    assert(stats.failures == 1);
+
+    DSTATUS("ActionDataPool test passed");
+    DERROR("Please do not pay attention to the last error if ActionDataPool test passed");
+}
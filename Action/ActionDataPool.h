@@ -0,0 +1,118 @@
+/*! @file ActionDataPool.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Fixed-slot memory pool for ActionData objects.
+ *
+ *  All slots are allocated once at pool creation. ActionData operator
+ *  new/delete use the pool, so creating an action from Mobile or Console
+ *  does no heap allocation while slots are available. Free slots are kept
+ *  in a lock-free RingBuffer, pool can be used from any thread.
+ *
+ *  When all slots are used, overflow policy decides if the object is
+ *  allocated on the heap (HEAP_FALLBACK) or if the allocation fails
+ *  (REJECT, new returns nullptr).
+ */
+
+#ifndef MATRICE210_ACTIONDATAPOOL_H
+#define MATRICE210_ACTIONDATAPOOL_H
+
+#include <atomic>
+#include <cstdint>
+
+#include <dji_vehicle.hpp>
+
+#include "../util/RingBuffer.h"
+
+#define ACTION_DATA_POOL_SIZE 64    /*!< Number of preallocated ActionData slots, has to be a power of 2 */
+
+using namespace DJI::OSDK;
+
+namespace M210 {
+    class ActionDataPool : public Singleton<ActionDataPool> {
+    public:
+        enum OverflowPolicy {   /*!< Behaviour when all slots are used */
+            HEAP_FALLBACK,      /*!< Allocate object on the heap */
+            REJECT              /*!< Allocation fails */
+        };
+        struct Stats {          /*!< Pool counters, snapshot returned by getStats() */
+            unsigned inUse;                 /*!< Slots currently used */
+            unsigned highWater;             /*!< Maximal number of slots used at the same time */
+            unsigned long allocations;      /*!< Successful allocations from the pool */
+            unsigned long heapFallbacks;    /*!< Allocations done on the heap because pool was full */
+            unsigned long failures;         /*!< Allocations rejected because pool was full */
+        };
+    private:
+        char *storage;                  /*!< Memory of all slots */
+        size_t slotSize;                /*!< Size of one slot [bytes] */
+        RingBuffer<uint16_t, ACTION_DATA_POOL_SIZE> freeSlots;  /*!< Indexes of free slots */
+        std::atomic<int> policy;        /*!< Current OverflowPolicy */
+        std::atomic<unsigned> inUse;
+        std::atomic<unsigned> highWater;
+        std::atomic<unsigned long> allocations;
+        std::atomic<unsigned long> heapFallbacks;
+        std::atomic<unsigned long> failures;
+
+        /**
+         * Verify if memory belongs to a pool slot
+         * @param ptr Memory to verify
+         * @return true if ptr is a pool slot
+         */
+        bool isSlot(const void *ptr) const;
+    public:
+        /**
+         * Allocate all slots
+         */
+        ActionDataPool();
+
+        /**
+         * Free all slots
+         */
+        ~ActionDataPool();
+
+        /**
+         * Get a free slot, apply overflow policy if there is no more free slot
+         * @param size Size requested [bytes], has to fit in a slot
+         * @return Memory to use, nullptr if allocation failed
+         */
+        void *allocate(size_t size);
+
+        /**
+         * Give slot back to the pool, or free heap memory if it was allocated
+         * on overflow
+         * @param ptr Memory returned by allocate()
+         */
+        void deallocate(void *ptr);
+
+        /**
+         * Define overflow policy, default is HEAP_FALLBACK
+         * @param policy Behaviour when all slots are used
+         */
+        void setOverflowPolicy(OverflowPolicy policy) { this->policy.store(policy); }
+
+        /**
+         * Get overflow policy
+         * @return Behaviour when all slots are used
+         */
+        OverflowPolicy getOverflowPolicy() const { return (OverflowPolicy)policy.load(); }
+
+        /**
+         * Get pool counters
+         * @param stats Counters snapshot
+         */
+        void getStats(Stats &stats) const;
+
+        /**
+         * Display pool counters on console
+         */
+        void printStats() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_ACTIONDATAPOOL_H
@@ -0,0 +1,304 @@
+/*! @file ActionExecutor.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ActionExecutor.h implementation
+ */
+
+#include "ActionExecutor.h"
+
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+
+#include <dji_vehicle.hpp>
+
+#include "ActionData.h"
+#include "../Managers/ThreadManager.h"
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+using namespace M210;
+
+ActionToken::ActionToken() {
+    state.store(PENDING);
+    cancelRequested.store(false);
+    pthread_mutex_init(&mutex, nullptr);
+    // Timed wait must not be affected by system time changes
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&doneCond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+ActionToken::~ActionToken() {
+    pthread_cond_destroy(&doneCond);
+    pthread_mutex_destroy(&mutex);
+}
+
+void ActionToken::setState(State state) {
+    pthread_mutex_lock(&mutex);
+    this->state.store(state);
+    if(state >= SUCCEEDED)
+        pthread_cond_broadcast(&doneCond);
+    pthread_mutex_unlock(&mutex);
+}
+
+bool ActionToken::wait(unsigned long timeoutMs) {
+    timespec deadline{};
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&mutex);
+    int ret = 0;
+    while(!isDone() && ret != ETIMEDOUT)
+        ret = pthread_cond_timedwait(&doneCond, &mutex, &deadline);
+    bool done = isDone();
+    pthread_mutex_unlock(&mutex);
+    return done;
+}
+
+const char *ActionToken::stateName(State state) {
+    switch(state) {
+        case PENDING:
+            return "pending";
+        case RUNNING:
+            return "running";
+        case SUCCEEDED:
+            return "succeeded";
+        case FAILED:
+            return "failed";
+        case CANCELLED:
+            return "cancelled";
+        default:
+            return "unknown";
+    }
+}
+
+ActionExecutor::ActionExecutor() {
+    handler = nullptr;
+    handlerArg = nullptr;
+    threadName = "executorThread";
+    running.store(false);
+    cancelSequence.store(0);
+    submittedCnt.store(0);
+    rejectedCnt.store(0);
+    succeededCnt.store(0);
+    failedCnt.store(0);
+    cancelledCnt.store(0);
+    maxRunTime.store(0);
+    pthread_mutex_init(&current_mutex, nullptr);
+    if(sem_init(&jobsSem, 0, 0) != 0) {
+        int errsv = errno;  // save error code
+        DERROR("Action executor semaphore creation failed, error : %i", errsv);
+    }
+}
+
+ActionExecutor::~ActionExecutor() {
+    stop();
+    sem_destroy(&jobsSem);
+    pthread_mutex_destroy(&current_mutex);
+}
+
+bool ActionExecutor::start(const char *name, Handler handler, void *arg) {
+    if(running.load())
+        return true;
+    this->handler = handler;
+    this->handlerArg = arg;
+    threadName = name;
+    running.store(true);
+    if(!ThreadManager::start(name, &threadId, &threadAttr, executorThread, (void *) this)) {
+        running.store(false);
+        return false;
+    }
+    return true;
+}
+
+void ActionExecutor::stop() {
+    if(!running.exchange(false))
+        return;
+    // Running job stops at its next token check
+    pthread_mutex_lock(&current_mutex);
+    if(current)
+        current->cancel();
+    pthread_mutex_unlock(&current_mutex);
+    sem_post(&jobsSem);
+    if(!ThreadManager::stop(&threadId, threadName))
+        return;     // Jobs are still used by executor thread
+
+    // Jobs added after executor thread ended
+    Job *job;
+    while(jobs.pop(job)) {
+        job->token->cancel();
+        run(job);
+    }
+}
+
+std::shared_ptr<ActionToken> ActionExecutor::submit(ActionData *action) {
+    if(action == nullptr)
+        return nullptr;
+    auto job = new Job{action, std::make_shared<ActionToken>()};
+    std::shared_ptr<ActionToken> token = job->token;
+    if(!running.load() || !jobs.push(job)) {
+        rejectedCnt.fetch_add(1, std::memory_order_relaxed);
+        delete action;
+        delete job;
+        return nullptr;
+    }
+    submittedCnt.fetch_add(1, std::memory_order_relaxed);
+    sem_post(&jobsSem);
+    return token;
+}
+
+void ActionExecutor::cancelBefore(unsigned long sequence) {
+    // Keep the highest sequence, waiting jobs check it when removed
+    unsigned long previous = cancelSequence.load();
+    while(sequence > previous && !cancelSequence.compare_exchange_weak(previous, sequence));
+    pthread_mutex_lock(&current_mutex);
+    if(current)
+        current->cancel();
+    pthread_mutex_unlock(&current_mutex);
+}
+
+void *ActionExecutor::executorThread(void *param) {
+    auto executor = (ActionExecutor *) param;
+    Job *job;
+    while(executor->running.load()) {
+        // Wait until a job is added or executor is stopped
+        if(sem_wait(&executor->jobsSem) != 0)
+            continue;   // Interrupted by a signal
+        if(executor->jobs.pop(job))
+            executor->run(job);
+    }
+    return nullptr;
+}
+
+void ActionExecutor::run(Job *job) {
+    ActionToken &token = *job->token;
+    if(job->action->getSequence() < cancelSequence.load())
+        token.cancel();
+
+    if(token.isCancelled() || handler == nullptr) {
+        cancelledCnt.fetch_add(1, std::memory_order_relaxed);
+        token.setState(ActionToken::CANCELLED);
+    } else {
+        pthread_mutex_lock(&current_mutex);
+        current = job->token;
+        pthread_mutex_unlock(&current_mutex);
+
+        token.setState(ActionToken::RUNNING);
+        long long start = getMonotonicNs();
+        bool success = handler(job->action, token, handlerArg);
+        long long runTime = getMonotonicNs() - start;
+
+        pthread_mutex_lock(&current_mutex);
+        current.reset();
+        pthread_mutex_unlock(&current_mutex);
+
+        long long max = maxRunTime.load(std::memory_order_relaxed);
+        while(runTime > max && !maxRunTime.compare_exchange_weak(max, runTime, std::memory_order_relaxed));
+        ActionToken::State state;
+        if(token.isCancelled()) {
+            state = ActionToken::CANCELLED;
+            cancelledCnt.fetch_add(1, std::memory_order_relaxed);
+        } else if(success) {
+            state = ActionToken::SUCCEEDED;
+            succeededCnt.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            state = ActionToken::FAILED;
+            failedCnt.fetch_add(1, std::memory_order_relaxed);
+        }
+        token.setState(state);
+    }
+    DSTATUS("Action %lu %s", job->action->getSequence(), ActionToken::stateName(token.getState()));
+    delete job->action;
+    delete job;
+}
+
+void ActionExecutor::getStats(Stats &stats) const {
+    stats.submitted = submittedCnt.load(std::memory_order_relaxed);
+    stats.rejected = rejectedCnt.load(std::memory_order_relaxed);
+    stats.succeeded = succeededCnt.load(std::memory_order_relaxed);
+    stats.failed = failedCnt.load(std::memory_order_relaxed);
+    stats.cancelled = cancelledCnt.load(std::memory_order_relaxed);
+    stats.maxRunTime = maxRunTime.load(std::memory_order_relaxed);
+}
+
+void ActionExecutor::printStats() const {
+    Stats stats{};
+    getStats(stats);
+    DSTATUS("Action executor : %lu submitted, %lu rejected, %lu succeeded, "
+            "%lu failed, %lu cancelled, max run time %lld ms",
+            stats.submitted, stats.rejected, stats.succeeded,
+            stats.failed, stats.cancelled, stats.maxRunTime / 1000000);
+}
+
+/**
+ * Unit test job routine. Hello world succeeds at once,
+ * take-off runs until it is cancelled
+ */
+static bool unitTestHandler(ActionData *action, const ActionToken &token, void *arg) {
+    (void) arg;
+    if(action->getActionId() == ActionData::ActionId::takeOff) {
+        int timeoutCycles = 2000;
+        while(!token.isCancelled() && timeoutCycles-- > 0)
+            delay_ms(1);
+        return false;
+    }
+    return true;
+}
+
+void ActionExecutor::unitTest() {
+    ActionExecutor executor;
+    Stats stats{};
+    std::shared_ptr<ActionToken> tokens[3];
+
+    bool started = executor.start("executorTest", unitTestHandler, nullptr);
+    assert(started);
+
+    // Short job succeeds
+    tokens[0] = executor.submit(new ActionData(ActionData::ActionId::helloWorld));
+    assert(tokens[0] != nullptr);
+    assert(tokens[0]->wait(1000));
+    assert(tokens[0]->getState() == ActionToken::SUCCEEDED);
+
+    // Long job is running, short job is waiting behind it
+    auto action = new ActionData(ActionData::ActionId::takeOff);
+    action->setEnqueueInfo(10, 0);
+    tokens[0] = executor.submit(action);
+    action = new ActionData(ActionData::ActionId::helloWorld);
+    action->setEnqueueInfo(11, 0);
+    tokens[1] = executor.submit(action);
+    int timeoutCycles = 1000;
+    while(tokens[0]->getState() != ActionToken::RUNNING && timeoutCycles-- > 0)
+        delay_ms(1);
+    assert(tokens[0]->getState() == ActionToken::RUNNING);
+
+    // Stop processed with a later sequence cancels both
+    executor.cancelBefore(20);
+    assert(tokens[0]->wait(1000));
+    assert(tokens[1]->wait(1000));
+    assert(tokens[0]->getState() == ActionToken::CANCELLED);
+    assert(tokens[1]->getState() == ActionToken::CANCELLED);
+
+    // Job added after the stop is run
+    action = new ActionData(ActionData::ActionId::helloWorld);
+    action->setEnqueueInfo(21, 0);
+    tokens[2] = executor.submit(action);
+    assert(tokens[2]->wait(1000));
+    assert(tokens[2]->getState() == ActionToken::SUCCEEDED);
+
+    executor.stop();
+    executor.getStats(stats);
+    assert(stats.submitted == 4);
+    assert(stats.succeeded == 2);
+    assert(stats.cancelled == 2);
+    assert(stats.failed == 0);
+
+    DSTATUS("ActionExecutor test passed");
+}
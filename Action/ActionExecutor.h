@@ -0,0 +1,205 @@
+/*! @file ActionExecutor.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Runs long actions (take-off, landing, control authority,
+ *  waypoints mission) on a dedicated thread.
+ *
+ *  These actions wait for aircraft ACKs, up to seconds. Take-off and
+ *  landing only wait for their ACK here, they are then monitored by the
+ *  flight controller state machine. Running them out of Action::process
+ *  keeps short actions (watchdog, movements, stop) flowing with a bounded
+ *  latency.
+ *
+ *  Jobs are run one by one, in submission order. Each job has an
+ *  ActionToken used to follow its completion and to cancel it.
+ *  A cancelled job that is not started is not run. A running job is
+ *  asked to stop, long calls check the token between two polls.
+ */
+
+#ifndef MATRICE210_ACTIONEXECUTOR_H
+#define MATRICE210_ACTIONEXECUTOR_H
+
+#include <atomic>
+#include <memory>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "../util/RingBuffer.h"
+
+#define ACTION_EXECUTOR_QUEUE_SIZE 8    /*!< Maximal number of waiting jobs, has to be a power of 2 */
+
+namespace M210 {
+    class ActionData;
+
+    class ActionToken {
+    public:
+        enum State {        /*!< Job state, last three are final */
+            PENDING,
+            RUNNING,
+            SUCCEEDED,
+            FAILED,
+            CANCELLED
+        };
+    private:
+        std::atomic<int> state;                 /*!< Current State */
+        std::atomic<bool> cancelRequested;      /*!< Set by cancel() */
+        pthread_mutex_t mutex;                  /*!< Protect doneCond wait */
+        pthread_cond_t doneCond;                /*!< Signaled when state becomes final */
+    public:
+        ActionToken();
+        ~ActionToken();
+
+        ActionToken(const ActionToken &) = delete;
+        ActionToken &operator=(const ActionToken &) = delete;
+
+        /**
+         * Ask job to stop. Has no effect if job is done
+         */
+        void cancel() { cancelRequested.store(true); }
+
+        /**
+         * Checked by long calls between two polls
+         * @return true if job has to stop as soon as possible
+         */
+        bool isCancelled() const { return cancelRequested.load(); }
+
+        /**
+         * Used by long calls whose token is optional
+         * @param token Job token, can be nullptr
+         * @return true if token exists and is cancelled
+         */
+        static bool cancelled(const ActionToken *token) { return token != nullptr && token->isCancelled(); }
+
+        State getState() const { return (State)state.load(); }
+
+        bool isDone() const { return getState() >= SUCCEEDED; }
+
+        /**
+         * Wait end of job
+         * @param timeoutMs Maximal waiting time [ms]
+         * @return true if job is done, false on timeout
+         */
+        bool wait(unsigned long timeoutMs);
+
+        /**
+         * Set job state, wake up waiting threads if state is final.
+         * Used by ActionExecutor
+         * @param state New state
+         */
+        void setState(State state);
+
+        /**
+         * State name, used to display job results
+         * @param state Job state
+         * @return State name
+         */
+        static const char *stateName(State state);
+    };
+
+    class ActionExecutor {
+    public:
+        /**
+         * Job routine, declared as follow :
+         * bool handler(ActionData *action, const ActionToken &token, void *arg)
+         * Returns true if action succeeded
+         */
+        typedef bool (*Handler)(ActionData *action, const ActionToken &token, void *arg);
+        struct Stats {      /*!< Executor counters, snapshot returned by getStats() */
+            unsigned long submitted;    /*!< Number of jobs accepted */
+            unsigned long rejected;     /*!< Number of jobs rejected because queue was full */
+            unsigned long succeeded;    /*!< Number of jobs succeeded */
+            unsigned long failed;       /*!< Number of jobs failed */
+            unsigned long cancelled;    /*!< Number of jobs cancelled, started or not */
+            long long maxRunTime;       /*!< Maximal job duration [ns] */
+        };
+    private:
+        struct Job {
+            ActionData *action;
+            std::shared_ptr<ActionToken> token;
+        };
+        RingBuffer<Job*, ACTION_EXECUTOR_QUEUE_SIZE> jobs;  /*!< Waiting jobs */
+        sem_t jobsSem;                                      /*!< Counts waiting jobs, executor thread sleeps on it */
+        Handler handler;                                    /*!< Job routine */
+        void *handlerArg;                                   /*!< Passed as argument to handler */
+        std::atomic<bool> running;                          /*!< Executor thread state */
+        const char *threadName;                             /*!< Executor thread name, displayed on stop */
+        pthread_t threadId;                                 /*!< Executor thread id */
+        pthread_attr_t threadAttr;                          /*!< Executor thread attributes */
+        pthread_mutex_t current_mutex;                      /*!< Protect current */
+        std::shared_ptr<ActionToken> current;               /*!< Token of the running job */
+        std::atomic<unsigned long> cancelSequence;          /*!< Jobs added to action queue before this sequence are cancelled */
+        // Counters
+        std::atomic<unsigned long> submittedCnt;
+        std::atomic<unsigned long> rejectedCnt;
+        std::atomic<unsigned long> succeededCnt;
+        std::atomic<unsigned long> failedCnt;
+        std::atomic<unsigned long> cancelledCnt;
+        std::atomic<long long> maxRunTime;
+
+        static void *executorThread(void *param);           /*!< Executor thread, runs jobs one by one */
+
+        /**
+         * Run job, or only complete it if it is cancelled
+         * @param job Job to run, deleted with its action
+         */
+        void run(Job *job);
+    public:
+        ActionExecutor();
+
+        /**
+         * Stop executor thread
+         */
+        ~ActionExecutor();
+
+        /**
+         * Launch executor thread. Does nothing if already running
+         * @param name Thread name, restricted to 16 characters
+         * @param handler Job routine
+         * @param arg Passed as argument to handler
+         * @return true if executor is running
+         */
+        bool start(const char *name, Handler handler, void *arg);
+
+        /**
+         * Cancel all jobs and wait end of executor thread, at most
+         * THREAD_JOIN_TIMEOUT_MS. A job ignoring its token is left running
+         */
+        void stop();
+
+        /**
+         * Add job. Never blocks. Action is owned by executor and deleted once
+         * job is done. Action is deleted if queue is full
+         * @param action Action to run
+         * @return Job token, nullptr if job was rejected
+         */
+        std::shared_ptr<ActionToken> submit(ActionData *action);
+
+        /**
+         * Cancel running job and waiting jobs added to action queue before sequence.
+         * Never blocks, running job stops at its next token check
+         * @param sequence Action queue sequence number of the action causing cancellation
+         */
+        void cancelBefore(unsigned long sequence);
+
+        /**
+         * Get executor counters
+         * @param stats Counters snapshot
+         */
+        void getStats(Stats &stats) const;
+
+        /**
+         * Display counters on console
+         */
+        void printStats() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_ACTIONEXECUTOR_H
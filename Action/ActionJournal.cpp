@@ -0,0 +1,333 @@
+/*! @file ActionJournal.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ActionJournal.h implementation
+ */
+
+#include "ActionJournal.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Action.h"
+#include "ActionTracer.h"
+#include "../Managers/ThreadManager.h"
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+static_assert(sizeof(M210::ActionJournal::Record) == 16, "Journal record header must be 16 bytes");
+
+using namespace M210;
+
+ActionJournal::ActionJournal() {
+    file = nullptr;
+    path[0] = '\0';
+    fileSize = 0;
+    recording.store(false);
+    recordedCnt.store(0);
+    droppedCnt.store(0);
+    rotatedCnt.store(0);
+    if(sem_init(&entriesSem, 0, 0) != 0) {
+        int errsv = errno;  // save error code
+        DERROR("Action journal semaphore creation failed, error : %i", errsv);
+    }
+}
+
+ActionJournal::~ActionJournal() {
+    stop();
+    sem_destroy(&entriesSem);
+}
+
+bool ActionJournal::start(const char *path) {
+    if(recording.load())
+        return true;
+    if(path == nullptr) {
+        time_t now = time(nullptr);
+        strftime(this->path, sizeof(this->path), "actions_%Y%m%d_%H%M%S.journal", localtime(&now));
+    } else if(snprintf(this->path, sizeof(this->path), "%s", path) >= (int)sizeof(this->path)) {
+        DERROR("Action journal path %s is too long", path);
+        return false;
+    }
+    if(!openFile())
+        return false;
+    recording.store(true);
+    if(!ThreadManager::start("journalThread", &threadId, &threadAttr, writerThread, (void *) this,
+                             ThreadManager::BACKGROUND)) {
+        recording.store(false);
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    DSTATUS("Action journal recording in %s, at most %ld bytes per file", this->path, maxSize);
+    return true;
+}
+
+bool ActionJournal::openFile() {
+    file = fopen(path, "wb");
+    if(file == nullptr) {
+        int errsv = errno;  // save error code
+        DERROR("Action journal %s creation failed, error : %i", path, errsv);
+        return false;
+    }
+    fwrite(ACTION_JOURNAL_MAGIC, 1, ACTION_JOURNAL_MAGIC_SIZE, file);
+    fileSize = ACTION_JOURNAL_MAGIC_SIZE;
+    return true;
+}
+
+void ActionJournal::rotate() {
+    char previous[ACTION_JOURNAL_PATH_SIZE + 2];
+    snprintf(previous, sizeof(previous), "%s.1", path);
+    fclose(file);
+    file = nullptr;
+    // Replaces the file renamed before
+    if(rename(path, previous) != 0) {
+        int errsv = errno;  // save error code
+        DERROR("Action journal %s renaming failed, error : %i", path, errsv);
+    }
+    rotatedCnt.fetch_add(1, std::memory_order_relaxed);
+    // Records are dropped if file cannot be created again
+    openFile();
+}
+
+void ActionJournal::stop() {
+    if(!recording.exchange(false))
+        return;
+    sem_post(&entriesSem);
+    if(!ThreadManager::stop(&threadId, "journalThread")) {
+        // Writer still owns the file, it is closed on exit
+        DERROR("Action journal not flushed");
+        return;
+    }
+    // Records added while writer thread was ending
+    writeEntries();
+    if(file != nullptr)
+        fclose(file);
+    file = nullptr;
+    DSTATUS("Action journal stopped");
+}
+
+bool ActionJournal::capture(const ActionData *action, Entry &entry) const {
+    if(!recording.load(std::memory_order_relaxed))
+        return false;
+    entry.record.receiveTime = action->getReceiveTime();
+    entry.record.actionId = (uint8_t)action->getActionId();
+    entry.record.source = (uint8_t)action->getSource();
+    entry.record.missionType = (uint8_t)action->getMissionType();
+    entry.record.missionTask = (uint8_t)action->getMissionTask();
+    entry.record.payloadSize = (uint16_t)action->getPayloadSize();
+    entry.record.reserved = 0;
+    memcpy(entry.payload, action->getPayload(), action->getPayloadSize());
+    return true;
+}
+
+void ActionJournal::append(const Entry &entry) {
+    if(!entries.push(entry)) {
+        droppedCnt.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    sem_post(&entriesSem);
+}
+
+void *ActionJournal::writerThread(void *param) {
+    auto journal = (ActionJournal *) param;
+    while(journal->recording.load()) {
+        // Wait until a record is added or journal is stopped
+        if(sem_wait(&journal->entriesSem) != 0)
+            continue;   // Interrupted by a signal
+        journal->writeEntries();
+    }
+    return nullptr;
+}
+
+void ActionJournal::writeEntries() {
+    Entry entry;
+    bool written = false;
+    while(entries.pop(entry)) {
+        if(file == nullptr) {
+            droppedCnt.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        fwrite(&entry.record, sizeof(entry.record), 1, file);
+        fwrite(entry.payload, 1, entry.record.payloadSize, file);
+        fileSize += (long)sizeof(entry.record) + entry.record.payloadSize;
+        recordedCnt.fetch_add(1, std::memory_order_relaxed);
+        written = true;
+        if(fileSize >= maxSize) {
+            rotate();
+            written = false;
+        }
+    }
+    // Flush once queue is empty, a crash loses at most the last burst
+    if(written && file != nullptr)
+        fflush(file);
+}
+
+void ActionJournal::printStats() const {
+    DSTATUS("Action journal %s : %lu records written, %lu dropped, %lu files rotated",
+            recording.load() ? "recording" : "stopped",
+            recordedCnt.load(std::memory_order_relaxed), droppedCnt.load(std::memory_order_relaxed),
+            rotatedCnt.load(std::memory_order_relaxed));
+}
+
+long ActionJournal::replay(const char *path, bool realTime) {
+    FILE *in = fopen(path, "rb");
+    if(in == nullptr) {
+        int errsv = errno;  // save error code
+        DERROR("Action journal %s opening failed, error : %i", path, errsv);
+        return -1;
+    }
+    char magic[ACTION_JOURNAL_MAGIC_SIZE];
+    if(fread(magic, 1, ACTION_JOURNAL_MAGIC_SIZE, in) != ACTION_JOURNAL_MAGIC_SIZE ||
+       memcmp(magic, ACTION_JOURNAL_MAGIC, ACTION_JOURNAL_MAGIC_SIZE) != 0) {
+        DERROR("%s is not an action journal", path);
+        fclose(in);
+        return -1;
+    }
+
+    long records = 0;
+    long added = 0;
+    long long firstReceiveTime = 0;
+    long long startTime = getMonotonicNs();
+    Entry entry;
+    while(fread(&entry.record, sizeof(entry.record), 1, in) == 1) {
+        const Record &r = entry.record;
+        if(r.actionId >= ActionData::actionIdCount || r.payloadSize > ACTION_DATA_PAYLOAD_SIZE ||
+           fread(entry.payload, 1, r.payloadSize, in) != r.payloadSize) {
+            DERROR("Action journal record %ld is corrupted, replay stopped", records);
+            break;
+        }
+        // Keep delays between actions
+        if(records++ == 0)
+            firstReceiveTime = r.receiveTime;
+        if(realTime) {
+            long long deadline = startTime + (r.receiveTime - firstReceiveTime);
+            timespec ts{};
+            ts.tv_sec = deadline / 1000000000LL;
+            ts.tv_nsec = deadline % 1000000000LL;
+            while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+        }
+        // As fast as possible, but without filling action queue
+        while(!realTime && Action::instance().queuedCount() >= ACTION_QUEUE_SIZE / 2)
+            usleep(ACTION_JOURNAL_REPLAY_WAIT_US);
+        auto action = new ActionData((ActionData::ActionId)r.actionId, ActionData::REPLAY);
+        if(action == nullptr)
+            continue;
+        if(r.missionType != 0 &&
+           !action->encodeMission(r.missionType, r.missionTask,
+                                  reinterpret_cast<const uint8_t *>(entry.payload), r.payloadSize)) {
+            delete action;
+            continue;
+        }
+        if(Action::instance().add(action))
+            added++;
+    }
+    fclose(in);
+    return added;
+}
+
+/**
+ * Processes action queue until replay is done
+ */
+static std::atomic<bool> replayProcessing;
+
+static void *replayProcessThread(void *param) {
+    (void) param;
+    while(replayProcessing.load())
+        Action::instance().process();
+    return nullptr;
+}
+
+namespace {
+    /**
+     * Dry-run and tracing during replay, previous modes are restored
+     * on every exit path so that real dispatch is never left disabled
+     */
+    class ReplayMode {
+        bool dryRun;
+        bool tracing;
+    public:
+        ReplayMode() : dryRun(Action::instance().isDryRun()), tracing(ActionTracer::instance().isEnabled()) {
+            Action::instance().setDryRun(true);
+            ActionTracer::instance().setEnabled(true);
+        }
+
+        ~ReplayMode() {
+            Action::instance().setDryRun(dryRun);
+            ActionTracer::instance().setEnabled(tracing);
+        }
+    };
+}
+
+bool ActionJournal::replayBenchmark(const char *path, bool realTime) {
+    pthread_t processThreadId;
+    pthread_attr_t processThreadAttr;
+
+    DSTATUS("Replay %s %s, without aircraft", path, realTime ? "at original speed" : "as fast as possible");
+    ReplayMode mode;
+    replayProcessing.store(true);
+    if(!ThreadManager::start("replayThread", &processThreadId, &processThreadAttr,
+                             replayProcessThread, nullptr))
+        return false;
+
+    long long start = getMonotonicNs();
+    long added = replay(path, realTime);
+    // Wait until all actions are processed
+    while(Action::instance().queuedCount() > 0)
+        delay_ms(1);
+    long long duration = getMonotonicNs() - start;
+
+    // Wake up process thread so that it sees the end of replay
+    replayProcessing.store(false);
+    Action::instance().interrupt();
+    pthread_join(processThreadId, nullptr);
+    if(added < 0)
+        return false;
+
+    DSTATUS("%ld actions replayed in %.1f ms, %.0f actions/s", added, duration / 1000000.0,
+            duration > 0 ? added * 1000000000.0 / duration : 0.0);
+    Action::instance().printStats();
+    ActionTracer::instance().print();
+    return true;
+}
+
+void ActionJournal::unitTest() {
+    const char *path = "/tmp/m210_unit_test.journal";
+    const char *previous = "/tmp/m210_unit_test.journal.1";
+    const long recordSize = (long)sizeof(Record);
+    ActionJournal journal;
+    Entry entry;
+    ActionData action(ActionData::ActionId::watchdog);
+
+    // Not recording, nothing captured
+    assert(!journal.capture(&action, entry));
+
+    // Full file is renamed, a new one is started
+    journal.maxSize = ACTION_JOURNAL_MAGIC_SIZE + 4 * recordSize;
+    assert(journal.start(path));
+    for(int i = 0; i < 10; i++) {
+        assert(journal.capture(&action, entry));
+        journal.append(entry);
+        delay_ms(1);
+    }
+    journal.stop();
+    struct stat current{}, renamed{};
+    assert(stat(path, &current) == 0 && stat(previous, &renamed) == 0);
+    assert(renamed.st_size == journal.maxSize);
+    assert(current.st_size == ACTION_JOURNAL_MAGIC_SIZE + 2 * recordSize);
+    assert(journal.recordedCnt.load() + journal.droppedCnt.load() == 10);
+    assert(journal.rotatedCnt.load() == 2);
+    remove(path);
+    remove(previous);
+
+    // Failed replay leaves real dispatch enabled
+    assert(!replayBenchmark(path, false));
+    assert(!Action::instance().isDryRun());
+
+    DSTATUS("ActionJournal test passed");
+}
@@ -0,0 +1,166 @@
+/*! @file ActionJournal.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Binary journal of the actions added to Action, and replay.
+ *
+ *  Each action accepted by Action::add() is copied in a bounded lock-free
+ *  queue, a dedicated thread writes it to the journal file. Producers never
+ *  wait for the disk : a record is dropped and counted if the queue is full.
+ *
+ *  Recording is opt-in, see start(). Once a file reaches
+ *  ACTION_JOURNAL_MAX_SIZE it is renamed with a ".1" suffix, replacing the
+ *  previous one, and a new file is started : a session never uses more
+ *  than twice ACTION_JOURNAL_MAX_SIZE on disk.
+ *
+ *  File starts with ACTION_JOURNAL_MAGIC, followed by records. A record is
+ *  a Record header followed by payloadSize payload bytes. Values are stored
+ *  in the byte order of the machine that recorded them.
+ *
+ *  A journal can be replayed into the action pipeline at original speed or
+ *  as fast as possible. replayBenchmark() does it with Action in dry-run mode,
+ *  without aircraft, to compare dispatch throughput and latency between builds.
+ */
+
+#ifndef MATRICE210_ACTIONJOURNAL_H
+#define MATRICE210_ACTIONJOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <dji_vehicle.hpp>
+
+#include "ActionData.h"
+#include "../util/RingBuffer.h"
+
+#define ACTION_JOURNAL_MAGIC "M210JRN1"     /*!< Journal file header, 8 bytes */
+#define ACTION_JOURNAL_MAGIC_SIZE 8
+#define ACTION_JOURNAL_QUEUE_SIZE 256       /*!< Maximal number of records waiting to be written, has to be a power of 2 */
+#define ACTION_JOURNAL_MAX_SIZE (8L * 1024 * 1024)  /*!< File size starting a new file [bytes] */
+#define ACTION_JOURNAL_PATH_SIZE 256        /*!< Maximal journal file path length */
+#define ACTION_JOURNAL_REPLAY_WAIT_US 100   /*!< Fast replay wait while action queue is half full [us] */
+
+using namespace DJI::OSDK;
+
+namespace M210 {
+    class ActionJournal : public Singleton<ActionJournal> {
+    public:
+        struct Record {                 /*!< Record header, as written in file */
+            int64_t receiveTime;        /*!< Monotonic reception time [ns] */
+            uint8_t actionId;           /*!< ActionData::ActionId */
+            uint8_t source;             /*!< ActionData::Source */
+            uint8_t missionType;        /*!< Action::MissionType, 0 if action is not a mission */
+            uint8_t missionTask;        /*!< Action::MissionAction, 0 if action is not a mission */
+            uint16_t payloadSize;       /*!< Number of payload bytes following header */
+            uint16_t reserved;          /*!< Always 0 */
+        };
+        struct Entry {                  /*!< Record and its payload, waiting to be written */
+            Record record;
+            char payload[ACTION_DATA_PAYLOAD_SIZE];
+        };
+    private:
+        FILE *file;                                             /*!< Journal file, nullptr if not recording */
+        char path[ACTION_JOURNAL_PATH_SIZE];                    /*!< Journal file path */
+        long fileSize;                                          /*!< Bytes written in current file */
+        long maxSize{ACTION_JOURNAL_MAX_SIZE};                  /*!< File size starting a new file, lowered by unit test */
+        RingBuffer<Entry, ACTION_JOURNAL_QUEUE_SIZE> entries;   /*!< Records waiting to be written */
+        sem_t entriesSem;                                       /*!< Counts waiting records, writer thread sleeps on it */
+        std::atomic<bool> recording;                            /*!< Journal state */
+        pthread_t threadId;                                     /*!< Writer thread id */
+        pthread_attr_t threadAttr;                              /*!< Writer thread attributes */
+        std::atomic<unsigned long> recordedCnt;                 /*!< Records written */
+        std::atomic<unsigned long> droppedCnt;                  /*!< Records dropped because queue was full or file unavailable */
+        std::atomic<unsigned long> rotatedCnt;                  /*!< Files renamed because they were full */
+
+        static void *writerThread(void *param);                 /*!< Writer thread, writes records to file */
+
+        /**
+         * Write waiting records to file
+         */
+        void writeEntries();
+
+        /**
+         * Create file and write its header
+         * @return false if file cannot be created
+         */
+        bool openFile();
+
+        /**
+         * Rename full file with ".1" suffix and start a new one
+         */
+        void rotate();
+    public:
+        ActionJournal();
+
+        /**
+         * Stop recording
+         */
+        ~ActionJournal();
+
+        /**
+         * Create journal file and launch writer thread. Does nothing if already recording.
+         * Called only if program is launched with "journal" argument
+         * @param path Journal file path, nullptr for actions_<date>_<time>.journal
+         * in current directory
+         * @return true if journal is recording
+         */
+        bool start(const char *path = nullptr);
+
+        /**
+         * Write waiting records, stop writer thread and close file
+         */
+        void stop();
+
+        bool isRecording() const { return recording.load(); }
+
+        /**
+         * Copy action in a record. Must be called before action is given
+         * to action queue, action belongs to consumer afterwards
+         * @param action Action to record
+         * @param entry Record to fill
+         * @return false if journal is not recording, entry is then not filled
+         */
+        bool capture(const ActionData *action, Entry &entry) const;
+
+        /**
+         * Add record to the records waiting to be written. Never blocks
+         * @param entry Record filled by capture()
+         */
+        void append(const Entry &entry);
+
+        /**
+         * Display journal counters on console
+         */
+        void printStats() const;
+
+        /**
+         * Add actions of a journal to Action. Actions are received again :
+         * their receive time is the replay time
+         * @param path Journal file path
+         * @param realTime true to keep delays between actions, false to add them as fast as possible
+         * @return Number of added actions, -1 if file cannot be read
+         */
+        static long replay(const char *path, bool realTime);
+
+        /**
+         * Replay a journal with Action in dry-run mode, without aircraft.
+         * Dispatch throughput and latency histograms are displayed on console
+         * @param path Journal file path
+         * @param realTime true to keep delays between actions, false to add them as fast as possible
+         * @return false if journal cannot be replayed
+         */
+        static bool replayBenchmark(const char *path, bool realTime);
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_ACTIONJOURNAL_H
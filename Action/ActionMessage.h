@@ -0,0 +1,66 @@
+/*! @file ActionMessage.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Payload layouts of the actions.
+ *
+ *  Each mission type declares here, once, the POD structure carried by
+ *  its ActionData. ActionData encode/decode methods use these layouts at
+ *  compile time: a payload is written and read with a single bounds-checked
+ *  copy and using a wrong structure for a mission type does not compile.
+ *  Structures have the same layout as the parameters of the mission
+ *  frames sent by the mobile application (see Mobile::mobileCallback).
+ */
+
+#ifndef MATRICE210_ACTIONMESSAGE_H
+#define MATRICE210_ACTIONMESSAGE_H
+
+#include <cstddef>
+
+#include <dji_vehicle.hpp>
+
+#include "Action.h"
+
+using namespace DJI::OSDK;
+
+namespace M210 {
+    /**
+     * Used by actions without parameters
+     */
+    struct NoPayload {};
+
+    /**
+     * Movement missions parameters (velocity, position, position offset)
+     * Mobile frame : x, y, z, yaw as 4 bytes floats
+     */
+    struct MovementPayload {
+        Telemetry::Vector3f vector;     /*!< Velocity [m/s] or position [m] */
+        float32_t yaw;                  /*!< Yaw rate [deg/s] or yaw angle [deg] */
+    };
+    static_assert(sizeof(MovementPayload) == 4 * sizeof(float32_t), "MovementPayload must match mobile frame");
+
+    /**
+     * Payload size, NoPayload has no data
+     */
+    template <typename T>
+    struct PayloadSize { static const size_t value = sizeof(T); };
+    template <>
+    struct PayloadSize<NoPayload> { static const size_t value = 0; };
+
+    /**
+     * Payload layout of each mission type, there is no default
+     * so an unknown mission type does not compile
+     */
+    template <Action::MissionType Type>
+    struct MissionLayout;
+    template <>
+    struct MissionLayout<Action::VELOCITY> { typedef MovementPayload type; };
+    template <>
+    struct MissionLayout<Action::POSITION> { typedef MovementPayload type; };
+    template <>
+    struct MissionLayout<Action::POSITION_OFFSET> { typedef MovementPayload type; };
+    template <>
+    struct MissionLayout<Action::WAYPOINTS> { typedef NoPayload type; };
+}
+
+#endif //MATRICE210_ACTIONMESSAGE_H
@@ -0,0 +1,302 @@
+/*! @file ActionQueue.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ActionQueue.h implementation
+ */
+
+#include "ActionQueue.h"
+
+#include <fcntl.h>
+#include <mqueue.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <dji_vehicle.hpp>
+
+#include "ActionData.h"
+#include "../Managers/ThreadManager.h"
+#include "../util/Benchmark.h"
+#include "../util/timer.h"
+
+#define BENCHMARK_QUEUE_NAME "/actionQueueBenchmark"
+#define BENCHMARK_SAMPLES 2000
+
+using namespace M210;
+
+ActionQueue::ActionQueue() {
+    for(LaneCounters &c : counters) {
+        c.maxDepth.store(0);
+        c.added.store(0);
+        c.rejected.store(0);
+        c.processed.store(0);
+        c.totalWait.store(0);
+        c.maxWait.store(0);
+    }
+    sequence.store(0);
+    consumerWaiting.store(false);
+    eventFd = eventfd(0, EFD_CLOEXEC);
+    if(eventFd == -1) {
+        int errsv = errno;  // save error code
+        DERROR("Action queue eventfd creation failed, error : %i", errsv);
+    }
+}
+
+ActionQueue::~ActionQueue() {
+    if(eventFd != -1)
+        close(eventFd);
+}
+
+bool ActionQueue::push(ActionData *actionData, Lane lane) {
+    LaneCounters &c = counters[lane];
+    if(actionData != nullptr)
+        actionData->setEnqueueInfo(sequence.fetch_add(1), getMonotonicNs());
+    if(!rings[lane].push(actionData)) {
+        c.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    c.added.fetch_add(1, std::memory_order_relaxed);
+    // Keep maximal depth, other producers can update it at the same time
+    size_t depth = rings[lane].count();
+    size_t maxDepth = c.maxDepth.load(std::memory_order_relaxed);
+    while(depth > maxDepth &&
+          !c.maxDepth.compare_exchange_weak(maxDepth, depth, std::memory_order_relaxed));
+    // Pairs with the fence in pop(): either the consumer sees the new
+    // action on its last check, or we see that it is sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(consumerWaiting.exchange(false)) {
+        uint64_t one = 1;
+        if(write(eventFd, &one, sizeof(one)) != sizeof(one))
+            DERROR("Action queue wake up failed");
+    }
+    return true;
+}
+
+bool ActionQueue::tryPop(ActionData *&actionData) {
+    for(int lane = 0; lane < LANE_COUNT; lane++) {
+        if(rings[lane].pop(actionData)) {
+            LaneCounters &c = counters[lane];
+            c.processed.fetch_add(1, std::memory_order_relaxed);
+            if(actionData != nullptr) {
+                long long now = getMonotonicNs();
+                actionData->setDequeueTime(now);
+                long long wait = now - actionData->getEnqueueTime();
+                c.totalWait.fetch_add(wait, std::memory_order_relaxed);
+                // Only the consumer writes maxWait
+                if(wait > c.maxWait.load(std::memory_order_relaxed))
+                    c.maxWait.store(wait, std::memory_order_relaxed);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+ActionData *ActionQueue::pop() {
+    ActionData *actionData;
+    while(true) {
+        if(tryPop(actionData))
+            return actionData;
+        // Rings are empty, announce that consumer will sleep then check
+        // again in case an action has been added meanwhile
+        consumerWaiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if(tryPop(actionData)) {
+            consumerWaiting.store(false);
+            return actionData;
+        }
+        // Blocking call until a producer writes eventfd. An old wake up
+        // can make it return immediately, rings are checked again anyway
+        uint64_t value;
+        if(read(eventFd, &value, sizeof(value)) == -1 && errno != EINTR) {
+            int errsv = errno;  // save error code
+            DERROR("Action queue wait failed, error : %i", errsv);
+            delay_ms(1);
+        }
+        if(interrupted.exchange(false)) {
+            consumerWaiting.store(false);
+            return nullptr;
+        }
+    }
+}
+
+void ActionQueue::interrupt() {
+    interrupted.store(true);
+    uint64_t one = 1;
+    if(write(eventFd, &one, sizeof(one)) != sizeof(one))
+        DERROR("Action queue interrupt failed");
+}
+
+bool ActionQueue::tryPopOrArm(ActionData *&actionData) {
+    if(tryPop(actionData))
+        return true;
+    // Same as pop(), without the blocking read
+    consumerWaiting.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(tryPop(actionData)) {
+        consumerWaiting.store(false);
+        return true;
+    }
+    return false;
+}
+
+void ActionQueue::clearWakeUp() {
+    uint64_t value;
+    if(read(eventFd, &value, sizeof(value)) == -1 && errno != EINTR) {
+        int errsv = errno;  // save error code
+        DERROR("Action queue wake up read failed, error : %i", errsv);
+    }
+}
+
+void ActionQueue::getStats(Lane lane, LaneStats &stats) const {
+    const LaneCounters &c = counters[lane];
+    stats.depth = rings[lane].count();
+    stats.maxDepth = c.maxDepth.load(std::memory_order_relaxed);
+    stats.added = c.added.load(std::memory_order_relaxed);
+    stats.rejected = c.rejected.load(std::memory_order_relaxed);
+    stats.processed = c.processed.load(std::memory_order_relaxed);
+    stats.totalWait = c.totalWait.load(std::memory_order_relaxed);
+    stats.maxWait = c.maxWait.load(std::memory_order_relaxed);
+}
+
+void ActionQueue::printStats() const {
+    for(int lane = 0; lane < LANE_COUNT; lane++) {
+        LaneStats stats{};
+        getStats((Lane)lane, stats);
+        double averageWait = stats.processed > 0 ?
+                             (double)stats.totalWait / stats.processed / 1000000.0 : 0;
+        DSTATUS("%-12s depth %u (max %u), added %lu, processed %lu, rejected %lu, wait avg %.2f ms, max %.2f ms",
+                laneName((Lane)lane), (unsigned)stats.depth, (unsigned)stats.maxDepth,
+                stats.added, stats.processed, stats.rejected, averageWait, stats.maxWait / 1000000.0);
+    }
+}
+
+const char *ActionQueue::laneName(Lane lane) {
+    switch(lane) {
+        case SAFETY:
+            return "Safety";
+        case CONTROL:
+            return "Control";
+        case HOUSEKEEPING:
+            return "Housekeeping";
+        default:
+            return "Unknown";
+    }
+}
+
+namespace {
+    /**
+     * Data shared between benchmark producer and consumer threads
+     */
+    struct QueueBenchmark {
+        ActionQueue *queue;                 /*!< Used by ActionQueue benchmark */
+        mqd_t mq;                           /*!< Used by mqueue benchmark */
+        long long sendTime[BENCHMARK_SAMPLES];  /*!< Time each message has been sent [ns] */
+        std::atomic<int> received;          /*!< Number of messages received by consumer */
+        Benchmark *result;                  /*!< Latency results */
+    };
+
+    void *ringConsumer(void *param) {
+        auto b = static_cast<QueueBenchmark*>(param);
+        for(int i = 0; i < BENCHMARK_SAMPLES; i++) {
+            b->queue->pop();
+            b->result->add(getMonotonicNs() - b->sendTime[i]);
+            b->received.store(i + 1);
+        }
+        return nullptr;
+    }
+
+    void *mqConsumer(void *param) {
+        auto b = static_cast<QueueBenchmark*>(param);
+        for(int i = 0; i < BENCHMARK_SAMPLES; i++) {
+            ActionData *actionData;
+            mq_receive(b->mq, (char *)&actionData, sizeof(void *), nullptr);
+            b->result->add(getMonotonicNs() - b->sendTime[i]);
+            b->received.store(i + 1);
+        }
+        return nullptr;
+    }
+
+    /**
+     * Send messages one by one, consumer is sleeping on each send
+     * as in normal use
+     * @param b Shared benchmark data
+     * @param send Function adding one message to tested queue
+     */
+    void produce(QueueBenchmark *b, bool (*send)(QueueBenchmark *)) {
+        for(int i = 0; i < BENCHMARK_SAMPLES; i++) {
+            b->sendTime[i] = getMonotonicNs();
+            if(!send(b)) {
+                DERROR("Queue benchmark - send failed");
+                return;
+            }
+            while(b->received.load() != i + 1)
+                sched_yield();
+            // Let consumer go back to sleep
+            usleep(200);
+        }
+    }
+
+    bool ringSend(QueueBenchmark *b) {
+        return b->queue->push(nullptr, ActionQueue::CONTROL);
+    }
+
+    bool mqSend(QueueBenchmark *b) {
+        // Same as previous Action::add()
+        static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        struct timespec sendTimeout{0, 250000};
+        ActionData *actionData = nullptr;
+        pthread_mutex_lock(&mutex);
+        int status = mq_timedsend(b->mq, (const char *)&actionData, sizeof(void *), 1, &sendTimeout);
+        pthread_mutex_unlock(&mutex);
+        return status != -1;
+    }
+}
+
+void ActionQueue::benchmark() {
+    pthread_t consumerThreadID;
+    pthread_attr_t consumerThreadAttr;
+
+    // ActionQueue
+    auto ringBenchmark = new QueueBenchmark();
+    Benchmark ringResult("ActionQueue enqueue->dequeue", BENCHMARK_SAMPLES);
+    ActionQueue queue;
+    ringBenchmark->queue = &queue;
+    ringBenchmark->result = &ringResult;
+    ringBenchmark->received.store(0);
+    if(ThreadManager::start("ringBenchmark", &consumerThreadID, &consumerThreadAttr,
+                            ringConsumer, ringBenchmark)) {
+        produce(ringBenchmark, ringSend);
+        pthread_join(consumerThreadID, nullptr);
+        ringResult.print();
+    }
+    delete ringBenchmark;
+
+    // POSIX mqueue, as used before ActionQueue
+    auto mqBenchmark = new QueueBenchmark();
+    Benchmark mqResult("mqueue enqueue->dequeue", BENCHMARK_SAMPLES);
+    mq_attr attr{};
+    attr.mq_flags = 0;
+    attr.mq_maxmsg = 10;
+    attr.mq_msgsize = sizeof(void*);
+    attr.mq_curmsgs = 0;
+    mq_unlink(BENCHMARK_QUEUE_NAME);
+    mqBenchmark->mq = mq_open(BENCHMARK_QUEUE_NAME, O_CREAT | O_RDWR, 0666, &attr);
+    mqBenchmark->result = &mqResult;
+    mqBenchmark->received.store(0);
+    if(mqBenchmark->mq == -1) {
+        int errsv = errno;  // save error code
+        DERROR("Benchmark queue creation failed, error : %i", errsv);
+    } else {
+        if(ThreadManager::start("mqBenchmark", &consumerThreadID, &consumerThreadAttr,
+                                mqConsumer, mqBenchmark)) {
+            produce(mqBenchmark, mqSend);
+            pthread_join(consumerThreadID, nullptr);
+            mqResult.print();
+        }
+        mq_close(mqBenchmark->mq);
+        mq_unlink(BENCHMARK_QUEUE_NAME);
+    }
+    delete mqBenchmark;
+}
@@ -0,0 +1,160 @@
+/*! @file ActionQueue.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief In-process queue of ActionData pointers used by Action.
+ *
+ *  Producers (Mobile callback, Console thread, Uart thread) add actions
+ *  without lock and without system call in bounded RingBuffers.
+ *  Only one consumer (Action::process) is allowed. When all rings are empty,
+ *  the consumer sleeps on an eventfd. Producers write the eventfd only
+ *  if the consumer is sleeping.
+ *
+ *  There is one ring by priority lane. Consumer always empties higher
+ *  priority lane first, so a stop never waits behind queued missions.
+ *  Depth and wait time are counted by lane.
+ */
+
+#ifndef MATRICE210_ACTIONQUEUE_H
+#define MATRICE210_ACTIONQUEUE_H
+
+#include <atomic>
+
+#include "../util/RingBuffer.h"
+
+#define ACTION_QUEUE_SIZE 64    /*!< Maximal number of queued actions, has to be a power of 2 */
+
+namespace M210 {
+    class ActionData;
+
+    class ActionQueue {
+    public:
+        enum Lane {         /*!< Priority lanes, first one has the highest priority */
+            SAFETY,
+            CONTROL,
+            HOUSEKEEPING,
+            LANE_COUNT
+        };
+        struct LaneStats {  /*!< Lane counters, snapshot returned by getStats() */
+            size_t depth;           /*!< Current number of queued actions */
+            size_t maxDepth;        /*!< Maximal number of queued actions */
+            unsigned long added;    /*!< Number of actions added */
+            unsigned long rejected; /*!< Number of actions rejected because lane was full */
+            unsigned long processed;/*!< Number of actions removed by consumer */
+            long long totalWait;    /*!< Sum of the time spent in queue by removed actions [ns] */
+            long long maxWait;      /*!< Maximal time spent in queue by a removed action [ns] */
+        };
+    private:
+        struct LaneCounters {
+            std::atomic<size_t> maxDepth;
+            std::atomic<unsigned long> added;
+            std::atomic<unsigned long> rejected;
+            std::atomic<unsigned long> processed;
+            std::atomic<long long> totalWait;
+            std::atomic<long long> maxWait;
+        };
+        RingBuffer<ActionData*, ACTION_QUEUE_SIZE> rings[LANE_COUNT];  /*!< Queued actions, by lane */
+        LaneCounters counters[LANE_COUNT];                  /*!< Statistics, by lane */
+        std::atomic<unsigned long> sequence;                /*!< Number given to the next added action */
+        int eventFd;                                        /*!< Used to wake up the consumer */
+        std::atomic<bool> consumerWaiting;                  /*!< True while the consumer sleeps on eventFd */
+        std::atomic<bool> interrupted{false};               /*!< Set by interrupt(), makes pop() return */
+
+        /**
+         * Remove action from the highest priority lane not empty
+         * @param actionData Removed action
+         * @return false if all lanes are empty
+         */
+        bool tryPop(ActionData *&actionData);
+    public:
+        /**
+         * Create eventfd used to wake up the consumer
+         */
+        ActionQueue();
+
+        /**
+         * Close eventfd. Remaining actions are not deleted
+         */
+        ~ActionQueue();
+
+        /**
+         * Add action to queue and wake up consumer if needed. Never blocks.
+         * Action is stamped with its sequence number and enqueue time
+         * @param actionData Action to add
+         * @param lane Priority lane
+         * @return false if lane is full, true otherwise
+         */
+        bool push(ActionData *actionData, Lane lane);
+
+        /**
+         * Get oldest action of the highest priority lane, wait until an
+         * action is added if queue is empty. Must always be called from the
+         * same thread
+         * @return Action, nullptr if consumer has been interrupted
+         */
+        ActionData *pop();
+
+        /**
+         * Make a waiting pop() return nullptr, or the next one if consumer
+         * is not waiting. Used to end the consumer loop. Never blocks
+         */
+        void interrupt();
+
+        /**
+         * Get oldest action of the highest priority lane without waiting.
+         * If queue is empty, consumer is announced as sleeping so that
+         * next push() writes the eventfd, see getEventFd(). Must always
+         * be called from the same thread
+         * @param actionData Removed action
+         * @return false if queue is empty
+         */
+        bool tryPopOrArm(ActionData *&actionData);
+
+        /**
+         * Readable when an action has been added while consumer was
+         * sleeping, used to wait on queue in an event loop
+         * @return eventfd
+         */
+        int getEventFd() const { return eventFd; }
+
+        /**
+         * Consume eventfd wake ups, once eventfd is readable
+         */
+        void clearWakeUp();
+
+        /**
+         * Approximate number of queued actions in a lane
+         * @param lane Priority lane
+         * @return Number of actions
+         */
+        size_t count(Lane lane) const { return rings[lane].count(); }
+
+        /**
+         * Get lane counters
+         * @param lane Priority lane
+         * @param stats Counters snapshot
+         */
+        void getStats(Lane lane, LaneStats &stats) const;
+
+        /**
+         * Display counters of all lanes on console
+         */
+        void printStats() const;
+
+        /**
+         * Lane name, used to display counters
+         * @param lane Priority lane
+         * @return Lane name
+         */
+        static const char *laneName(Lane lane);
+
+        /**
+         * Measure enqueue to dequeue latency of ActionQueue and
+         * of the previous POSIX mqueue implementation. Results
+         * are displayed on console
+         */
+        static void benchmark();
+    };
+}
+
+#endif //MATRICE210_ACTIONQUEUE_H
@@ -0,0 +1,126 @@
+/*! @file ActionTracer.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ActionTracer.h implementation
+ */
+
+#include "ActionTracer.h"
+
+#include "Action.h"
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+using namespace M210;
+
+ActionTracer::ActionTracer() {
+    enabled.store(false);
+    vehicleCallArmed.store(false);
+    pthread_mutex_init(&armed_mutex, nullptr);
+    armedReceiveTime = 0;
+    armedDispatchTime = 0;
+}
+
+void ActionTracer::setEnabled(bool enable) {
+    if(enable && !enabled.load())
+        reset();
+    enabled.store(enable);
+    if(!enable)
+        vehicleCallArmed.store(false);
+}
+
+void ActionTracer::recordDispatch(const ActionData *action) {
+    long long now = getMonotonicNs();
+    Histogram *h = histograms[action->getActionId()];
+    h[ENQUEUE].record(action->getEnqueueTime() - action->getReceiveTime());
+    h[DEQUEUE].record(action->getDequeueTime() - action->getEnqueueTime());
+    h[DISPATCH].record(now - action->getDequeueTime());
+
+    bool movement = action->getActionId() == ActionData::ActionId::mission &&
+                    action->getMissionTask() == Action::MissionAction::START &&
+                    (action->getMissionType() == Action::MissionType::VELOCITY ||
+                     action->getMissionType() == Action::MissionType::POSITION ||
+                     action->getMissionType() == Action::MissionType::POSITION_OFFSET);
+    if(!movement) {
+        h[TOTAL].record(now - action->getReceiveTime());
+        return;
+    }
+    // Armed before FlightController is called, its thread may send
+    // the order right after
+    pthread_mutex_lock(&armed_mutex);
+    armedReceiveTime = action->getReceiveTime();
+    armedDispatchTime = now;
+    vehicleCallArmed.store(true);
+    pthread_mutex_unlock(&armed_mutex);
+}
+
+void ActionTracer::recordVehicleCall() {
+    long long now = getMonotonicNs();
+    pthread_mutex_lock(&armed_mutex);
+    if(vehicleCallArmed.load()) {
+        vehicleCallArmed.store(false);
+        Histogram *h = histograms[ActionData::ActionId::mission];
+        h[VEHICLE_CALL].record(now - armedDispatchTime);
+        h[TOTAL].record(now - armedReceiveTime);
+    }
+    pthread_mutex_unlock(&armed_mutex);
+}
+
+void ActionTracer::reset() {
+    for(auto &byStage : histograms)
+        for(Histogram &h : byStage)
+            h.reset();
+}
+
+void ActionTracer::print() const {
+    DSTATUS("Action latency tracing %s [us]", enabled.load() ? "enabled" : "disabled");
+    for(int id = 0; id < ActionData::actionIdCount; id++) {
+        if(histograms[id][DEQUEUE].getCount() == 0)
+            continue;
+        DSTATUS("%s", ActionData::getActionName((ActionData::ActionId)id));
+        for(int stage = 0; stage < STAGE_COUNT; stage++) {
+            const Histogram &h = histograms[id][stage];
+            if(h.getCount() == 0)
+                continue;
+            DSTATUS("  %-12s %6lu values, avg %6lu, p50 %6lu, p90 %6lu, p99 %6lu, max %6lu",
+                    stageName((Stage)stage), (unsigned long)h.getCount(),
+                    (unsigned long)h.getAverage(), (unsigned long)h.percentile(50),
+                    (unsigned long)h.percentile(90), (unsigned long)h.percentile(99),
+                    (unsigned long)h.getMax());
+        }
+    }
+}
+
+void ActionTracer::sendToMobile() const {
+    bool traced = false;
+    for(int id = 0; id < ActionData::actionIdCount; id++) {
+        const Histogram &h = histograms[id][TOTAL];
+        if(h.getCount() == 0)
+            continue;
+        traced = true;
+        // Mobile log messages are limited to 100 characters
+        LSTATUS("%s : p50 %lu us, p99 %lu us, max %lu us",
+                ActionData::getActionName((ActionData::ActionId)id),
+                (unsigned long)h.percentile(50), (unsigned long)h.percentile(99),
+                (unsigned long)h.getMax());
+    }
+    if(!traced)
+        LSTATUS("No action traced");
+}
+
+const char *ActionTracer::stageName(Stage stage) {
+    switch(stage) {
+        case ENQUEUE:
+            return "Enqueue";
+        case DEQUEUE:
+            return "Dequeue";
+        case DISPATCH:
+            return "Dispatch";
+        case VEHICLE_CALL:
+            return "Vehicle call";
+        case TOTAL:
+            return "Total";
+        default:
+            return "Unknown";
+    }
+}
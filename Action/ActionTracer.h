@@ -0,0 +1,115 @@
+/*! @file ActionTracer.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Latency of the actions, from data reception to aircraft order.
+ *
+ *  An action is timestamped on reception (ActionData creation), when it is
+ *  added to the action queue and when it is removed. Action::process reports
+ *  dispatch, then FlightController reports the first order sent to the
+ *  vehicle after a movement has been dispatched. Each step latency is
+ *  counted in a Histogram by ActionId.
+ *
+ *  Tracing is disabled by default. When disabled, a tracepoint is a single
+ *  relaxed atomic load : the timestamps are already taken for the action
+ *  queue statistics and the time-to-live of the movements.
+ */
+
+#ifndef MATRICE210_ACTIONTRACER_H
+#define MATRICE210_ACTIONTRACER_H
+
+#include <atomic>
+
+#include <pthread.h>
+
+#include <dji_vehicle.hpp>
+
+#include "ActionData.h"
+#include "../util/Histogram.h"
+
+using namespace DJI::OSDK;
+
+namespace M210 {
+    class ActionTracer : public Singleton<ActionTracer> {
+    public:
+        enum Stage {        /*!< Traced steps, each one is measured from the previous one */
+            ENQUEUE,        /*!< Reception to Action::add */
+            DEQUEUE,        /*!< Action::add to removal by Action::process */
+            DISPATCH,       /*!< Removal to FlightController call */
+            VEHICLE_CALL,   /*!< FlightController call to first vehicle order, movements only */
+            TOTAL,          /*!< Reception to last traced step */
+            STAGE_COUNT
+        };
+    private:
+        std::atomic<bool> enabled;                                  /*!< Tracing state */
+        Histogram histograms[ActionData::actionIdCount][STAGE_COUNT]; /*!< Latencies, by action id and stage */
+        // Dispatched movement waiting for its first vehicle order
+        std::atomic<bool> vehicleCallArmed;     /*!< True if a movement has been dispatched and not yet sent */
+        pthread_mutex_t armed_mutex;            /*!< Protect armed times */
+        long long armedReceiveTime;             /*!< Reception time of the dispatched movement [ns] */
+        long long armedDispatchTime;            /*!< Dispatch time of the dispatched movement [ns] */
+
+        /**
+         * Record reception to dispatch steps of an action
+         * @param action Dispatched action
+         */
+        void recordDispatch(const ActionData *action);
+
+        /**
+         * Record first vehicle order step of the dispatched movement
+         */
+        void recordVehicleCall();
+    public:
+        ActionTracer();
+
+        /**
+         * Enable or disable tracing. Enabling resets histograms, disabling keeps
+         * them so they can be displayed
+         * @param enable Tracing state
+         */
+        void setEnabled(bool enable);
+
+        bool isEnabled() const { return enabled.load(); }
+
+        /**
+         * Tracepoint, action removed from queue is going to be given to FlightController
+         * @param action Dispatched action
+         */
+        void dispatched(const ActionData *action) {
+            if(enabled.load(std::memory_order_relaxed))
+                recordDispatch(action);
+        }
+
+        /**
+         * Tracepoint, an order has been sent to the vehicle by a mission
+         */
+        void vehicleCalled() {
+            if(vehicleCallArmed.load(std::memory_order_relaxed))
+                recordVehicleCall();
+        }
+
+        /**
+         * Set all histograms to 0
+         */
+        void reset();
+
+        /**
+         * Display histograms of traced actions on console
+         */
+        void print() const;
+
+        /**
+         * Send reception to last step latency of traced actions to mobile
+         */
+        void sendToMobile() const;
+
+        /**
+         * Stage name, used to display histograms
+         * @param stage Traced step
+         * @return Stage name
+         */
+        static const char *stageName(Stage stage);
+    };
+}
+
+#endif //MATRICE210_ACTIONTRACER_H
@@ -0,0 +1,233 @@
+/*! @file ControlArbiter.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief ControlArbiter.h implementation
+ */
+
+#include "ControlArbiter.h"
+
+#include <cassert>
+
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+using namespace M210;
+
+ControlArbiter::ControlArbiter() {
+    for(int i = 0; i < ActionData::sourceCount; i++) {
+        priorities[i].store(1);
+        grantedCnt[i].store(0);
+        droppedCnt[i].store(0);
+    }
+    priorities[ActionData::CONSOLE].store(2);
+    priorities[ActionData::REPLAY].store(0);
+}
+
+ControlArbiter::Kind ControlArbiter::kindOf(const ActionData *action) {
+    switch(action->getActionId()) {
+        case ActionData::ActionId::stopAircraft:
+            return SAFETY;
+        case ActionData::ActionId::emergencyStop:
+            return EMERGENCY;
+        case ActionData::ActionId::emergencyRelease:
+            return RELEASE;
+        case ActionData::ActionId::takeOff:
+        case ActionData::ActionId::landing:
+        case ActionData::ActionId::mission:
+        case ActionData::ActionId::obtainControlAuthority:
+            return CONTROL;
+        default:
+            return FREE;
+    }
+}
+
+bool ControlArbiter::admit(const ActionData *action) {
+    Kind kind = kindOf(action);
+    // Cheap path, no time read
+    if(kind == FREE || action->getSource() == ActionData::INTERNAL)
+        return true;
+    return admit(action->getSource(), kind, getMonotonicNs() / 1000000);
+}
+
+bool ControlArbiter::admit(ActionData::Source source, Kind kind, long long nowMs) {
+    if(kind == FREE || source == ActionData::INTERNAL)
+        return true;
+    if(kind == RELEASE)
+        return admitRelease(source);
+    if(kind == EMERGENCY)
+        setEmergencySource(source);
+    uint64_t desired = pack(source, nowMs + leaseDuration.load(std::memory_order_relaxed));
+    uint64_t current = lease.load();
+    bool held;
+    ActionData::Source owner;
+    do {
+        held = current != 0 && expiryOf(current) > nowMs;
+        owner = ownerOf(current);
+        if(held && owner != source && kind == CONTROL &&
+           priorities[source].load(std::memory_order_relaxed) <= priorities[owner].load(std::memory_order_relaxed)) {
+            droppedCnt[source].fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while(!lease.compare_exchange_weak(current, desired));
+
+    if(!held || owner != source) {
+        grantedCnt[source].fetch_add(1, std::memory_order_relaxed);
+        if(held) {
+            preemptedCnt.fetch_add(1, std::memory_order_relaxed);
+            LSTATUS("Control taken over by %s from %s", getSourceName(source), getSourceName(owner));
+        }
+    }
+    return true;
+}
+
+bool ControlArbiter::admitRelease(ActionData::Source source) {
+    int stopper = emergencySource.load();
+    if(stopper >= 0 && stopper != source &&
+       priorities[source].load(std::memory_order_relaxed) <= priorities[stopper].load(std::memory_order_relaxed)) {
+        releaseDroppedCnt.fetch_add(1, std::memory_order_relaxed);
+        droppedCnt[source].fetch_add(1, std::memory_order_relaxed);
+        LERROR("Emergency release refused, stop was set by %s", getSourceName((ActionData::Source)stopper));
+        return false;
+    }
+    // Lease is left as is, releasing does not give control
+    emergencySource.compare_exchange_strong(stopper, -1);
+    return true;
+}
+
+void ControlArbiter::setEmergencySource(ActionData::Source source) {
+    // A stop from a source with the same or a lower priority does not
+    // replace the outstanding one, it would become releasable by more sources
+    int stopper = emergencySource.load();
+    do {
+        if(stopper >= 0 && stopper != source &&
+           priorities[source].load(std::memory_order_relaxed) <= priorities[stopper].load(std::memory_order_relaxed))
+            return;
+    } while(!emergencySource.compare_exchange_weak(stopper, source));
+}
+
+void ControlArbiter::setPriority(ActionData::Source source, unsigned priority) {
+    if(source < 0 || source >= ActionData::sourceCount) {
+        DERROR("Unknown command source %d", (int)source);
+        return;
+    }
+    priorities[source].store(priority);
+}
+
+void ControlArbiter::setLeaseDuration(long long durationMs) {
+    leaseDuration.store(durationMs < 1 ? 1 : durationMs);
+}
+
+bool ControlArbiter::getOwner(ActionData::Source &owner) const {
+    uint64_t current = lease.load();
+    if(current == 0 || expiryOf(current) <= getMonotonicNs() / 1000000)
+        return false;
+    owner = ownerOf(current);
+    return true;
+}
+
+const char *ControlArbiter::getSourceName(ActionData::Source source) {
+    switch(source) {
+        case ActionData::INTERNAL:
+            return "internal";
+        case ActionData::MOBILE:
+            return "mobile";
+        case ActionData::CONSOLE:
+            return "console";
+        case ActionData::UART:
+            return "uart";
+        case ActionData::REPLAY:
+            return "replay";
+        default:
+            return "unknown";
+    }
+}
+
+void ControlArbiter::printStats() const {
+    ActionData::Source owner;
+    if(getOwner(owner))
+        DSTATUS("Control lease : %s", getSourceName(owner));
+    else
+        DSTATUS("Control lease : free");
+    DSTATUS("Lease duration : %lld ms, leases taken over : %lu, emergency releases refused : %lu",
+            leaseDuration.load(), preemptedCnt.load(std::memory_order_relaxed),
+            releaseDroppedCnt.load(std::memory_order_relaxed));
+    for(int i = ActionData::MOBILE; i < ActionData::sourceCount; i++) {
+        DSTATUS("%-8s priority %u : %lu leases granted, %lu actions dropped",
+                getSourceName((ActionData::Source)i), priorities[i].load(),
+                grantedCnt[i].load(std::memory_order_relaxed),
+                droppedCnt[i].load(std::memory_order_relaxed));
+    }
+}
+
+void ControlArbiter::unitTest() {
+    ControlArbiter arbiter;
+    arbiter.setLeaseDuration(100);
+    long long now = 1000;
+
+    // Free actions and internal source are never arbitrated
+    assert(arbiter.admit(ActionData::MOBILE, FREE, now));
+    assert(arbiter.admit(ActionData::INTERNAL, CONTROL, now));
+    ActionData::Source owner;
+    assert(!arbiter.getOwner(owner));
+
+    // First source gets the lease, others with same priority are dropped
+    assert(arbiter.admit(ActionData::MOBILE, CONTROL, now));
+    assert(!arbiter.admit(ActionData::UART, CONTROL, now + 50));
+    // Lease renewed by owner
+    assert(arbiter.admit(ActionData::MOBILE, CONTROL, now + 90));
+    assert(!arbiter.admit(ActionData::UART, CONTROL, now + 150));
+    // Lease expired
+    assert(arbiter.admit(ActionData::UART, CONTROL, now + 200));
+    assert(arbiter.grantedCnt[ActionData::UART].load() == 1);
+    assert(arbiter.droppedCnt[ActionData::UART].load() == 2);
+
+    // Higher priority takes over, lower priority is dropped
+    assert(arbiter.admit(ActionData::CONSOLE, CONTROL, now + 210));
+    assert(arbiter.preemptedCnt.load() == 1);
+    assert(!arbiter.admit(ActionData::MOBILE, CONTROL, now + 220));
+    assert(!arbiter.admit(ActionData::REPLAY, CONTROL, now + 220));
+
+    // Safety action always wins and takes the lease
+    assert(arbiter.admit(ActionData::MOBILE, SAFETY, now + 230));
+    assert(ownerOf(arbiter.lease.load()) == ActionData::MOBILE);
+    assert(!arbiter.admit(ActionData::UART, CONTROL, now + 240));
+
+    // Release
+    arbiter.release();
+    assert(arbiter.admit(ActionData::REPLAY, CONTROL, now + 250));
+    assert(ownerOf(arbiter.lease.load()) == ActionData::REPLAY);
+
+    // Emergency stop set from console cannot be released from mobile
+    ActionData release(ActionData::emergencyRelease, ActionData::MOBILE);
+    assert(kindOf(&release) == RELEASE);
+    assert(arbiter.admit(ActionData::CONSOLE, EMERGENCY, now + 300));
+    assert(ownerOf(arbiter.lease.load()) == ActionData::CONSOLE);
+    assert(!arbiter.admit(ActionData::MOBILE, RELEASE, now + 310));
+    assert(!arbiter.admit(ActionData::MOBILE, RELEASE, now + 1000));
+    assert(arbiter.releaseDroppedCnt.load() == 2);
+    // Console releases its own stop, then any source can release
+    assert(arbiter.admit(ActionData::CONSOLE, RELEASE, now + 1010));
+    assert(arbiter.admit(ActionData::MOBILE, RELEASE, now + 1020));
+    // Higher priority source releases a lower priority stop
+    assert(arbiter.admit(ActionData::MOBILE, EMERGENCY, now + 1030));
+    assert(arbiter.admit(ActionData::CONSOLE, RELEASE, now + 1040));
+    assert(arbiter.releaseDroppedCnt.load() == 2);
+    // Source with the same priority cannot release
+    assert(arbiter.admit(ActionData::MOBILE, EMERGENCY, now + 1050));
+    assert(!arbiter.admit(ActionData::UART, RELEASE, now + 1060));
+    assert(arbiter.admit(ActionData::MOBILE, RELEASE, now + 1070));
+    // Later lower priority stop does not replace console stop
+    assert(arbiter.admit(ActionData::CONSOLE, EMERGENCY, now + 1080));
+    assert(arbiter.admit(ActionData::MOBILE, EMERGENCY, now + 1090));
+    assert(arbiter.emergencySource.load() == ActionData::CONSOLE);
+    assert(!arbiter.admit(ActionData::MOBILE, RELEASE, now + 1100));
+    assert(arbiter.admit(ActionData::CONSOLE, RELEASE, now + 1110));
+    // Higher priority stop replaces a lower one
+    assert(arbiter.admit(ActionData::UART, EMERGENCY, now + 1120));
+    assert(arbiter.admit(ActionData::CONSOLE, EMERGENCY, now + 1130));
+    assert(!arbiter.admit(ActionData::UART, RELEASE, now + 1140));
+    assert(arbiter.admit(ActionData::CONSOLE, RELEASE, now + 1150));
+    assert(arbiter.emergencySource.load() == -1);
+    DSTATUS("ControlArbiter test passed");
+}
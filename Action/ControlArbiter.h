@@ -0,0 +1,154 @@
+/*! @file ControlArbiter.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Decide which command source is allowed to control the aircraft.
+ *
+ *  Console thread, Mobile callback and Uart thread add actions concurrently.
+ *  Actions which move the aircraft are only accepted from the source owning
+ *  the control lease. A lease is granted to the first source asking for
+ *  control, renewed by each of its accepted actions and lost once it has not
+ *  been renewed during the lease duration.
+ *  A source with a higher priority than the owner takes the lease over,
+ *  sources with the same or a lower priority are dropped.
+ *  Safety actions (stop, emergency) are always accepted, whatever their
+ *  source, and give the lease to their source.
+ *  An emergency stop can only be released by its source or by a source with
+ *  a higher priority, so mobile cannot release a stop set from the console.
+ *  Of several stops, the one from the highest priority source has to be released.
+ *
+ *  Lease is a single atomic word (owner and expiry), so an action from a
+ *  non-owner is dropped with one atomic load, before it uses a queue slot.
+ */
+
+#ifndef MATRICE210_CONTROLARBITER_H
+#define MATRICE210_CONTROLARBITER_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "ActionData.h"
+
+#define CONTROL_LEASE_DEFAULT_MS 1000   /*!< Default control lease duration [ms] */
+
+namespace M210 {
+    class ControlArbiter {
+    public:
+        enum Kind {         /*!< How an action is arbitrated */
+            FREE,           /*!< Never arbitrated (watchdog, data, hello world) */
+            CONTROL,        /*!< Needs the control lease */
+            SAFETY,         /*!< Always accepted, takes the control lease */
+            EMERGENCY,      /*!< Safety action, its source has to release it */
+            RELEASE         /*!< Accepted from the emergency source or a source with a higher priority */
+        };
+    private:
+        std::atomic<uint64_t> lease{0};         /*!< Owner source on 8 high bits, expiry [ms] on 56 low bits, 0 if none */
+        std::atomic<long long> leaseDuration{CONTROL_LEASE_DEFAULT_MS}; /*!< [ms] */
+        std::atomic<unsigned> priorities[ActionData::sourceCount];      /*!< Priority by source, higher wins */
+        std::atomic<unsigned long> grantedCnt[ActionData::sourceCount]; /*!< Leases granted, by source */
+        std::atomic<unsigned long> droppedCnt[ActionData::sourceCount]; /*!< Actions dropped, by source */
+        std::atomic<unsigned long> preemptedCnt{0};                     /*!< Leases taken over before their expiry */
+        std::atomic<int> emergencySource{-1};                           /*!< Highest priority source of outstanding stops, -1 if none */
+        std::atomic<unsigned long> releaseDroppedCnt{0};                /*!< Emergency releases refused */
+
+        static uint64_t pack(ActionData::Source owner, long long expiryMs) {
+            return ((uint64_t)owner << 56) | ((uint64_t)expiryMs & 0x00FFFFFFFFFFFFFFULL);
+        }
+
+        static ActionData::Source ownerOf(uint64_t lease) { return (ActionData::Source)(lease >> 56); }
+
+        static long long expiryOf(uint64_t lease) { return (long long)(lease & 0x00FFFFFFFFFFFFFFULL); }
+
+        /**
+         * Accept an emergency release from the emergency stop source, or
+         * from a source with a higher priority
+         * @param source Action source
+         * @return true if release can be queued
+         */
+        bool admitRelease(ActionData::Source source);
+
+        /**
+         * Record the source of an emergency stop, unless an outstanding stop
+         * comes from a source with the same or a higher priority
+         * @param source Action source
+         */
+        void setEmergencySource(ActionData::Source source);
+
+    public:
+        /**
+         * Set default priorities : console over mobile and uart,
+         * journal replay lowest
+         */
+        ControlArbiter();
+
+        /**
+         * Arbitration kind of an action
+         * @param action Action to add to queue
+         * @return Arbitration kind
+         */
+        static Kind kindOf(const ActionData *action);
+
+        /**
+         * Accept or drop an action, grant or renew the lease of its source.
+         * Never blocks, can be called from any thread
+         * @param action Action to add to queue
+         * @return true if action can be queued, false if it has to be dropped
+         */
+        bool admit(const ActionData *action);
+
+        /**
+         * Same as admit(action), time given by caller
+         * @param source Action source
+         * @param kind Arbitration kind of the action
+         * @param nowMs Monotonic time [ms]
+         * @return true if action can be queued, false if it has to be dropped
+         */
+        bool admit(ActionData::Source source, Kind kind, long long nowMs);
+
+        /**
+         * Release the lease whoever owns it. Next source asking for control gets it
+         */
+        void release() { lease.store(0); }
+
+        /**
+         * Set priority of a source. A source takes the lease over
+         * from an owner with a lower priority
+         * @param source Command source
+         * @param priority Source priority, higher wins
+         */
+        void setPriority(ActionData::Source source, unsigned priority);
+
+        /**
+         * Set time after which a lease not renewed is lost
+         * @param durationMs Lease duration [ms], at least 1
+         */
+        void setLeaseDuration(long long durationMs);
+
+        /**
+         * Current lease owner
+         * @param owner Lease owner, set if lease is held
+         * @return false if no source owns the lease
+         */
+        bool getOwner(ActionData::Source &owner) const;
+
+        /**
+         * Source name, used to display statistics
+         * @param source Command source
+         * @return Source name
+         */
+        static const char *getSourceName(ActionData::Source source);
+
+        /**
+         * Display lease owner, priorities and counters on console
+         */
+        void printStats() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_CONTROLARBITER_H
@@ -7,8 +7,14 @@
 
 #include "FlightController.h"
 
+#include <cerrno>
 #include <cmath>
+#include <ctime>
 #include <iostream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 #include <dji_linux_helpers.hpp>
 
@@ -17,6 +23,7 @@
 #include "../util/Log.h"
 #include "../util/timer.h"
 #include "../util/define.h"
+#include "../util/EventLoop.h"
 #include "../Managers/PackageManager.h"
 #include "../Managers/ThreadManager.h"
 #include "../Missions/MonitoredMission.h"
@@ -25,20 +32,31 @@
 #include "../Missions/PositionOffsetMission.h"
 #include "../Missions/WaypointsMission.h"
 #include "../Action/Action.h"
+#include "../Action/ActionData.h"
+#include "../Action/ActionExecutor.h"
+#include "../Action/ActionTracer.h"
 #include "../Gps/GpsAxis.h"
 
 using namespace M210;
 
 pthread_mutex_t FlightController::sendDataToMSDK_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t FlightController::smState_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t FlightController::smState_cond = PTHREAD_COND_INITIALIZER;
 
-FlightController::FlightController() {
+FlightController::FlightController() : controlScheduler("Control loop", 20000000LL) {
     linuxEnvironment = nullptr;
     vehicle = nullptr;
-    flightControllerThreadRunning = false;
-    watchdog = new Watchdog(50);
+    flightControllerThreadRunning.store(false);
+    setpointReceiveTime.store(0);
+    for (auto &rate : controlRates)
+        rate.store(CONTROL_RATE_DEFAULT);
+    // Watchdog triggered after 1 s of orders without mobile watchdog reset
+    watchdog = new Watchdog(1000);
     emergency = new Emergency();
-    setSMState(STOP);
+    benchmark = false;
+    idleWaiting.store(false);
+    SMState.store(WAIT);
+    setSMState(STOP, INIT);
     // Missions
     monitoredMission = new M210::MonitoredMission(this);
     positionMission = new M210::PositionMission(this);
@@ -49,11 +67,15 @@ FlightController::FlightController() {
 
 
 FlightController::~FlightController() {
+    stopFlightControllerThread();
+    if (idleWakeFd != -1)
+        close(idleWakeFd);
     delete watchdog;
     delete emergency;
     delete positionMission;
     delete velocityMission;
     delete positionOffsetMission;
+    delete monitoredMission;
 }
 
 
@@ -77,10 +99,10 @@ void FlightController::setupVehicle(int argc, char **argv) {
     } while (vehicle == nullptr);
 }
 
-void FlightController::obtainCtrlAuthority() {
+bool FlightController::obtainCtrlAuthority(const ActionToken *token) {
     if(vehicle == nullptr) {
         LERROR("Vehicle not initialized, setup vehicle first");
-        return;
+        return false;
     }
 
     ACK::ErrorCode ack;
@@ -92,118 +114,257 @@ void FlightController::obtainCtrlAuthority() {
             LERROR("Be sure aircraft has multiple flight modes enabled");
             delay_ms(1000);
         }
-    } while (ACK::getError(ack) != ACK::SUCCESS);
+    } while (ACK::getError(ack) != ACK::SUCCESS && !ActionToken::cancelled(token));
+    if (ACK::getError(ack) != ACK::SUCCESS) {
+        LSTATUS("Obtain control authority cancelled");
+        return false;
+    }
     LSTATUS("Control authority obtained");
+    return true;
 }
 
 void FlightController::launchFlightControllerThread() {
     // Launch flight controller thread if it is not already running
-    if (!flightControllerThreadRunning) {
-        flightControllerThreadRunning = true;
-        ThreadManager::start("flightCtrThread",
-                             &flightControllerThreadID, &flightControllerThreadAttr,
-                             flightControllerThread, (void *) this);
+    if (!flightControllerThreadRunning.load()) {
+        flightControllerThreadRunning.store(true);
+        if (!ThreadManager::start("flightCtrThread",
+                                  &flightControllerThreadID, &flightControllerThreadAttr,
+                                  flightControllerThread, (void *) this,
+                                  ThreadManager::CONTROL))
+            flightControllerThreadRunning.store(false);
     }
 }
 
+void FlightController::stopFlightControllerThread() {
+    if (!flightControllerThreadRunning.load())
+        return;
+    // Flag is modified under state mutex so that waitWhileIdle() cannot miss the wake up
+    pthread_mutex_lock(&smState_mutex);
+    flightControllerThreadRunning.store(false);
+    pthread_cond_broadcast(&smState_cond);
+    pthread_mutex_unlock(&smState_mutex);
+    ThreadManager::stop(&flightControllerThreadID, "flightCtrThread");
+}
+
 void *FlightController::flightControllerThread(void *param) {
     auto fc = (FlightController *) param;
-    while (fc->flightControllerThreadRunning) {
-        switch (fc->getSMState()) {
-            case WAIT:
-
-                break;
-            case STOP:
-                // TODO Remove if packages need to be keep while aircraft is stopped
-                PackageManager::instance().clear();
-                fc->setSMState(WAIT);
-                break;
-            case POSITION:
-                fc->positionMission->update();
-                // Orders are send at 50 Hz, as recommended by DJI
-                delay_ms(20);
-                break;
-            case VELOCITY:
-                fc->velocityMission->update();
-                // Orders are send at 50 Hz, as recommended by DJI
-                delay_ms(20);
-                break;
-            case POSITION_OFFSET:
-                fc->positionOffsetMission->update();
-                // Orders are send at 50 Hz, as recommended by DJI
-                delay_ms(20);
-                break;
+    while (fc->flightControllerThreadRunning.load()) {
+        if (fc->getSMState() == WAIT) {
+            // Nothing to send, sleep until a mission is started
+            fc->waitWhileIdle();
+            // Mission orders period starts now
+            fc->controlScheduler.start();
+        } else if (fc->controlTick()) {
+            fc->controlScheduler.waitNextPeriod();
         }
     }
     return nullptr;
 }
 
-bool FlightController::takeOff() {
-    return monitoredMission->takeOff();
+bool FlightController::controlTick() {
+    // Take-off and landing are followed whatever the mission flown
+    bool monitoring = monitoredMission->update();
+    switch (getSMState()) {
+        case WAIT:
+            return false;
+        case STOP: {
+            // Keep ticking until monitoring is done, packages are still used
+            if (monitoring) {
+                setSMStateFrom(STOP, MONITORED, MONITORING);
+                return true;
+            }
+            // TODO Remove if packages need to be keep while aircraft is stopped
+            // Packages belong to the flight instance, not to a benchmark one
+            if (!benchmark)
+                PackageManager::instance().clearAsync();
+            // Only if no mission has been started meanwhile
+            SMState_ expected = STOP;
+            if (SMState.compare_exchange_strong(expected, WAIT))
+                transitionLog.record(STOP, WAIT, STOP_DONE, getMonotonicNs());
+        }
+            return false;
+        case POSITION:
+            applyControlRate(Action::MissionType::POSITION);
+            positionMission->update();
+            return true;
+        case VELOCITY:
+            applyControlRate(Action::MissionType::VELOCITY);
+            velocityMission->update();
+            return true;
+        case POSITION_OFFSET:
+            applyControlRate(Action::MissionType::POSITION_OFFSET);
+            positionOffsetMission->update();
+            return true;
+        case MONITORED:
+            if (!monitoring) {
+                setSMStateFrom(MONITORED, STOP, MONITORING_DONE);
+                return false;
+            }
+            controlScheduler.setPeriod(1000000000LL / CONTROL_RATE_DEFAULT);
+            return true;
+    }
+    return false;
 }
 
-bool FlightController::landing() {
-    return monitoredMission->landing();
+bool FlightController::attach(EventLoop &loop) {
+    int timerFd = controlScheduler.openTimer();
+    idleWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (timerFd == -1 || idleWakeFd == -1) {
+        DERROR("Flight controller cannot be attached to event loop");
+        return false;
+    }
+    if (!loop.add(timerFd, EPOLLIN, controlTimerHandler, this) ||
+        !loop.add(idleWakeFd, EPOLLIN, idleWakeHandler, this))
+        return false;
+    // Timer is armed if a mission is already running
+    controlScheduler.start();
+    loopTick();
+    return true;
 }
 
-void FlightController::moveByPosition(const Vector3f *position, float yaw) {
+void FlightController::loopTick() {
+    // STOP is handled at once, as flight controller thread does
+    while (!controlTick()) {
+        if (getSMState() != WAIT)
+            continue;
+        // Same protocol as waitWhileIdle() : state is read after idleWaiting
+        // is set, setSMState() does the opposite and writes idleWakeFd
+        controlScheduler.suspendTimer();
+        idleWaiting.store(true);
+        if (SMState.load() == WAIT)
+            return;
+        idleWaiting.store(false);
+        controlScheduler.start();
+    }
+}
+
+void FlightController::controlTimerHandler(int fd, uint32_t events, void *arg) {
+    (void)fd;
+    (void)events;
+    auto fc = (FlightController *) arg;
+    fc->controlScheduler.timerExpired();
+    // Timer may still fire once after being suspended
+    if (!fc->idleWaiting.load())
+        fc->loopTick();
+}
+
+void FlightController::idleWakeHandler(int fd, uint32_t events, void *arg) {
+    (void)events;
+    auto fc = (FlightController *) arg;
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+        DERROR("Flight controller wake up read failed");
+    if (fc->idleWaiting.exchange(false)) {
+        // Mission orders period starts now
+        fc->controlScheduler.start();
+        fc->loopTick();
+    }
+}
+
+bool FlightController::takeOff(const ActionToken *token) {
+    if (ActionToken::cancelled(token) || !monitoredMission->start(MonitoredMission::TAKE_OFF, 1))
+        return false;
+    followMonitoring(TAKE_OFF);
+    return true;
+}
+
+bool FlightController::landing(const ActionToken *token) {
+    if (ActionToken::cancelled(token) || !monitoredMission->start(MonitoredMission::LANDING, 1))
+        return false;
+    followMonitoring(LANDING);
+    return true;
+}
+
+void FlightController::followMonitoring(SMCause_ cause) {
+    // A running mission ticks the monitoring itself, otherwise state machine
+    // is woken up. Retried if STOP is handled meanwhile
+    SMState_ state = getSMState();
+    while ((state == WAIT || state == STOP) && !setSMStateFrom(state, MONITORED, cause))
+        state = getSMState();
+}
+
+void FlightController::moveByPosition(const Vector3f *position, float yaw, long long receiveTime) {
     if(emergency->isEnabled(Emergency::displayError))
         return;
     // Mission parameters
+    if (getSMState() != POSITION)
+        positionMission->reset();
     positionMission->move(position, yaw);
-    setSMState(POSITION);
+    setpointReceiveTime.store(receiveTime != 0 ? receiveTime : getMonotonicNs());
+    setSMState(POSITION, MOVE_POSITION);
 
 }
 
-void FlightController::moveByVelocity(const Vector3f *velocity, float yaw) {
+void FlightController::moveByVelocity(const Vector3f *velocity, float yaw, long long receiveTime) {
     if(emergency->isEnabled(Emergency::displayError))
         return;
     // Mission parameters
+    if (getSMState() != VELOCITY)
+        velocityMission->reset();
     velocityMission->move(velocity, yaw);
-    setSMState(VELOCITY);
+    setpointReceiveTime.store(receiveTime != 0 ? receiveTime : getMonotonicNs());
+    setSMState(VELOCITY, MOVE_VELOCITY);
 }
 
 
-void FlightController::moveByPositionOffset(const Vector3f *offset, float yaw,
+void FlightController::moveByPositionOffset(const Vector3f *offset, float yaw, long long receiveTime,
                                             float posThreshold, float yawThreshold) {
-    setSMState(STOP);
-    if(emergency->isEnabled(Emergency::displayError))
+    if(emergency->isEnabled(Emergency::displayError)) {
+        setSMState(STOP, MOVE_POSITION_OFFSET);
+        return;
+    }
+    // Returns immediately, a running mission brakes before the new one starts
+    if (!positionOffsetMission->move(offset, yaw,
+                                     posThreshold, yawThreshold)) {
+        setSMState(STOP, MOVE_POSITION_OFFSET);
         return;
-    positionOffsetMission->move(offset, yaw,
-                                posThreshold, yawThreshold);
-    setSMState(POSITION_OFFSET);
+    }
+    setpointReceiveTime.store(receiveTime != 0 ? receiveTime : getMonotonicNs());
+    setSMState(POSITION_OFFSET, MOVE_POSITION_OFFSET);
 }
 
 void FlightController::stopAircraft() {
     // Stop aircraft
     vehicle->control->emergencyBrake();
+    // Stop take-off or landing monitoring before state machine sees STOP
+    monitoredMission->abort();
     // Stop state machine sending moving commands
-    setSMState(STOP);
-    // Stop waypoints mission
-    waypointMission->action(Action::MissionAction::STOP);
+    setSMState(STOP, STOP_AIRCRAFT);
+    // Aircraft is already braking, drop position offset mission
+    positionOffsetMission->abort();
+    // Stop waypoints mission, ACK is not waited for
+    waypointMission->stopAsync();
     LSTATUS("Aircraft stopped");
 }
 
 void FlightController::velocityAndYawRateCtrl(const Vector3f *velocity, float yaw) {
+    // No vehicle, emergency and watchdog messages would reach the mobile
+    if (benchmark)
+        return;
     if (!emergency->isEnabled()) {
         if(!watchdog->isEnabled()) {
-            watchdog->increment();
+            watchdog->increment((unsigned)(controlScheduler.getPeriod() / 1000000));
             // Send cardinal orders to the aircraft
             Vector2 v{velocity->x, velocity->y};
             Vector2 projected = GpsAxis::instance().projectVector(v);
             vehicle->control->velocityAndYawRateCtrl((float32_t)projected.x, (float32_t)projected.y, velocity->z, yaw);
+            ActionTracer::instance().vehicleCalled();
         }
     }
 }
 
 void FlightController::positionAndYawCtrl(const Vector3f *position, float yaw) {
+    // No vehicle, emergency and watchdog messages would reach the mobile
+    if (benchmark)
+        return;
     if (!emergency->isEnabled()) {
         if(!watchdog->isEnabled()) {
-            watchdog->increment();
+            watchdog->increment((unsigned)(controlScheduler.getPeriod() / 1000000));
             // Send cardinal orders to the aircraft
             Vector2 v{position->x, position->y};
             Vector2 projected = GpsAxis::instance().projectVector(v);
             vehicle->control->positionAndYawCtrl((float32_t)projected.x, (float32_t)projected.y, position->z, yaw);
+            ActionTracer::instance().vehicleCalled();
         }
     }
 }
@@ -218,7 +379,7 @@ void FlightController::emergencyStop() {
 
 void FlightController::emergencyRelease() {
     emergency->release();
-    setSMState(STOP);
+    setSMState(STOP, EMERGENCY_RELEASE);
     LSTATUS("Emergency break released !");
 }
 
@@ -228,9 +389,180 @@ void FlightController::sendDataToMSDK(const uint8_t *data, size_t length) const
     pthread_mutex_unlock(&sendDataToMSDK_mutex);
 }
 
-void FlightController::setSMState(FlightController::SMState_ mode) {
+long long FlightController::getSetpointAge() const {
+    switch (SMState.load()) {
+        case POSITION:
+        case VELOCITY:
+        case POSITION_OFFSET:
+            return getMonotonicNs() - setpointReceiveTime.load();
+        default:
+            return -1;
+    }
+}
+
+void FlightController::setSMState(FlightController::SMState_ mode, FlightController::SMCause_ cause) {
+    SMState_ old = SMState.exchange(mode);
+    if (old == mode)
+        return;
+    transitionLog.record(old, mode, cause, getMonotonicNs());
+    wakeUpIdle();
+}
+
+bool FlightController::setSMStateFrom(SMState_ expected, SMState_ mode, SMCause_ cause) {
+    if (!SMState.compare_exchange_strong(expected, mode))
+        return false;
+    transitionLog.record(expected, mode, cause, getMonotonicNs());
+    wakeUpIdle();
+    return true;
+}
+
+void FlightController::wakeUpIdle() {
+    // State is stored before idleWaiting is read, waitWhileIdle() does the opposite :
+    // either thread sees the new state or it is woken up
+    if (idleWaiting.load()) {
+        pthread_mutex_lock(&smState_mutex);
+        pthread_cond_broadcast(&smState_cond);
+        pthread_mutex_unlock(&smState_mutex);
+        // Event loop runtime, see loopTick()
+        if (idleWakeFd != -1) {
+            uint64_t one = 1;
+            if (write(idleWakeFd, &one, sizeof(one)) != sizeof(one))
+                DERROR("Flight controller wake up failed");
+        }
+    }
+}
+
+void FlightController::printTransitions() const {
+    TransitionLog::Transition transitions[TRANSITION_LOG_SIZE];
+    size_t count = transitionLog.snapshot(transitions, TRANSITION_LOG_SIZE);
+    long long now = getMonotonicNs() / 1000;
+    DSTATUS("State machine : %lu transitions, last %u [ms before now]",
+            (unsigned long)transitionLog.getCount(), (unsigned)count);
+    for (size_t i = 0; i < count; i++) {
+        const TransitionLog::Transition &t = transitions[i];
+        DSTATUS("  %10.1f %-16s -> %-16s %s", (now - t.time) / 1000.0,
+                getSMStateName(t.oldState), getSMStateName(t.newState), getSMCauseName(t.cause));
+    }
+}
+
+void FlightController::sendTransitionsToMobile() const {
+    // Only last transitions, each one is a mobile log message
+    const size_t mobileCount = 8;
+    TransitionLog::Transition transitions[mobileCount];
+    size_t count = transitionLog.snapshot(transitions, mobileCount);
+    long long now = getMonotonicNs() / 1000;
+    if (count == 0)
+        LSTATUS("No state machine transition");
+    for (size_t i = 0; i < count; i++) {
+        const TransitionLog::Transition &t = transitions[i];
+        LSTATUS("-%.1f ms %s -> %s (%s)", (now - t.time) / 1000.0,
+                getSMStateName(t.oldState), getSMStateName(t.newState), getSMCauseName(t.cause));
+    }
+}
+
+const char *FlightController::getSMStateName(unsigned state) {
+    switch (state) {
+        case WAIT:
+            return "WAIT";
+        case STOP:
+            return "STOP";
+        case VELOCITY:
+            return "VELOCITY";
+        case POSITION_OFFSET:
+            return "POSITION_OFFSET";
+        case POSITION:
+            return "POSITION";
+        case MONITORED:
+            return "MONITORED";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+const char *FlightController::getSMCauseName(unsigned cause) {
+    switch (cause) {
+        case INIT:
+            return "init";
+        case STOP_DONE:
+            return "stop done";
+        case MOVE_VELOCITY:
+            return "moveByVelocity";
+        case MOVE_POSITION_OFFSET:
+            return "moveByPositionOffset";
+        case MOVE_POSITION:
+            return "moveByPosition";
+        case STOP_AIRCRAFT:
+            return "stopAircraft";
+        case EMERGENCY_RELEASE:
+            return "emergencyRelease";
+        case BENCHMARK:
+            return "benchmark";
+        case TAKE_OFF:
+            return "takeOff";
+        case LANDING:
+            return "landing";
+        case MONITORING:
+            return "monitoring";
+        case MONITORING_DONE:
+            return "monitoring done";
+        default:
+            return "unknown";
+    }
+}
+
+void FlightController::applyControlRate(unsigned missionType) {
+    controlScheduler.setPeriod(1000000000LL / controlRates[missionType].load());
+}
+
+bool FlightController::setControlRate(unsigned missionType, unsigned rate) {
+    switch (missionType) {
+        case Action::MissionType::VELOCITY:
+        case Action::MissionType::POSITION:
+        case Action::MissionType::POSITION_OFFSET:
+            break;
+        default:
+            LERROR("Control rate cannot be set for mission type %u", missionType);
+            return false;
+    }
+    if (rate < CONTROL_RATE_MIN || rate > CONTROL_RATE_MAX) {
+        LERROR("Control rate must be between %u and %u Hz", CONTROL_RATE_MIN, CONTROL_RATE_MAX);
+        return false;
+    }
+    controlRates[missionType].store(rate);
+    LSTATUS("Mission type %u control rate set to %u Hz", missionType, rate);
+    return true;
+}
+
+unsigned FlightController::getControlRate(unsigned missionType) const {
+    if (missionType >= CONTROL_RATE_SLOTS)
+        return 0;
+    return controlRates[missionType].load();
+}
+
+void FlightController::setInterpolation(bool enable) {
+    velocityMission->setInterpolation(enable);
+    positionMission->setInterpolation(enable);
+}
+
+bool FlightController::isInterpolating() const {
+    return velocityMission->isInterpolating();
+}
+
+void FlightController::setMinimumJerk(bool enable) {
+    positionOffsetMission->setStrategy(enable ? PositionOffsetMission::MINIMUM_JERK
+                                              : PositionOffsetMission::RECEDING);
+}
+
+bool FlightController::isMinimumJerk() const {
+    return positionOffsetMission->getStrategy() == PositionOffsetMission::MINIMUM_JERK;
+}
+
+void FlightController::waitWhileIdle() {
     pthread_mutex_lock(&smState_mutex);
-    SMState = mode;
+    idleWaiting.store(true);
+    while (SMState.load() == WAIT && flightControllerThreadRunning.load())
+        pthread_cond_wait(&smState_cond, &smState_mutex);
+    idleWaiting.store(false);
     pthread_mutex_unlock(&smState_mutex);
 }
 
@@ -260,6 +592,248 @@ bool FlightController::startGlobalPositionBroadcast(Vehicle *vehicle) {
     return true;
 }
 
-void FlightController::waypointsMissionAction(unsigned task) {
-    waypointMission->action(task);
+bool FlightController::waypointsMissionAction(unsigned task, const ActionToken *token) {
+    return waypointMission->action(task, token);
+}
+
+namespace {
+    const unsigned IDLE_BENCHMARK_DURATION_MS = 2000;  /*!< Duration of each measure */
+    std::atomic<bool> idleBenchmarkRunning;             /*!< Stop emulated busy loop */
+
+    /**
+     * Process CPU time, all threads included
+     * @return CPU time [ns]
+     */
+    long long getProcessCpuNs() {
+        struct timespec ts{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    }
+
+    /**
+     * Measure process CPU usage during IDLE_BENCHMARK_DURATION_MS
+     * @return CPU usage, 100 % is one full core
+     */
+    double measureCpuUsage() {
+        long long cpuStart = getProcessCpuNs();
+        long long start = getMonotonicNs();
+        delay_ms(IDLE_BENCHMARK_DURATION_MS);
+        long long cpu = getProcessCpuNs() - cpuStart;
+        long long elapsed = getMonotonicNs() - start;
+        return 100.0 * cpu / elapsed;
+    }
+
+    /**
+     * Previous WAIT state of the flight controller thread, loops without sleep
+     * @param param -
+     * @return -
+     */
+    void *busyWaitThread(void *param) {
+        (void)param;
+        while (idleBenchmarkRunning.load()) {
+            // Same as previous empty WAIT case
+        }
+        return nullptr;
+    }
+}
+
+void FlightController::idleBenchmark() {
+    double reference = measureCpuUsage();
+    DSTATUS("Idle benchmark - process without flight controller thread : %.1f %% CPU", reference);
+
+    // Flight controller thread in WAIT state, no vehicle needed
+    auto fc = new FlightController();
+    fc->benchmark = true;
+    fc->setSMState(WAIT, BENCHMARK);
+    fc->launchFlightControllerThread();
+    double eventDriven = measureCpuUsage();
+    // Wake up time of the thread : WAIT -> STOP -> WAIT
+    long long wakeStart = getMonotonicNs();
+    fc->setSMState(STOP, BENCHMARK);
+    while (fc->getSMState() != WAIT)
+        sched_yield();
+    long long wakeDuration = getMonotonicNs() - wakeStart;
+    delete fc;
+    DSTATUS("Idle benchmark - blocking WAIT state : %.1f %% CPU, wake up and stop %.1f us",
+            eventDriven, wakeDuration / 1000.0);
+
+    // Previous busy loop
+    pthread_t busyThreadID;
+    pthread_attr_t busyThreadAttr;
+    idleBenchmarkRunning.store(true);
+    if (ThreadManager::start("idleBenchmark", &busyThreadID, &busyThreadAttr,
+                             busyWaitThread, nullptr)) {
+        double busy = measureCpuUsage();
+        idleBenchmarkRunning.store(false);
+        pthread_join(busyThreadID, nullptr);
+        DSTATUS("Idle benchmark - previous busy WAIT state : %.1f %% CPU", busy);
+    }
+}
+
+namespace {
+    const unsigned RUNTIME_BENCHMARK_DURATION_MS = 3000;    /*!< Duration of each measure */
+    const unsigned RUNTIME_BENCHMARK_INPUT_PERIOD_MS = 20;  /*!< Emulated mobile setpoints and uart frames period */
+
+    /**
+     * Inputs and consumers shared by both runtimes, no vehicle needed.
+     * Setpoints are added to an Action in dry-run mode as the mobile
+     * callback does, uart frames are written in a pipe
+     */
+    struct RuntimeBenchmarkLoad {
+        Action action;
+        int uartPipe[2];
+        std::atomic<bool> running{true};
+        std::atomic<unsigned long> uartBytes{0};
+        pthread_t inputThreadID;
+        pthread_attr_t inputThreadAttr;
+    };
+
+    /**
+     * Emulates DJI mobile callback and STM32 frames, runs in both runtimes
+     * @param param RuntimeBenchmarkLoad
+     * @return -
+     */
+    void *runtimeInputThread(void *param) {
+        auto load = (RuntimeBenchmarkLoad *) param;
+        const char frame[] = "0|1234@";
+        while (load->running.load()) {
+            auto setpoint = new ActionData(ActionData::ActionId::mission);
+            if (setpoint != nullptr) {
+                setpoint->encodeMission<Action::VELOCITY>(Action::MissionAction::START, MovementPayload{});
+                load->action.add(setpoint);
+            }
+            if (write(load->uartPipe[1], frame, sizeof(frame) - 1) == -1)
+                break;
+            delay_ms(RUNTIME_BENCHMARK_INPUT_PERIOD_MS);
+        }
+        return nullptr;
+    }
+
+    /**
+     * Threaded runtime action consumer, as main does
+     * @param param RuntimeBenchmarkLoad
+     * @return -
+     */
+    void *runtimeActionThread(void *param) {
+        auto load = (RuntimeBenchmarkLoad *) param;
+        while (load->running.load())
+            load->action.process();
+        return nullptr;
+    }
+
+    /**
+     * Threaded runtime uart rx thread, as Uart does
+     * @param param RuntimeBenchmarkLoad
+     * @return -
+     */
+    void *runtimeUartThread(void *param) {
+        auto load = (RuntimeBenchmarkLoad *) param;
+        uint8_t buffer[64];
+        ssize_t length;
+        while ((length = read(load->uartPipe[0], buffer, sizeof(buffer))) > 0)
+            load->uartBytes += (unsigned long)length;
+        return nullptr;
+    }
+
+    /**
+     * Event loop runtime uart handler
+     * @param fd Pipe read end
+     * @param events Ready events
+     * @param arg RuntimeBenchmarkLoad
+     */
+    void runtimeUartHandler(int fd, uint32_t events, void *arg) {
+        (void)events;
+        auto load = (RuntimeBenchmarkLoad *) arg;
+        uint8_t buffer[64];
+        ssize_t length = read(fd, buffer, sizeof(buffer));
+        if (length > 0)
+            load->uartBytes += (unsigned long)length;
+    }
+
+    void *runtimeLoopThread(void *param) {
+        ((EventLoop *) param)->run();
+        return nullptr;
+    }
+
+    /**
+     * Context switches of the process, all threads included
+     * @param voluntary Voluntary context switches (blocking wait)
+     * @param involuntary Involuntary context switches (preemption)
+     */
+    void getContextSwitches(long &voluntary, long &involuntary) {
+        struct rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        voluntary = usage.ru_nvcsw;
+        involuntary = usage.ru_nivcsw;
+    }
+}
+
+void FlightController::runtimeBenchmark() {
+    DSTATUS("Runtime benchmark - %u ms by runtime, velocity mission at %u Hz, inputs every %u ms",
+            RUNTIME_BENCHMARK_DURATION_MS, CONTROL_RATE_DEFAULT, RUNTIME_BENCHMARK_INPUT_PERIOD_MS);
+    for (int eventLoop = 0; eventLoop < 2; eventLoop++) {
+        RuntimeBenchmarkLoad load;
+        load.action.setDryRun(true);
+        load.action.setJournaling(false);
+        if (pipe(load.uartPipe) == -1) {
+            DERROR("Runtime benchmark pipe creation failed");
+            return;
+        }
+        // Orders are not sent without vehicle, missions are ticked as in flight.
+        // Benchmark instance leaves packages and mobile link untouched
+        auto fc = new FlightController();
+        fc->benchmark = true;
+        EventLoop loop;
+        pthread_t actionThreadID, uartThreadID, loopThreadID;
+        pthread_attr_t actionThreadAttr, uartThreadAttr, loopThreadAttr;
+        if (eventLoop) {
+            fc->attach(loop);
+            load.action.attach(loop);
+            loop.add(load.uartPipe[0], EPOLLIN, runtimeUartHandler, &load);
+            ThreadManager::start("benchLoop", &loopThreadID, &loopThreadAttr,
+                                 runtimeLoopThread, &loop, ThreadManager::CONTROL);
+        } else {
+            fc->launchFlightControllerThread();
+            ThreadManager::start("benchAction", &actionThreadID, &actionThreadAttr,
+                                 runtimeActionThread, &load);
+            ThreadManager::start("benchUart", &uartThreadID, &uartThreadAttr,
+                                 runtimeUartThread, &load);
+        }
+        ThreadManager::start("benchInput", &load.inputThreadID, &load.inputThreadAttr,
+                             runtimeInputThread, &load);
+        fc->setSMState(VELOCITY, BENCHMARK);
+
+        // Measure
+        fc->controlScheduler.reset();
+        long voluntary, involuntary, voluntaryEnd, involuntaryEnd;
+        getContextSwitches(voluntary, involuntary);
+        long long start = getMonotonicNs();
+        delay_ms(RUNTIME_BENCHMARK_DURATION_MS);
+        getContextSwitches(voluntaryEnd, involuntaryEnd);
+        double seconds = (getMonotonicNs() - start) / 1000000000.0;
+        const PeriodicScheduler &scheduler = fc->controlScheduler;
+        DSTATUS("%-12s : %5.0f voluntary + %5.0f involuntary context switches/s, control jitter p50 %5lu us, "
+                "p99 %5lu us, max %5lu us, %lu missed periods",
+                eventLoop ? "Event loop" : "Threads", (voluntaryEnd - voluntary) / seconds,
+                (involuntaryEnd - involuntary) / seconds,
+                (unsigned long)scheduler.getJitter().percentile(50),
+                (unsigned long)scheduler.getJitter().percentile(99),
+                (unsigned long)scheduler.getJitter().getMax(), scheduler.getMissedPeriods());
+
+        // Stop inputs, then consumers
+        load.running.store(false);
+        pthread_join(load.inputThreadID, nullptr);
+        close(load.uartPipe[1]);
+        if (eventLoop) {
+            loop.stop();
+            pthread_join(loopThreadID, nullptr);
+        } else {
+            // Wake up action consumer so that it sees the end
+            load.action.interrupt();
+            pthread_join(actionThreadID, nullptr);
+            pthread_join(uartThreadID, nullptr);
+        }
+        close(load.uartPipe[0]);
+        delete fc;
+    }
 }
@@ -6,17 +6,30 @@
  *  It contains a dedicated thread that implements a state machine. The goal is to
  *  continuously send order to the aircraft when a mission is running.
  *  Many types of missions are existing, for details see Missions folder
+ *
+ *  With the single-threaded runtime, the state machine is driven by an event
+ *  loop instead : the control scheduler timerfd calls controlTick() once per
+ *  period and is disarmed in WAIT state, see attach().
  */
 
 #ifndef MATRICE210_FLIGHTCONTROLLER_HPP
 #define MATRICE210_FLIGHTCONTROLLER_HPP
 
 // System includes
+#include <atomic>
 #include <pthread.h>
 
 // DJI OSDK includes
 #include <dji_vehicle.hpp>
 
+#include "TransitionLog.h"
+#include "../util/PeriodicScheduler.h"
+
+#define CONTROL_RATE_DEFAULT 50     /*!< Orders frequency [Hz], 50 Hz as recommended by DJI */
+#define CONTROL_RATE_MIN 10         /*!< Lowest configurable orders frequency [Hz] */
+#define CONTROL_RATE_MAX 100        /*!< Highest configurable orders frequency [Hz] */
+#define CONTROL_RATE_SLOTS 4        /*!< Action::MissionType values 0 to POSITION_OFFSET */
+
 using namespace std;
 using namespace DJI::OSDK;
 using namespace DJI::OSDK::Telemetry;
@@ -31,27 +44,119 @@ class LinuxSetup;
     class VelocityMission;
     class PositionOffsetMission;
     class WaypointMission;
+    class ActionToken;
+    class EventLoop;
 
     class FlightController {
     private:
         // Flight controller thread
-        bool flightControllerThreadRunning;         /*!< Flight controller thread state */
+        std::atomic<bool> flightControllerThreadRunning; /*!< Flight controller thread state */
         pthread_t flightControllerThreadID;         /*!< Flight controller thread id */
         pthread_attr_t flightControllerThreadAttr;  /*!< Flight controller thread attributes */
         static void *flightControllerThread(void *param); /*!< Flight controller thread, state machine */
+        /**
+         * Block flight controller thread while state machine is in WAIT state.
+         * Woken up by setSMState() or stopFlightControllerThread()
+         */
+        void waitWhileIdle();
+
+        /**
+         * Run state machine once : update running mission or handle STOP
+         * @return true if a mission has been updated and next period has
+         * to be waited, false in WAIT and STOP states
+         */
+        bool controlTick();
+
+        // Event loop
+        int idleWakeFd{-1};     /*!< eventfd written by setSMState() when loop is idle, -1 if not attached */
+
+        /**
+         * Event loop counterpart of the flight controller thread loop,
+         * called on each control period. Suspends the timer in WAIT state
+         */
+        void loopTick();
+
+        /**
+         * Event loop handler of the control scheduler timer
+         * @param fd Timer fd
+         * @param events Ready events
+         * @param arg FlightController instance
+         */
+        static void controlTimerHandler(int fd, uint32_t events, void *arg);
+
+        /**
+         * Event loop handler, state machine left WAIT state
+         * @param fd Idle wake eventfd
+         * @param events Ready events
+         * @param arg FlightController instance
+         */
+        static void idleWakeHandler(int fd, uint32_t events, void *arg);
+    public:
         enum SMState_ {                             /*!< State machine states, used by flight controller thread */
             WAIT,
             STOP,
             VELOCITY,
             POSITION_OFFSET,
-            POSITION
-        } SMState;
+            POSITION,
+            MONITORED                               /*!< Take-off or landing monitored, no mission flown */
+        };
+        enum SMCause_ {                             /*!< State machine transitions causes, recorded in transition log */
+            INIT,
+            STOP_DONE,
+            MOVE_VELOCITY,
+            MOVE_POSITION_OFFSET,
+            MOVE_POSITION,
+            STOP_AIRCRAFT,
+            EMERGENCY_RELEASE,
+            BENCHMARK,
+            TAKE_OFF,
+            LANDING,
+            MONITORING,
+            MONITORING_DONE
+        };
+    private:
+        std::atomic<SMState_> SMState;              /*!< State machine state, read without lock */
+        std::atomic<bool> idleWaiting;              /*!< True while flight controller thread waits in WAIT state */
+        TransitionLog transitionLog;                /*!< Last state machine transitions */
+        std::atomic<long long> setpointReceiveTime; /*!< Reception time of the last setpoint given to a mission [ns] */
+        PeriodicScheduler controlScheduler;         /*!< Period of the orders sent by missions */
+        std::atomic<unsigned> controlRates[CONTROL_RATE_SLOTS]; /*!< Orders frequency by mission type [Hz] */
+
+        /**
+         * Set control period from control rate of a mission type.
+         * Called by flight controller thread before each mission update
+         * @param missionType Action::MissionType value
+         */
+        void applyControlRate(unsigned missionType);
+
+        /**
+         * Change state machine state only if it is still the expected one.
+         * Same wake up as setSMState()
+         * @param expected State to leave
+         * @param mode New state
+         * @param cause Transition cause
+         * @return false if state machine is not in expected state
+         */
+        bool setSMStateFrom(SMState_ expected, SMState_ mode, SMCause_ cause);
+
+        /**
+         * Wake up an idle flight controller thread or event loop
+         */
+        void wakeUpIdle();
+
+        /**
+         * Enter MONITORED state if no mission is flown, once a take-off
+         * or a landing is started
+         * @param cause TAKE_OFF or LANDING
+         */
+        void followMonitoring(SMCause_ cause);
 
         // Aircraft
         LinuxSetup *linuxEnvironment;   /*!< Pointer to used linux environment */
         Vehicle *vehicle;               /*!< Pointer to used vehicle */
         Emergency *emergency;           /*!< Emergency state */
         Watchdog *watchdog;             /*!< Watchdog */
+        bool benchmark;                 /*!< Benchmark instance, shared managers are left untouched */
 
         // Missions
         M210::MonitoredMission *monitoredMission;               /*!< Monitored mission */
@@ -61,7 +166,8 @@ class LinuxSetup;
         M210::WaypointMission *waypointMission;                 /*!< Waypoints mission */
         // Mutex
         static pthread_mutex_t sendDataToMSDK_mutex;            /*!< Ensure that data are sent one by one to the mobile */
-        static pthread_mutex_t smState_mutex;                   /*!< Protect state machine states modification */
+        static pthread_mutex_t smState_mutex;                   /*!< Used with smState_cond to wake up flight controller thread */
+        static pthread_cond_t smState_cond;                     /*!< Signaled when state machine leaves WAIT state */
     public :
         /**
          * Initialize flight controller and create mission
@@ -82,15 +188,31 @@ class LinuxSetup;
         void setupVehicle(int argc, char **argv);
 
         /**
-        * Blocking call to obtain control authority
+        * Blocking call to obtain control authority, retries until it works
+        * @param token Stop retrying when cancelled, can be nullptr
+        * @return true if control authority is obtained
         */
-        void obtainCtrlAuthority();
+        bool obtainCtrlAuthority(const ActionToken *token = nullptr);
 
         /**
          * Launch flight controller thread
          */
         void launchFlightControllerThread();
 
+        /**
+         * Drive state machine from an event loop instead of launching
+         * the flight controller thread
+         * @param loop Event loop of the single-threaded runtime
+         * @return false if timer or eventfd cannot be created
+         */
+        bool attach(EventLoop &loop);
+
+        /**
+         * Stop flight controller thread and wait for its end,
+         * at most THREAD_JOIN_TIMEOUT_MS
+         */
+        void stopFlightControllerThread();
+
         /**
          * Send data to mobile SDK
          * @param data Pointer to data to send
@@ -100,17 +222,21 @@ class LinuxSetup;
 
         // Movement control
         /**
-         * Monitored take-off blocking call
-         * @return True if take-off success
+         * Monitored take-off. Waits only for the take-off ACK, monitoring
+         * is then done by the state machine on each control tick
+         * (MONITORED state if no mission is flown). Stopped by stopAircraft()
+         * @param token Take-off is not sent if cancelled, can be nullptr
+         * @return True if take-off is started
          */
-        bool takeOff();
+        bool takeOff(const ActionToken *token = nullptr);
 
         /**
-         * Monitored landing blocking call.
-         * @return True is landing success
+         * Monitored landing, same as takeOff()
+         * @param token Landing is not sent if cancelled, can be nullptr
+         * @return True is landing is started
          *
          */
-        bool landing();
+        bool landing(const ActionToken *token = nullptr);
 
         /**
          * Control the position and yaw angle of the vehicle.
@@ -120,8 +246,9 @@ class LinuxSetup;
          * Vector is relative to the ground
          * x face to north, y face to east, z face to sky
          * @param yaw Absolute yaw angle to set [deg}
+         * @param receiveTime Monotonic reception time of the setpoint [ns], 0 for now
          */
-        void moveByPosition(const Vector3f *offset, float yaw);
+        void moveByPosition(const Vector3f *offset, float yaw, long long receiveTime = 0);
 
         /**
          * Velocity Control. Allows user to set a velocity vector.
@@ -130,8 +257,9 @@ class LinuxSetup;
          * Vector is relative to the ground
          * x face to north, y face to east, z face to sky
          * @param yaw Absolute yaw rate to set [deg/s]
+         * @param receiveTime Monotonic reception time of the setpoint [ns], 0 for now
          */
-        void moveByVelocity(const Vector3f *velocity, float yaw);
+        void moveByVelocity(const Vector3f *velocity, float yaw, long long receiveTime = 0);
 
         /**
          * Position Control. Allows user to set an offset from current location.
@@ -140,17 +268,21 @@ class LinuxSetup;
          * Vector is relative to the ground
          * x face to north, y face to east, z face to sky
          * @param yaw Absolute yaw angle to set [deg]
+         * @param receiveTime Monotonic reception time of the setpoint [ns], 0 for now
          * @param posThreshold Position threshold used by mission to consider position as reached [m]
          * @param yawThreshold Angle threshold used by mission to consider angle as reached [deg]
          */
         void moveByPositionOffset(const Vector3f *offset, float yaw,
+                                  long long receiveTime = 0,
                                   float posThreshold = 0.2,
                                   float yawThreshold = 1.0);
         /**
          * Modify action flow of the waypoints mission
          * @param task Task to do, value of Action::MissionAction (Action.h) structure
+         * @param token Checked between waypoints uploads, can be nullptr
+         * @return true if task succeeded
          */
-        void waypointsMissionAction(unsigned task);
+        bool waypointsMissionAction(unsigned task, const ActionToken *token = nullptr);
 
         // Stop and emergency
         /**
@@ -195,11 +327,74 @@ class LinuxSetup;
         /** Getters and setters functions */
         Vehicle *getVehicle() const { return vehicle; }
 
-        SMState_ getSMState() const { return SMState; }
+        SMState_ getSMState() const { return SMState.load(); }
+
+        /**
+         * Age of the setpoint flown by current mission, counted from its reception
+         * @return Age [ns], -1 if no mission is flown
+         */
+        long long getSetpointAge() const;
 
         Watchdog *getWatchdog() const { return watchdog; }
 
-        void setSMState(SMState_ mode);
+        const PeriodicScheduler &getControlScheduler() const { return controlScheduler; }
+
+        /**
+         * Set frequency at which orders are sent to the aircraft by a mission.
+         * Applied on next update of the mission
+         * @param missionType Action::MissionType value : VELOCITY, POSITION or POSITION_OFFSET
+         * @param rate Orders frequency, CONTROL_RATE_MIN to CONTROL_RATE_MAX [Hz]
+         * @return false if mission type or rate is not valid
+         */
+        bool setControlRate(unsigned missionType, unsigned rate);
+
+        /**
+         * @param missionType Action::MissionType value
+         * @return Orders frequency of the mission [Hz], 0 if mission type is not valid
+         */
+        unsigned getControlRate(unsigned missionType) const;
+
+        /**
+         * Enable or disable interpolation of velocity and position setpoints
+         * between two control ticks, see SetpointInterpolator.h. Disabled
+         * by default
+         * @param enable Interpolation state
+         */
+        void setInterpolation(bool enable);
+
+        bool isInterpolating() const;
+
+        /**
+         * Select minimum-jerk trajectory or receding setpoint (default) for
+         * next position offset missions, see PositionOffsetMission.h
+         * @param enable true for minimum-jerk trajectory
+         */
+        void setMinimumJerk(bool enable);
+
+        bool isMinimumJerk() const;
+
+        /**
+         * Change state machine state, never blocks except to wake up
+         * an idle flight controller thread. Transition is recorded if
+         * state changes
+         * @param mode New state
+         * @param cause Transition cause
+         */
+        void setSMState(SMState_ mode, SMCause_ cause);
+
+        /**
+         * Display last state machine transitions on console
+         */
+        void printTransitions() const;
+
+        /**
+         * Send last state machine transitions to mobile
+         */
+        void sendTransitionsToMobile() const;
+
+        static const char *getSMStateName(unsigned state);
+
+        static const char *getSMCauseName(unsigned cause);
 
     // Static functions
     public:
@@ -210,6 +405,22 @@ class LinuxSetup;
          * @return True if broadcast successfully started
          */
         static bool startGlobalPositionBroadcast(Vehicle *vehicle);
+
+        /**
+         * Measure process CPU usage while flight controller thread is idle
+         * (WAIT state), then while emulating previous busy loop.
+         * No vehicle is needed. Results are displayed on console
+         */
+        static void idleBenchmark();
+
+        /**
+         * Compare threaded runtime (flight controller, action and uart
+         * threads) with the single-threaded event loop runtime, under the
+         * same emulated inputs. Displays context switches per second and
+         * control period jitter. No vehicle is needed, no order nor
+         * message is sent and packages are left untouched
+         */
+        static void runtimeBenchmark();
     };
 }
 
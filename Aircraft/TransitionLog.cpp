@@ -0,0 +1,83 @@
+/*! @file TransitionLog.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief TransitionLog.h implementation
+ */
+
+#include "TransitionLog.h"
+
+#include <cassert>
+
+#include <dji_vehicle.hpp>
+
+using namespace M210;
+
+namespace {
+    // Packed transition : time [us] on 48 bits (about 8 years), cause on 8 bits,
+    // old and new states on 4 bits each. Time starts at 1 so a cell is never 0
+    const unsigned TIME_SHIFT = 16;
+    const unsigned CAUSE_SHIFT = 8;
+    const unsigned OLD_STATE_SHIFT = 4;
+    const uint64_t TIME_MASK = (1ULL << 48) - 1;
+}
+
+TransitionLog::TransitionLog() {
+    for(auto &cell : cells)
+        cell.store(0, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+}
+
+void TransitionLog::record(unsigned oldState, unsigned newState, unsigned cause, long long timeNs) {
+    uint64_t time = ((uint64_t)(timeNs / 1000) + 1) & TIME_MASK;
+    uint64_t packed = time << TIME_SHIFT |
+                      (uint64_t)(cause & 0xFF) << CAUSE_SHIFT |
+                      (uint64_t)(oldState & 0xF) << OLD_STATE_SHIFT |
+                      (uint64_t)(newState & 0xF);
+    uint64_t index = head.fetch_add(1, std::memory_order_relaxed);
+    cells[index & (TRANSITION_LOG_SIZE - 1)].store(packed, std::memory_order_release);
+}
+
+size_t TransitionLog::snapshot(Transition *transitions, size_t max) const {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t available = end < TRANSITION_LOG_SIZE ? end : TRANSITION_LOG_SIZE;
+    if(available > max)
+        available = max;
+    size_t count = 0;
+    for(uint64_t index = end - available; index < end; index++) {
+        uint64_t packed = cells[index & (TRANSITION_LOG_SIZE - 1)].load(std::memory_order_acquire);
+        // Cell reserved but not yet written
+        if(packed == 0)
+            continue;
+        Transition &t = transitions[count++];
+        t.time = (long long)((packed >> TIME_SHIFT) & TIME_MASK) - 1;
+        t.cause = (unsigned)(packed >> CAUSE_SHIFT) & 0xFF;
+        t.oldState = (unsigned)(packed >> OLD_STATE_SHIFT) & 0xF;
+        t.newState = (unsigned)packed & 0xF;
+    }
+    return count;
+}
+
+void TransitionLog::unitTest() {
+    TransitionLog log;
+    Transition transitions[TRANSITION_LOG_SIZE];
+    assert(log.snapshot(transitions, TRANSITION_LOG_SIZE) == 0);
+
+    // Fields are kept
+    log.record(1, 4, 200, 123456789000LL);
+    assert(log.snapshot(transitions, TRANSITION_LOG_SIZE) == 1);
+    assert(transitions[0].oldState == 1 && transitions[0].newState == 4);
+    assert(transitions[0].cause == 200 && transitions[0].time == 123456789);
+
+    // Oldest transitions are overwritten, last ones are given oldest first
+    for(unsigned i = 0; i < TRANSITION_LOG_SIZE + 10; i++)
+        log.record(i % 5, (i + 1) % 5, i % 256, i * 1000LL);
+    assert(log.getCount() == TRANSITION_LOG_SIZE + 11);
+    assert(log.snapshot(transitions, TRANSITION_LOG_SIZE) == TRANSITION_LOG_SIZE);
+    assert(transitions[0].time == 10);
+    assert(transitions[TRANSITION_LOG_SIZE - 1].time == TRANSITION_LOG_SIZE + 9);
+    assert(log.snapshot(transitions, 3) == 3);
+    assert(transitions[0].time == TRANSITION_LOG_SIZE + 7);
+
+    DSTATUS("TransitionLog test passed");
+}
@@ -0,0 +1,73 @@
+/*! @file TransitionLog.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Last transitions of the flight controller state machine.
+ *
+ *  Each transition (old state, new state, cause and monotonic time) is
+ *  packed in one 64 bits atomic cell of a fixed-size ring. Recording is
+ *  lock-free, can be done from any thread and overwrites the oldest
+ *  transition. Reading never blocks recording : a transition overwritten
+ *  while the ring is read is displayed in place of the older one.
+ */
+
+#ifndef MATRICE210_TRANSITIONLOG_H
+#define MATRICE210_TRANSITIONLOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define TRANSITION_LOG_SIZE 64  /*!< Number of transitions kept, has to be a power of 2 */
+
+namespace M210 {
+    class TransitionLog {
+        static_assert((TRANSITION_LOG_SIZE & (TRANSITION_LOG_SIZE - 1)) == 0,
+                      "TRANSITION_LOG_SIZE must be a power of 2");
+    public:
+        struct Transition {
+            unsigned oldState;  /*!< State before transition */
+            unsigned newState;  /*!< State after transition */
+            unsigned cause;     /*!< Transition cause, defined by state machine */
+            long long time;     /*!< Monotonic time [us] */
+        };
+    private:
+        std::atomic<uint64_t> cells[TRANSITION_LOG_SIZE];  /*!< Packed transitions, 0 if cell is empty */
+        std::atomic<uint64_t> head;                         /*!< Number of recorded transitions */
+    public:
+        TransitionLog();
+
+        TransitionLog(const TransitionLog &) = delete;
+        TransitionLog &operator=(const TransitionLog &) = delete;
+
+        /**
+         * Record a transition. Never blocks
+         * @param oldState State before transition, 0 to 15
+         * @param newState State after transition, 0 to 15
+         * @param cause Transition cause, 0 to 255
+         * @param timeNs Monotonic time [ns]
+         */
+        void record(unsigned oldState, unsigned newState, unsigned cause, long long timeNs);
+
+        /**
+         * Copy last transitions, oldest first
+         * @param transitions Array receiving transitions
+         * @param max Size of transitions array
+         * @return Number of copied transitions
+         */
+        size_t snapshot(Transition *transitions, size_t max) const;
+
+        /**
+         * @return Number of transitions recorded since start
+         */
+        uint64_t getCount() const { return head.load(std::memory_order_relaxed); }
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_TRANSITIONLOG_H
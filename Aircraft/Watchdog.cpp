@@ -16,12 +16,13 @@ using namespace M210;
 pthread_mutex_t Watchdog::mutex = PTHREAD_MUTEX_INITIALIZER;
 
 Watchdog::Watchdog(unsigned limit): limit(limit){
+    counter = 0;
     errorDisplayed = false;
 }
 
-void Watchdog::increment() {
+void Watchdog::increment(unsigned elapsed) {
     pthread_mutex_lock(&mutex);
-    counter++;
+    counter += elapsed;
     // Upper limit to avoid (improbable) out of range
     if(counter >= limit) {
         counter = limit;
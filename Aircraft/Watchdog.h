@@ -6,7 +6,8 @@
  *  maintained.
  *
  *  Watchdog is regularly reset on specified data received from
- *  mobile SDK and increment on each sending of moving order to aircraft.
+ *  mobile SDK and increment on each sending of moving order to aircraft
+ *  by the control period, so its duration does not depend on control rate.
  */
 
 #ifndef MATRICE210_WATCHDOG_H
@@ -17,22 +18,23 @@
 namespace M210 {
     class Watchdog {
     private:
-        const unsigned limit;   /*!< Numbers of orders that can be sent to aircraft before watchdog is triggered */
-        unsigned counter;       /*!< Numbers of orders sent to aircraft since last reset */
+        const unsigned limit;   /*!< Control time that can elapse before watchdog is triggered [ms] */
+        unsigned counter;       /*!< Control time elapsed since last reset [ms] */
         bool errorDisplayed;    /*!< Used to display error only once */
         static pthread_mutex_t mutex; /*!< Protect watchdog shared attributes */
     public:
         /**
          * Create watchdog
-         * @param limit Numbers of orders that can be sent to aircraft before watchdog is triggered
-         * Relative watchdog duration depends on order sending frequency. See FlightController thread
+         * @param limit Control time that can elapse before watchdog is triggered [ms]
+         * Time is counted by orders sent to the aircraft. See FlightController thread
          */
         explicit Watchdog(unsigned limit);
 
         /**
          * Increment local counter
+         * @param elapsed Control period of the sent order [ms]
          */
-        void increment();
+        void increment(unsigned elapsed);
 
         /**
          * Reset local counter
@@ -7,18 +7,31 @@
 
 #include "Console.h"
 
+#include <cerrno>
 #include <iostream>
+#include <poll.h>
 #include <sstream>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 #include "../Aircraft/FlightController.h"
 #include "../Action/Action.h"
 #include "../Action/ActionData.h"
+#include "../Action/ActionDataPool.h"
+#include "../Action/ActionJournal.h"
+#include "../Action/ActionQueue.h"
+#include "../Action/ActionTracer.h"
+#include "../Action/ControlArbiter.h"
+#include "../Managers/AckWorkerPool.h"
 #include "../Managers/PackageManager.h"
+#include "../Managers/TelemetryCache.h"
 #include "../Managers/ThreadManager.h"
+#include "../util/EventLoop.h"
 #include "../util/Log.h"
 #include "../util/timer.h"
 #include "../util/define.h"
 #include "../Gps/GpsAxis.h"
+#include "../Missions/PositionOffsetMission.h"
 
 using namespace M210;
 
@@ -27,123 +40,315 @@ Console::Console(FlightController* flightController) : flightController(flightCo
 }
 
 void Console::launchThread() {
-    ThreadManager::start("consoleThread",
-                         &consoleThreadID, &consoleThreadAttr,
-                         consoleThread, (void*)this);
+    if(running.load())
+        return;
+    running.store(true);
+    if(!ThreadManager::start("consoleThread",
+                             &consoleThreadID, &consoleThreadAttr,
+                             consoleThread, (void*)this,
+                             ThreadManager::BACKGROUND))
+        running.store(false);
+}
+
+void Console::stopThread() {
+    if(!running.exchange(false))
+        return;
+    ThreadManager::stop(&consoleThreadID, "consoleThread");
 }
 
 void* Console::consoleThread(void* param) {
     DSTATUS("consoleThread running...");
     auto c = static_cast<Console*>(param);
     // Display interactive prompt
-    bool running = true;
-    bool displayMenu = true;
-    while(running) {
-        // Display menu except last action disable it
-        if(displayMenu)
+    c->displayMenu();
+    struct pollfd input{STDIN_FILENO, POLLIN, 0};
+    while(c->running.load()) {
+        if(poll(&input, 1, CONSOLE_POLL_MS) <= 0)
+            continue;
+        int executed = 0;
+        bool open = c->readInput(STDIN_FILENO, executed);
+        if(executed > 0) {
+            // Let command logs be displayed before the menu
+            delay_ms(500);
             c->displayMenu();
-        displayMenu = true;
-        // Get user choice
-        char inputChar;
-        cin >> inputChar;
-        // Get newline char
-        cin.get();
-        ActionData *actionData = nullptr;
-        switch (inputChar) {
-            case '1':
-                actionData = new ActionData(ActionData::takeOff);
-                break;
-            case '2':
-                actionData = new ActionData(ActionData::landing);
-                break;
-            case '3': {
-                // Move by position
-                Telemetry::Vector3f position;
-                position.x = c->getNumber("x: ");
-                position.y = c->getNumber("y: ");
-                position.z = c->getNumber("z: ");
-                float yaw = c->getNumber("yaw: ");
-                actionData = new ActionData(ActionData::ActionId::mission,
-                                            sizeof(Telemetry::Vector3f) // position
-                                            + sizeof(unsigned)          // mission action
-                                            + 2 * sizeof(char));        // mission kind
-                actionData->push(position);
-                actionData->push(yaw);
-                actionData->push((char)Action::MissionAction::START);    // action
-                actionData->push((char)Action::MissionType::POSITION);   // mission kind
-            }
-                break;
-            case '4': {
-                // Move by position offset
-                Telemetry::Vector3f position;
-                position.x = c->getNumber("xOffsetDesired: ");
-                position.y = c->getNumber("yOffsetDesired: ");
-                position.z = c->getNumber("zOffsetDesired: ");
-                float yaw = c->getNumber("yawDesired: ");
-                actionData = new ActionData(ActionData::mission,
-                                            sizeof(Telemetry::Vector3f) // position offset
-                                            + sizeof(unsigned)          // mission action
-                                            + 2 * sizeof(char));        // mission kind
-                actionData->push(position);
-                actionData->push(yaw);
-                actionData->push((char)Action::MissionAction::START);           // action
-                actionData->push((char)Action::MissionType::POSITION_OFFSET);   // mission kind
+        }
+        if(!open)
+            break;
+    }
+    return nullptr;
+}
+
+void* Console::benchmarkThread(void* param) {
+    auto c = static_cast<Console*>(param);
+    ActionQueue::benchmark();
+    ActionData::benchmark();
+    FlightController::idleBenchmark();
+    PositionOffsetMission::benchmark();
+    TelemetryCache::benchmark();
+    FlightController::runtimeBenchmark();
+    DSTATUS("Benchmarks done");
+    c->benchmarking.store(false);
+    return nullptr;
+}
+
+bool Console::attach(EventLoop &loop) {
+    if(!loop.add(STDIN_FILENO, EPOLLIN, stdinHandler, this))
+        return false;
+    this->loop = &loop;
+    DSTATUS("Console attached to event loop, parameters can follow command on the same line");
+    displayMenu();
+    return true;
+}
+
+void Console::stdinHandler(int fd, uint32_t events, void *arg) {
+    (void)events;
+    auto c = static_cast<Console*>(arg);
+    int executed = 0;
+    bool open = c->readInput(fd, executed);
+    if(executed > 0)
+        c->displayMenu();
+    if(!open)
+        c->loop->remove(fd);
+}
+
+bool Console::readInput(int fd, int &executed) {
+    // fd is readable, one read never blocks. Lines are cut here,
+    // cin is never used so that nothing stays buffered out of poll sight
+    char buffer[256];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if(length <= 0) {
+        if(length == 0 || errno != EINTR) {
+            DSTATUS("Console input closed");
+            return false;
+        }
+        return true;
+    }
+    inputLine.append(buffer, (size_t)length);
+    size_t end;
+    while((end = inputLine.find('\n')) != string::npos) {
+        string line = inputLine.substr(0, end);
+        inputLine.erase(0, end + 1);
+        if(processLine(line))
+            executed++;
+    }
+    return true;
+}
+
+const char *const *Console::getPrompts(char command, const char *&hint) {
+    static const char *const position[] = {"x: ", "y: ", "z: ", "yaw: ", nullptr};
+    static const char *const offset[] = {"xOffsetDesired: ", "yOffsetDesired: ", "zOffsetDesired: ",
+                                         "yawDesired: ", nullptr};
+    static const char *const velocity[] = {"Vx: ", "Vy: ", "Vz: ", "yaw: ", nullptr};
+    static const char *const rate[] = {"Mission type: ", "Control rate [Hz]: ", nullptr};
+    static const char *const axis[] = {"Axis angle [deg]: ", nullptr};
+    static const char *const priority[] = {"Source: ", "Priority: ", nullptr};
+    hint = nullptr;
+    switch(command) {
+        case '3':
+            return position;
+        case '4':
+            return offset;
+        case '5':
+            return velocity;
+        case 'f':
+            hint = "Mission type : 1 velocity, 2 position, 3 position offset";
+            return rate;
+        case 'g':
+            return axis;
+        case 'k':
+            hint = "Source : 1 mobile, 2 console, 3 uart, 4 replay";
+            return priority;
+        default:
+            return nullptr;
+    }
+}
+
+bool Console::processLine(const string &line) {
+    stringstream input(line);
+    if(pendingCommand == 0) {
+        // Get user choice, first char of the line
+        char command;
+        if(!(input >> command))
+            return false;
+        if(command == 'm') {
+            cout << "Type command to send : " << endl;
+            pendingCommand = command;
+            return false;
+        }
+        const char *hint;
+        const char *const *prompts = getPrompts(command, hint);
+        if(hint != nullptr)
+            cout << hint << endl;
+        pendingCommand = command;
+        paramCount = 0;
+        if(prompts == nullptr)
+            return execute();
+    } else if(pendingCommand == 'm') {
+        customCommand = line;
+        return execute();
+    }
+
+    // Parameters, several can be given on the same line
+    const char *hint;
+    const char *const *prompts = getPrompts(pendingCommand, hint);
+    string word;
+    while(prompts[paramCount] != nullptr && input >> word) {
+        stringstream number(word);
+        if(!(number >> params[paramCount])) {
+            cout << "Invalid number" << endl;
+            break;
+        }
+        paramCount++;
+    }
+    if(prompts[paramCount] == nullptr)
+        return execute();
+    cout << prompts[paramCount] << flush;
+    return false;
+}
+
+bool Console::execute() {
+    char command = pendingCommand;
+    pendingCommand = 0;
+    ActionData *actionData = nullptr;
+    switch (command) {
+        case '1':
+            actionData = new ActionData(ActionData::takeOff, ActionData::CONSOLE);
+            break;
+        case '2':
+            actionData = new ActionData(ActionData::landing, ActionData::CONSOLE);
+            break;
+        case '3': {
+            // Move by position
+            Telemetry::Vector3f position;
+            position.x = params[0];
+            position.y = params[1];
+            position.z = params[2];
+            float yaw = params[3];
+            actionData = new ActionData(ActionData::ActionId::mission, ActionData::CONSOLE);
+            if(actionData != nullptr) {
+                MovementPayload payload{position, yaw};
+                actionData->encodeMission<Action::POSITION>(Action::MissionAction::START, payload);
             }
-                break;
-            case '5': {
-                // Move by velocity
-                Telemetry::Vector3f velocity;
-                velocity.x = c->getNumber("Vx: ");
-                velocity.y = c->getNumber("Vy: ");
-                velocity.z = c->getNumber("Vz: ");
-                float yaw = c->getNumber("yaw: ");
-                actionData = new ActionData(ActionData::mission,
-                                            sizeof(Telemetry::Vector3f) // velocity
-                                            + sizeof(unsigned)          // mission action
-                                            + 2 * sizeof(char));        // mission kind
-                actionData->push(velocity);
-                actionData->push(yaw);
-                actionData->push((char)Action::MissionAction::START);    // action
-                actionData->push((char)Action::MissionType::VELOCITY);    // mission kind
+        }
+            break;
+        case '4': {
+            // Move by position offset
+            Telemetry::Vector3f position;
+            position.x = params[0];
+            position.y = params[1];
+            position.z = params[2];
+            float yaw = params[3];
+            actionData = new ActionData(ActionData::ActionId::mission, ActionData::CONSOLE);
+            if(actionData != nullptr) {
+                MovementPayload payload{position, yaw};
+                actionData->encodeMission<Action::POSITION_OFFSET>(Action::MissionAction::START, payload);
             }
-                break;
-            case 'e':
-                // Emergency stop is called directly here to avoid delay
-                c->flightController->emergencyStop();
-                break;
-            case 'm': {
-                cout << "Type command to send : " << endl;
-                string command;
-                getline(cin, command);
-                DSTATUS("Send data to mobile : %s", command.c_str());
-                // TODO Add to action queue
-                c->flightController->sendDataToMSDK(reinterpret_cast<const uint8_t *>(command.c_str()), (uint8_t)command.length());
+        }
+            break;
+        case '5': {
+            // Move by velocity
+            Telemetry::Vector3f velocity;
+            velocity.x = params[0];
+            velocity.y = params[1];
+            velocity.z = params[2];
+            float yaw = params[3];
+            actionData = new ActionData(ActionData::ActionId::mission, ActionData::CONSOLE);
+            if(actionData != nullptr) {
+                MovementPayload payload{velocity, yaw};
+                actionData->encodeMission<Action::VELOCITY>(Action::MissionAction::START, payload);
             }
+        }
+            break;
+        case 'b':
+            if(benchmarking.exchange(true)) {
+                DERROR("Benchmarks already running");
                 break;
-            case 'r':
-                actionData = new ActionData(ActionData::emergencyRelease);
-                break;
-            case 's':
-                actionData = new ActionData(ActionData::stopAircraft,
-                                            sizeof(Telemetry::Vector3f) + sizeof(unsigned));
-                break;
-            case 'g': {
-                float angle = c->getNumber("Axis angle [deg]: ");
-                GpsAxis::instance().setRotationAngle(angle / RAD2DEG);
             }
-                break;
-            default:
-                DERROR("Unknown command");
-                break;
+            // Detached, benchmarks cannot be interrupted and end on their own
+            if(ThreadManager::start("benchmarkThread", &benchmarkThreadID, &benchmarkThreadAttr,
+                                    benchmarkThread, (void*)this, ThreadManager::BACKGROUND))
+                pthread_detach(benchmarkThreadID);
+            else
+                benchmarking.store(false);
+            break;
+        case 'c':
+            Action::instance().setCoalescing(!Action::instance().isCoalescing());
+            DSTATUS("Setpoints coalescing %s", Action::instance().isCoalescing() ? "enabled" : "disabled");
+            break;
+        case 'e':
+            // Emergency stop is called directly here to avoid delay,
+            // arbiter records that console has to release it
+            Action::instance().getArbiter().admit(ActionData::CONSOLE, ControlArbiter::EMERGENCY,
+                                                  getMonotonicNs() / 1000000);
+            flightController->emergencyStop();
+            break;
+        case 'f':
+            flightController->setControlRate((unsigned)params[0], (unsigned)params[1]);
+            break;
+        case 'i':
+            flightController->setInterpolation(!flightController->isInterpolating());
+            DSTATUS("Setpoints interpolation %s", flightController->isInterpolating() ? "enabled" : "disabled");
+            break;
+        case 'j':
+            if(ActionJournal::instance().isRecording())
+                ActionJournal::instance().stop();
+            else
+                ActionJournal::instance().start();
+            break;
+        case 'k':
+            Action::instance().getArbiter().setPriority((ActionData::Source)(int)params[0], (unsigned)params[1]);
+            break;
+        case 'l':
+            ActionTracer::instance().print();
+            break;
+        case 'm':
+            DSTATUS("Send data to mobile : %s", customCommand.c_str());
+            // TODO Add to action queue
+            flightController->sendDataToMSDK(reinterpret_cast<const uint8_t *>(customCommand.c_str()), (uint8_t)customCommand.length());
+            break;
+        case 'o':
+            flightController->setMinimumJerk(!flightController->isMinimumJerk());
+            DSTATUS("Position offset minimum-jerk trajectory %s, applied on next mission",
+                    flightController->isMinimumJerk() ? "enabled" : "disabled");
+            break;
+        case 'p':
+            flightController->getControlScheduler().print();
+            break;
+        case 'q':
+            Action::instance().printStats();
+            ActionDataPool::instance().printStats();
+            ActionJournal::instance().printStats();
+            AckWorkerPool::instance().printStats();
+            TelemetryCache::instance().printStats(flightController->getControlScheduler().getCycles());
+            PackageManager::instance().printStats();
+            break;
+        case 'r':
+            actionData = new ActionData(ActionData::emergencyRelease, ActionData::CONSOLE);
+            break;
+        case 's':
+            actionData = new ActionData(ActionData::stopAircraft, ActionData::CONSOLE);
+            break;
+        case 't':
+            ActionTracer::instance().setEnabled(!ActionTracer::instance().isEnabled());
+            DSTATUS("Action latency tracing %s", ActionTracer::instance().isEnabled() ? "enabled" : "disabled");
+            break;
+        case 'x':
+            flightController->printTransitions();
+            break;
+        case 'g':
+            GpsAxis::instance().setRotationAngle(params[0] / RAD2DEG);
+            break;
+        default:
+            DERROR("Unknown command");
+            break;
 
-        }
-        if(actionData != nullptr)
-            Action::instance().add(actionData);
     }
+    if(actionData != nullptr)
+        Action::instance().add(actionData);
+    return true;
 }
 
 void Console::displayMenu() const {
-    delay_ms(500);
     cout << endl;
     cout << "Available commands : ";
     displayMenuLine('1', "Take-off");
@@ -151,10 +356,22 @@ void Console::displayMenu() const {
     displayMenuLine('3', "moveByPosition");
     displayMenuLine('4', "moveByPositionOffset");
     displayMenuLine('5', "moveByVelocity");
+    displayMenuLine('b', "Run benchmarks");
+    displayMenuLine('c', "Enable/disable setpoints coalescing");
     displayMenuLine('e', "Emergency stop");
+    displayMenuLine('f', "Set mission control rate");
+    displayMenuLine('i', "Enable/disable setpoints interpolation");
+    displayMenuLine('j', "Start/stop action journal");
+    displayMenuLine('k', "Set command source priority");
+    displayMenuLine('l', "Display action latency histograms");
     displayMenuLine('m', "Send custom command");
+    displayMenuLine('o', "Enable/disable position offset minimum-jerk trajectory");
+    displayMenuLine('p', "Display control loop period statistics");
+    displayMenuLine('q', "Display action queue and pool statistics");
     displayMenuLine('r', "Release emergency stop");
     displayMenuLine('s', "Stop aircraft");
+    displayMenuLine('t', "Enable/disable action latency tracing");
+    displayMenuLine('x', "Display state machine transitions");
     cout << endl;
 }
 
@@ -171,19 +388,3 @@ void Console::displayMenuLine(char command, const std::string &hint) const{
     }
     cout << "|";
 }
-
-float Console::getNumber(const std::string &hint) const {
-    float number;
-    while (true) {
-        string input;
-        cout << hint;
-        getline(cin, input);
-
-        // This code converts from string to delayMs safely.
-        stringstream myStream(input);
-        if (myStream >> number)
-            break;
-        std::cout << "Invalid number" << std::endl;
-    }
-    return number;
-}
\ No newline at end of file
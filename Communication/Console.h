@@ -4,12 +4,19 @@
  *  @author Jonathan Michel
  *  @brief  This class launches a thread to get char on
  *  console and control flight controller
+ *
+ *  Console input is processed line by line : a command char, then its
+ *  parameters, prompted one by one or given on the same line.
+ *  With the single-threaded runtime, stdin is read by the event loop
+ *  instead of a thread, and a line never waits for the next one.
+ *  The console thread polls stdin so that it can be stopped.
  */
 
 
 #ifndef MATRICE210_CONSOLE_H
 #define MATRICE210_CONSOLE_H
 
+#include <atomic>
 #include <pthread.h>
 #include <string>
 #include <dji_vehicle.hpp>
@@ -17,16 +24,32 @@
 using namespace std;
 using namespace DJI::OSDK;
 
+#define CONSOLE_MAX_PARAMS 4     /*!< Maximal number of numeric parameters of a command */
+#define CONSOLE_POLL_MS 200      /*!< Console thread maximal wait before checking its running flag [ms] */
+
 namespace M210 {
     class FlightController;
+    class EventLoop;
 
     class Console {
     private:
         // Thread attributes
         pthread_t consoleThreadID;              /*!< Console thread id */
         pthread_attr_t consoleThreadAttr;       /*!< Console thread attributes */
+        std::atomic<bool> running{false};       /*!< Console thread state */
         // FlightController
         FlightController *flightController;     /*!< Flight controller used */
+        // Command input
+        char pendingCommand{0};                 /*!< Command waiting for parameters, 0 if none */
+        float params[CONSOLE_MAX_PARAMS]{};     /*!< Numeric parameters of pending command */
+        int paramCount{0};                      /*!< Number of parameters read */
+        string customCommand;                   /*!< Text parameter of custom command */
+        string inputLine;                       /*!< Input not yet ended by a newline */
+        EventLoop *loop{nullptr};               /*!< Event loop reading stdin, if attached */
+        // Benchmarks
+        pthread_t benchmarkThreadID;            /*!< Benchmark thread id */
+        pthread_attr_t benchmarkThreadAttr;     /*!< Benchmark thread attributes */
+        std::atomic<bool> benchmarking{false};  /*!< Benchmarks are running */
     public:
         /**
          * Create console object
@@ -39,6 +62,18 @@ namespace M210 {
          */
         void launchThread();
 
+        /**
+         * Stop console thread and wait for its end, at most THREAD_JOIN_TIMEOUT_MS
+         */
+        void stopThread();
+
+        /**
+         * Read stdin from event loop instead of a thread
+         * @param loop Event loop of the single-threaded runtime
+         * @return false if stdin cannot be watched
+         */
+        bool attach(EventLoop &loop);
+
     private:
         /**
          * Dedicated console thread.
@@ -49,6 +84,53 @@ namespace M210 {
          */
         static void *consoleThread(void *param);
 
+        /**
+         * Run all benchmarks, results are displayed on console. Benchmarks last
+         * several seconds, they never run in the thread reading stdin, which is
+         * the control loop thread with the single-threaded runtime
+         * @param param Console object
+         * @return -
+         */
+        static void *benchmarkThread(void *param);
+
+        /**
+         * Event loop handler, reads available input and processes complete lines
+         * @param fd stdin
+         * @param events Ready events
+         * @param arg Console object
+         */
+        static void stdinHandler(int fd, uint32_t events, void *arg);
+
+        /**
+         * Read available input once and process complete lines. Never blocks
+         * once fd is readable
+         * @param fd stdin
+         * @param executed Number of commands executed
+         * @return false if input is closed
+         */
+        bool readInput(int fd, int &executed);
+
+        /**
+         * Parameter prompts of a command
+         * @param command Command char
+         * @param hint Set to a line displayed before first prompt, nullptr if none
+         * @return nullptr terminated prompts, nullptr if command has no numeric parameter
+         */
+        static const char *const *getPrompts(char command, const char *&hint);
+
+        /**
+         * Process an input line : command char or parameters of pending command
+         * @param line Input line without newline
+         * @return true if a command has been executed
+         */
+        bool processLine(const string &line);
+
+        /**
+         * Execute pending command with its parameters
+         * @return true
+         */
+        bool execute();
+
         /**
          * Display available commands list
          */
@@ -61,13 +143,6 @@ namespace M210 {
          * alignment
          */
         void displayMenuLine(char command, const string &hint) const;
-
-        /**
-         * Read float number from console
-         * @param hint Description displayed to user
-         * @return Read number
-         */
-        float getNumber(const string &hint) const;
     };
 }
 
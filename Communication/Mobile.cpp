@@ -14,6 +14,9 @@
 #include "../Aircraft/Watchdog.h"
 #include "../Action/Action.h"
 #include "../Action/ActionData.h"
+#include "../Action/ActionTracer.h"
+#include "../Action/ControlArbiter.h"
+#include "../util/timer.h"
 
 using namespace std;
 using namespace M210;
@@ -44,37 +47,55 @@ void Mobile::mobileCallback(Vehicle *vehicle, RecvContainer recvFrame,
         if(msgLength >= 2) {
             switch (data[1]) {
                 case 'e':
-                    // Emergency stop is called directly here to avoid delay
+                    // Emergency stop is called directly here to avoid delay,
+                    // arbiter records that mobile has to release it
+                    Action::instance().getArbiter().admit(ActionData::MOBILE, ControlArbiter::EMERGENCY,
+                                                          getMonotonicNs() / 1000000);
                     m->getFlightController()->emergencyStop();
                     break;
                 case 'r':
-                    actionData = new ActionData(ActionData::ActionId::emergencyRelease);
+                    actionData = new ActionData(ActionData::ActionId::emergencyRelease, ActionData::MOBILE);
                     break;
                 case 's':
-                    actionData = new ActionData(ActionData::ActionId::stopAircraft);
+                    actionData = new ActionData(ActionData::ActionId::stopAircraft, ActionData::MOBILE);
                     break;
                 case 't':
-                    actionData = new ActionData(ActionData::ActionId::takeOff);
+                    actionData = new ActionData(ActionData::ActionId::takeOff, ActionData::MOBILE);
                     break;
                 case 'l':
-                    actionData = new ActionData(ActionData::ActionId::landing);
+                    actionData = new ActionData(ActionData::ActionId::landing, ActionData::MOBILE);
                     break;
                 case 'm':   // mission
-                    if(msgLength >= 4) { // 4 command bytes and unknown data length
-                        size_t dataLength =  msgLength - (size_t)2;
-                        actionData = new ActionData(ActionData::ActionId::mission, dataLength);
-                        actionData->push(data+4, dataLength-2); // mission parameters
-                        actionData->push((char)data[3]);        // mission action
-                        actionData->push((char)data[2]);        // mission type
+                    if(msgLength >= 4) { // 4 command bytes and mission parameters, see ActionMessage.h
+                        actionData = new ActionData(ActionData::ActionId::mission, ActionData::MOBILE);
+                        // Parameters length is verified against mission type layout
+                        if(actionData != nullptr &&
+                           !actionData->encodeMission(data[2], data[3], data+4, msgLength - (size_t)4)) {
+                            LERROR("Mission parameters format error");
+                            delete actionData;
+                            actionData = nullptr;
+                        }
                     } else {
                         LERROR("Mission data format error");
                     }
                     break;
                 case 'o':
-                    actionData = new ActionData(ActionData::ActionId::obtainControlAuthority);
+                    actionData = new ActionData(ActionData::ActionId::obtainControlAuthority, ActionData::MOBILE);
                     break;
                 case 'w':
-                    actionData = new ActionData(ActionData::ActionId::watchdog);
+                    actionData = new ActionData(ActionData::ActionId::watchdog, ActionData::MOBILE);
+                    break;
+                case 'h':
+                    // Latency histograms summary, answered from mobile callback
+                    ActionTracer::instance().sendToMobile();
+                    break;
+                case 'p':
+                    // Control loop period statistics, answered from mobile callback
+                    m->getFlightController()->getControlScheduler().sendToMobile();
+                    break;
+                case 'x':
+                    // Last state machine transitions, answered from mobile callback
+                    m->getFlightController()->sendTransitionsToMobile();
                     break;
                 default:
                     LERROR("Unknown command received from MOSDK");
@@ -97,7 +118,7 @@ void Mobile::mobileCallback(Vehicle *vehicle, RecvContainer recvFrame,
         string msg = string(reinterpret_cast<char*>(data));
         string hw = "Hello world from Android";
         if(msg == hw) {
-            actionData = new ActionData(ActionData::ActionId::helloWorld);
+            actionData = new ActionData(ActionData::ActionId::helloWorld, ActionData::MOBILE);
             Action::instance().add(actionData);
         }
 
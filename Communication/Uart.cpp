@@ -8,29 +8,51 @@
 
 #include "Uart.h"
 
+#include <cerrno>
+#include <fcntl.h>
 #include <iostream>
+#include <poll.h>
 #include <string>
 #include <sstream>
+#include <sys/epoll.h>
+#include <unistd.h>
 
+#include "../util/EventLoop.h"
 #include "../util/Log.h"
 #include "../Aircraft/FlightController.h"
 #include "../Managers/ThreadManager.h"
 
 using namespace M210;
 
-Uart::Uart(const char *device, uint32_t baudRate) {
+Uart::Uart(const char *device, uint32_t baudRate) : device(device) {
     serialDevice = new LinuxSerialDevice(device, baudRate);
     serialDevice->init();
 }
 
 Uart::~Uart() {
+    stopRxThread();
+    if(rxFd != -1)
+        close(rxFd);
     delete serialDevice;
 }
 
 bool Uart::launchRxThread() {
-    return ThreadManager::start("uartRxThread",
-                         &uartRxThreadID, &uartRxThreadAttr,
-                         uartRxThread, (void*)this);
+    if(rxRunning.load())
+        return true;
+    rxRunning.store(true);
+    if(!ThreadManager::start("uartRxThread",
+                             &uartRxThreadID, &uartRxThreadAttr,
+                             uartRxThread, (void*)this)) {
+        rxRunning.store(false);
+        return false;
+    }
+    return true;
+}
+
+void Uart::stopRxThread() {
+    if(!rxRunning.exchange(false))
+        return;
+    ThreadManager::stop(&uartRxThreadID, "uartRxThread");
 }
 
 void Uart::send(const uint8_t *buf, size_t len) const {
@@ -44,86 +66,129 @@ size_t Uart::read(uint8_t *buf, size_t len) const{
 void *Uart::uartRxThread(void *param) {
     LSTATUS("uartRxThread running...");
     auto uart = static_cast<Uart*>(param);
-    char rxBuffer[256];
     uint8_t rxChar;
-    uint8_t rxIndex = 0;
 
     // todo Improve protocol
     // It would be better to transmit 32 bits value
     // Needs more frame formatting and CRC
-    // todo Fill buffer continuously and process data with a dedicated method
-    // Need circular buffer implementation
-    bool running = true;
-    while(running) {
-        // New char received
-        if(uart->read(&rxChar, 1) != 0) {
-            // Add data to rx buffer
-            rxBuffer[rxIndex] = rxChar;
-            rxIndex++;
-            // '@' indicate end of transmission
-            if(rxChar == END_OF_FRAME_CHAR) {
-                // Process data
-                long data_i[20];
-                float data_f[20];
-                int countValue = 0;
-                char tabValues[20];
-                int valuesInc = 0;
-                int length = rxIndex;
+    if(!uart->openRx()) {
+        // Blocking read, thread only ends once a char is received
+        while(uart->rxRunning.load()) {
+            // New char received
+            if(uart->read(&rxChar, 1) != 0)
+                uart->receive(rxChar);
+        }
+        return nullptr;
+    }
+    struct pollfd rx{uart->rxFd, POLLIN, 0};
+    while(uart->rxRunning.load()) {
+        if(poll(&rx, 1, UART_RX_POLL_MS) > 0)
+            uart->drainRx();
+    }
+    return nullptr;
+}
+
+bool Uart::attach(EventLoop &loop) {
+    if(!openRx())
+        return false;
+    return loop.add(rxFd, EPOLLIN, rxHandler, this);
+}
+
+bool Uart::openRx() {
+    if(rxFd != -1)
+        return true;
+    // Device settings belong to the tty, they are shared with serialDevice
+    rxFd = open(device, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(rxFd == -1) {
+        int errsv = errno;  // save error code
+        LERROR("Uart %s cannot be opened, error : %i", device, errsv);
+        return false;
+    }
+    return true;
+}
+
+void Uart::rxHandler(int fd, uint32_t events, void *arg) {
+    (void)fd;
+    (void)events;
+    static_cast<Uart*>(arg)->drainRx();
+}
+
+void Uart::drainRx() {
+    uint8_t buffer[64];
+    ssize_t length;
+    // Read until device is empty, never blocks
+    while((length = ::read(rxFd, buffer, sizeof(buffer))) > 0) {
+        for(ssize_t i = 0; i < length; i++)
+            receive(buffer[i]);
+    }
+}
+
+void Uart::receive(uint8_t rxChar) {
+    // Add data to rx buffer
+    rxBuffer[rxIndex] = rxChar;
+    rxIndex++;
+    // '@' indicate end of transmission
+    if(rxChar == END_OF_FRAME_CHAR) {
+        processFrame(rxBuffer, rxIndex);
+        // Reset rx buffer
+        rxIndex = 0;
+    }
+}
+
+void Uart::processFrame(const char *frame, int length) {
+    long data_i[20];
+    float data_f[20];
+    int countValue = 0;
+    char tabValues[20];
+    int valuesInc = 0;
 
 #ifdef DEBUG_UART_FRAME
-                //DSTATUS("Frame received : %u", length);
-                std::cout << std::endl;
+    //DSTATUS("Frame received : %u", length);
+    std::cout << std::endl;
 #endif
-                for(uint16_t i = 0; i < length; i++)
-                {
+    for(uint16_t i = 0; i < length; i++)
+    {
 #ifdef DEBUG_UART_FRAME
-                    std::cout << rxBuffer[i];
+        std::cout << frame[i];
 #endif
-                    // '|' char indicate end of value
-                    if(rxBuffer[i] == NEW_VALUE_CHAR)
-                    {
-                        tabValues[valuesInc] = ' ';
-                        data_f[countValue] = strtof(tabValues, nullptr);
-                        data_i[countValue] = strtol(tabValues, nullptr, 10);
-                        countValue++;
-                        valuesInc = 0;
-                    }
-                    else
-                    {
-                        tabValues[valuesInc] = rxBuffer[i];
-                        valuesInc++;
-                    }
-                }
+        // '|' char indicate end of value
+        if(frame[i] == NEW_VALUE_CHAR)
+        {
+            tabValues[valuesInc] = ' ';
+            data_f[countValue] = strtof(tabValues, nullptr);
+            data_i[countValue] = strtol(tabValues, nullptr, 10);
+            countValue++;
+            valuesInc = 0;
+        }
+        else
+        {
+            tabValues[valuesInc] = frame[i];
+            valuesInc++;
+        }
+    }
 #ifdef DEBUG_UART_FRAME
-                std::cout << std::endl;
+    std::cout << std::endl;
 #endif
-                // Last value
-                tabValues[valuesInc] = ' ';
-                data_f[countValue] = strtof(tabValues, nullptr);
-                data_i[countValue] = strtol(tabValues, nullptr, 10);
-
-                // Process data
-                // First integer indicate which value is transmitted
-                switch(data_i[0]) {
-                    case 0: {           // antenna value received
-                        // Send data to MSDK : #a[4 bytes of float value]
-                        char buffer[6];
-                        buffer[0] = '#';
-                        buffer[1] = 'a';
-                        memcpy(&buffer[2], &data_i[1], 4);
-                        uart->flightController->sendDataToMSDK(reinterpret_cast<uint8_t *>(buffer), 6);
-                        //DSTATUS("Antenna value : %lu", data_i[1]);
-                    }
-                        break;
-                    default:
-                        LERROR("Unknown data received from antenna : %u", data_i[0]);
-                        break;
-                }
-
-                // Reset rx buffer
-                rxIndex = 0;
-            }
+    // Last value
+    tabValues[valuesInc] = ' ';
+    data_f[countValue] = strtof(tabValues, nullptr);
+    data_i[countValue] = strtol(tabValues, nullptr, 10);
+
+    // Process data
+    // First integer indicate which value is transmitted
+    switch(data_i[0]) {
+        case 0: {           // antenna value received
+            // Send data to MSDK : #a[4 bytes of float value]
+            char buffer[6];
+            buffer[0] = '#';
+            buffer[1] = 'a';
+            memcpy(&buffer[2], &data_i[1], 4);
+            flightController->sendDataToMSDK(reinterpret_cast<uint8_t *>(buffer), 6);
+            //DSTATUS("Antenna value : %lu", data_i[1]);
         }
+            break;
+        default:
+            LERROR("Unknown data received from antenna : %u", data_i[0]);
+            break;
     }
-    return nullptr;
-}
\ No newline at end of file
+}
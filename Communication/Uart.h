@@ -11,11 +11,16 @@
  *  Frame example : 1|4|2.4513|123.4@
  *  Currently protocol is only used to receive data from STM32
  *  Raw data can be sent to STM32
+ *
+ *  Incoming data are read from a second, non-blocking descriptor of the
+ *  same device : by the event loop with the single-threaded runtime, or by
+ *  the rx thread, which checks its running flag between two polls.
  */
 
 #ifndef MATRICE210_UART_H
 #define MATRICE210_UART_H
 
+#include <atomic>
 #include <pthread.h>
 
 #include <dji_vehicle.hpp>
@@ -25,20 +30,27 @@
 //#define DEBUG_UART_FRAME
 #define END_OF_FRAME_CHAR '@'
 #define NEW_VALUE_CHAR '|'
+#define UART_RX_POLL_MS 100     /*!< Rx thread maximal wait before checking its running flag [ms] */
 
 using namespace std;
 using namespace DJI::OSDK;
 
 namespace M210 {
     class FlightController;
+    class EventLoop;
 
     class Uart {
     private:
         LinuxSerialDevice *serialDevice;
         const FlightController *flightController;
+        const char *device;                 /*!< Linux serial device port */
+        int rxFd{-1};                       /*!< Non-blocking descriptor read by event loop or rx thread, -1 if not opened */
+        char rxBuffer[256];                 /*!< Current frame */
+        uint8_t rxIndex{0};                 /*!< Current frame length */
         // Thread attributes
         pthread_t uartRxThreadID;           /*!< Uart rx thread id */
         pthread_attr_t uartRxThreadAttr;    /*!< Uart rx thread attributes */
+        std::atomic<bool> rxRunning{false}; /*!< Uart rx thread state */
     public:
         /**
          * Create serial device with DJI LinuxSerialDevice class and
@@ -66,6 +78,19 @@ namespace M210 {
          */
         bool launchRxThread();
 
+        /**
+         * Stop uart rx thread and wait for its end, at most THREAD_JOIN_TIMEOUT_MS
+         */
+        void stopRxThread();
+
+        /**
+         * Read incoming data from event loop instead of rx thread.
+         * Device is opened again, configuration done by LinuxSerialDevice is kept
+         * @param loop Event loop of the single-threaded runtime
+         * @return false if device cannot be opened or watched
+         */
+        bool attach(EventLoop &loop);
+
         /**
          * Configure flight controller to use
          * @param flightController Flight controller pointer
@@ -80,6 +105,38 @@ namespace M210 {
          */
         static void *uartRxThread(void *param);
 
+        /**
+         * Event loop handler, reads available data
+         * @param fd Non-blocking device descriptor
+         * @param events Ready events
+         * @param arg Uart object
+         */
+        static void rxHandler(int fd, uint32_t events, void *arg);
+
+        /**
+         * Open non-blocking rx descriptor, if not already opened
+         * @return false if device cannot be opened
+         */
+        bool openRx();
+
+        /**
+         * Read and process available data until descriptor is empty
+         */
+        void drainRx();
+
+        /**
+         * Add received char to current frame, process frame on end of frame char
+         * @param rxChar Received char
+         */
+        void receive(uint8_t rxChar);
+
+        /**
+         * Process a complete frame
+         * @param frame Frame chars, end of frame char included
+         * @param length Frame length
+         */
+        void processFrame(const char *frame, int length);
+
         /**
          * Read uart incoming data
          * @param buf Buffer pointer
@@ -0,0 +1,283 @@
+/*! @file AckWorkerPool.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief AckWorkerPool.h implementation
+ */
+
+#include "AckWorkerPool.h"
+
+#include <cassert>
+#include <cerrno>
+
+#include "ThreadManager.h"
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+using namespace M210;
+
+AckWorkerPool::AckWorkerPool() {
+    running.store(false);
+    workerCount = 0;
+    submittedCnt.store(0);
+    rejectedCnt.store(0);
+    succeededCnt.store(0);
+    failedCnt.store(0);
+    expiredCnt.store(0);
+    cancelledCnt.store(0);
+    maxWaitTime.store(0);
+    maxRunTime.store(0);
+    if(sem_init(&jobsSem, 0, 0) != 0) {
+        int errsv = errno;  // save error code
+        DERROR("ACK worker pool semaphore creation failed, error : %i", errsv);
+    }
+}
+
+AckWorkerPool::~AckWorkerPool() {
+    stop();
+    sem_destroy(&jobsSem);
+}
+
+bool AckWorkerPool::start(int workers) {
+    if(running.load())
+        return true;
+    if(workers < 1 || workers > ACK_POOL_MAX_WORKERS) {
+        DERROR("ACK worker pool size must be 1 to %d", ACK_POOL_MAX_WORKERS);
+        return false;
+    }
+    running.store(true);
+    for(workerCount = 0; workerCount < workers; workerCount++) {
+        string name = "ackWorker" + to_string(workerCount);
+        if(!ThreadManager::start(name, &threadIds[workerCount], &threadAttrs[workerCount],
+                                 workerThread, (void *) this))
+            break;
+    }
+    if(workerCount == 0) {
+        running.store(false);
+        return false;
+    }
+    return true;
+}
+
+void AckWorkerPool::stop() {
+    if(!running.exchange(false))
+        return;
+    // Wake up all workers, calls being made end with their SDK timeout
+    for(int i = 0; i < workerCount; i++)
+        sem_post(&jobsSem);
+    bool stopped = true;
+    for(int i = 0; i < workerCount; i++)
+        stopped &= ThreadManager::stop(&threadIds[i], "ackWorker" + to_string(i));
+    workerCount = 0;
+    if(!stopped)
+        return;     // Jobs are still used by a worker
+
+    // Calls not started are completed without being made
+    Job *job;
+    while(jobs.pop(job))
+        run(job);
+}
+
+std::shared_ptr<ActionToken> AckWorkerPool::submit(const char *name, Call call, Completion done,
+                                                    void *arg, unsigned long timeoutMs) {
+    if(call == nullptr)
+        return nullptr;
+    long long now = getMonotonicNs();
+    auto job = new Job{name, call, done, arg, now, now + (long long)timeoutMs * 1000000LL,
+                       std::make_shared<ActionToken>()};
+    std::shared_ptr<ActionToken> token = job->token;
+    if(!running.load() || !jobs.push(job)) {
+        rejectedCnt.fetch_add(1, std::memory_order_relaxed);
+        DERROR("ACK call %s rejected", name);
+        delete job;
+        return nullptr;
+    }
+    submittedCnt.fetch_add(1, std::memory_order_relaxed);
+    sem_post(&jobsSem);
+    return token;
+}
+
+void *AckWorkerPool::workerThread(void *param) {
+    auto pool = (AckWorkerPool *) param;
+    Job *job;
+    while(pool->running.load()) {
+        // Wait until a call is added or pool is stopped
+        if(sem_wait(&pool->jobsSem) != 0)
+            continue;   // Interrupted by a signal
+        // A pop fails while an earlier slot is reserved but not published yet,
+        // the job posted meanwhile is taken by draining after next wake up
+        while(pool->jobs.pop(job))
+            pool->run(job);
+    }
+    return nullptr;
+}
+
+void AckWorkerPool::run(Job *job) {
+    ActionToken &token = *job->token;
+    long long start = getMonotonicNs();
+    ActionToken::State state;
+    if(!running.load() || token.isCancelled()) {
+        state = ActionToken::CANCELLED;
+        cancelledCnt.fetch_add(1, std::memory_order_relaxed);
+    } else if(start > job->deadline) {
+        state = ActionToken::CANCELLED;
+        expiredCnt.fetch_add(1, std::memory_order_relaxed);
+        DERROR("ACK call %s dropped, not started after %lld ms", job->name,
+               (start - job->submitTime) / 1000000);
+    } else {
+        long long waitTime = start - job->submitTime;
+        long long max = maxWaitTime.load(std::memory_order_relaxed);
+        while(waitTime > max && !maxWaitTime.compare_exchange_weak(max, waitTime, std::memory_order_relaxed));
+
+        token.setState(ActionToken::RUNNING);
+        bool success = job->call(job->arg);
+        long long runTime = getMonotonicNs() - start;
+        max = maxRunTime.load(std::memory_order_relaxed);
+        while(runTime > max && !maxRunTime.compare_exchange_weak(max, runTime, std::memory_order_relaxed));
+
+        if(success) {
+            state = ActionToken::SUCCEEDED;
+            succeededCnt.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            state = ActionToken::FAILED;
+            failedCnt.fetch_add(1, std::memory_order_relaxed);
+            DERROR("ACK call %s failed", job->name);
+        }
+    }
+    // Callback first, a caller waiting on the token sees its effects
+    if(job->done != nullptr)
+        job->done(state, job->arg);
+    token.setState(state);
+    delete job;
+}
+
+void AckWorkerPool::getStats(Stats &stats) const {
+    stats.submitted = submittedCnt.load(std::memory_order_relaxed);
+    stats.rejected = rejectedCnt.load(std::memory_order_relaxed);
+    stats.succeeded = succeededCnt.load(std::memory_order_relaxed);
+    stats.failed = failedCnt.load(std::memory_order_relaxed);
+    stats.expired = expiredCnt.load(std::memory_order_relaxed);
+    stats.cancelled = cancelledCnt.load(std::memory_order_relaxed);
+    stats.maxWaitTime = maxWaitTime.load(std::memory_order_relaxed);
+    stats.maxRunTime = maxRunTime.load(std::memory_order_relaxed);
+}
+
+void AckWorkerPool::printStats() const {
+    Stats stats{};
+    getStats(stats);
+    DSTATUS("ACK worker pool : %lu submitted, %lu rejected, %lu succeeded, %lu failed, "
+            "%lu expired, %lu cancelled, max wait %lld ms, max run time %lld ms",
+            stats.submitted, stats.rejected, stats.succeeded, stats.failed,
+            stats.expired, stats.cancelled, stats.maxWaitTime / 1000000, stats.maxRunTime / 1000000);
+}
+
+namespace {
+    struct TestCall {
+        int delayMs;                                /*!< Emulated ACK wait */
+        bool result;                                /*!< Returned by call */
+        std::atomic<int> calls{0};                  /*!< Number of times call was made */
+        std::atomic<int> state{-1};                 /*!< State given to completion */
+        std::atomic<int> *inside{nullptr};          /*!< Latch counting calls in progress, nullptr if none */
+        bool concurrent{false};                     /*!< Other call was in progress at the same time */
+    };
+
+    bool testCall(void *arg) {
+        auto test = static_cast<TestCall *>(arg);
+        test->calls.fetch_add(1);
+        if(test->inside != nullptr) {
+            // Wait for the other worker, given up after a long time so a failure does not hang
+            test->inside->fetch_add(1);
+            for(int i = 0; i < 5000 && test->inside->load() < 2; i++)
+                delay_ms(1);
+            test->concurrent = test->inside->load() >= 2;
+        }
+        delay_ms(test->delayMs);
+        return test->result;
+    }
+
+    void testDone(ActionToken::State state, void *arg) {
+        static_cast<TestCall *>(arg)->state.store(state);
+    }
+}
+
+void AckWorkerPool::unitTest() {
+    AckWorkerPool pool;
+    Stats stats{};
+    TestCall fast, failing, slow[2], late, cancelled;
+    fast.delayMs = 0;
+    fast.result = true;
+    failing.delayMs = 0;
+    failing.result = false;
+    late.delayMs = 0;
+    late.result = true;
+    cancelled.delayMs = 0;
+    cancelled.result = true;
+
+    // Stopped pool rejects calls
+    assert(pool.submit("test", testCall, testDone, &fast) == nullptr);
+    assert(pool.start(1));
+
+    // Completion is called before token is done
+    std::shared_ptr<ActionToken> token = pool.submit("test", testCall, testDone, &fast);
+    assert(token != nullptr);
+    assert(token->wait(1000));
+    assert(token->getState() == ActionToken::SUCCEEDED);
+    assert(fast.state.load() == ActionToken::SUCCEEDED);
+    token = pool.submit("test", testCall, testDone, &failing);
+    assert(token->wait(1000));
+    assert(failing.state.load() == ActionToken::FAILED);
+
+    // submit() returns at once while the worker waits, calls behind
+    // an expired deadline or cancelled are not made
+    for(TestCall &call : slow) {
+        call.delayMs = 100;
+        call.result = true;
+    }
+    std::shared_ptr<ActionToken> slowToken = pool.submit("test", testCall, testDone, &slow[0]);
+    std::shared_ptr<ActionToken> lateToken = pool.submit("test", testCall, testDone, &late, 10);
+    token = pool.submit("test", testCall, testDone, &cancelled);
+    token->cancel();
+    assert(lateToken->wait(1000));
+    assert(token->wait(1000));
+    assert(slowToken->getState() == ActionToken::SUCCEEDED);
+    assert(late.state.load() == ActionToken::CANCELLED && late.calls.load() == 0);
+    assert(cancelled.state.load() == ActionToken::CANCELLED && cancelled.calls.load() == 0);
+    pool.stop();
+
+    // Two workers make two calls at the same time
+    assert(pool.start(2));
+    std::atomic<int> inside{0};
+    std::shared_ptr<ActionToken> tokens[2];
+    for(int i = 0; i < 2; i++) {
+        slow[i].inside = &inside;
+        tokens[i] = pool.submit("test", testCall, testDone, &slow[i]);
+    }
+    assert(tokens[0]->wait(10000) && tokens[1]->wait(10000));
+    assert(slow[0].concurrent && slow[1].concurrent);
+
+    // Call waiting when pool is stopped is completed without being made
+    slow[0].inside = nullptr;
+    slow[0].calls.store(0);
+    slow[0].state.store(-1);
+    cancelled.state.store(-1);
+    pool.submit("test", testCall, testDone, &slow[0]);
+    pool.submit("test", testCall, testDone, &slow[0]);
+    token = pool.submit("test", testCall, testDone, &cancelled);
+    // Both workers are busy, third call is still queued
+    while(slow[0].calls.load() != 2)
+        delay_ms(1);
+    pool.stop();
+    assert(token->getState() == ActionToken::CANCELLED);
+    assert(cancelled.state.load() == ActionToken::CANCELLED);
+    assert(cancelled.calls.load() == 0);
+    assert(slow[0].calls.load() == 2);
+
+    pool.getStats(stats);
+    assert(stats.rejected == 1);
+    assert(stats.failed == 1);
+    assert(stats.expired == 1);
+    assert(stats.cancelled == 2);
+    assert(stats.submitted == stats.succeeded + stats.failed + stats.expired + stats.cancelled);
+
+    DSTATUS("AckWorkerPool test passed");
+}
@@ -0,0 +1,161 @@
+/*! @file AckWorkerPool.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Runs DJI SDK calls waiting for an ACK on worker threads.
+ *
+ *  Package subscription and removal, broadcast frequency or waypoints
+ *  mission orders wait for an ACK, up to their 1 s SDK timeout. The
+ *  control loop and the action dispatch submit them here instead of
+ *  calling them : submit() never blocks and returns an ActionToken used
+ *  as future. The completion callback is called on the worker thread once
+ *  the call is done, it must not block either, it usually records the
+ *  result for the next control loop tick.
+ *
+ *  Calls are started in submission order. A call not started before its
+ *  deadline is dropped, as well as a call cancelled through its token or
+ *  still waiting when the pool is stopped : it is completed as CANCELLED
+ *  without being made. A started call cannot be interrupted, it ends with
+ *  its SDK timeout.
+ *
+ *  With a single worker, calls are also made in submission order, so an
+ *  unsubscription never overtakes the subscription of the same package.
+ */
+
+#ifndef MATRICE210_ACKWORKERPOOL_H
+#define MATRICE210_ACKWORKERPOOL_H
+
+#include <atomic>
+#include <memory>
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <dji_vehicle.hpp>
+
+#include "../Action/ActionExecutor.h"
+#include "../util/RingBuffer.h"
+
+#define ACK_POOL_MAX_WORKERS 4              /*!< Maximal number of worker threads */
+#define ACK_POOL_QUEUE_SIZE 16              /*!< Maximal number of waiting calls, has to be a power of 2 */
+#define ACK_POOL_DEFAULT_TIMEOUT_MS 3000    /*!< Default time given to a call to start [ms] */
+
+using namespace DJI::OSDK;
+
+namespace M210 {
+    class AckWorkerPool : public Singleton<AckWorkerPool> {
+    public:
+        /**
+         * Blocking call, declared as follow :
+         * bool call(void *arg)
+         * Returns true if call succeeded
+         */
+        typedef bool (*Call)(void *arg);
+        /**
+         * Completion callback, declared as follow :
+         * void done(ActionToken::State state, void *arg)
+         * State is SUCCEEDED or FAILED if call was made, CANCELLED otherwise.
+         * Called exactly once for each accepted call, must not block
+         */
+        typedef void (*Completion)(ActionToken::State state, void *arg);
+        struct Stats {      /*!< Pool counters, snapshot returned by getStats() */
+            unsigned long submitted;    /*!< Number of calls accepted */
+            unsigned long rejected;     /*!< Number of calls rejected because queue was full or pool stopped */
+            unsigned long succeeded;    /*!< Number of calls succeeded */
+            unsigned long failed;       /*!< Number of calls failed */
+            unsigned long expired;      /*!< Number of calls dropped because their deadline passed */
+            unsigned long cancelled;    /*!< Number of calls cancelled before start, expired ones excluded */
+            long long maxWaitTime;      /*!< Maximal time between submission and start [ns] */
+            long long maxRunTime;       /*!< Maximal call duration [ns] */
+        };
+    private:
+        struct Job {
+            const char *name;                       /*!< Call name, displayed on failure */
+            Call call;
+            Completion done;                        /*!< Can be nullptr */
+            void *arg;                              /*!< Passed to call and done */
+            long long submitTime;                   /*!< Monotonic submission time [ns] */
+            long long deadline;                     /*!< Monotonic time call has to be started before [ns] */
+            std::shared_ptr<ActionToken> token;
+        };
+        RingBuffer<Job*, ACK_POOL_QUEUE_SIZE> jobs;     /*!< Waiting calls */
+        sem_t jobsSem;                                  /*!< Counts waiting calls, workers sleep on it */
+        std::atomic<bool> running;                      /*!< Workers state */
+        int workerCount;                                /*!< Number of started workers */
+        pthread_t threadIds[ACK_POOL_MAX_WORKERS];      /*!< Worker thread ids */
+        pthread_attr_t threadAttrs[ACK_POOL_MAX_WORKERS]; /*!< Worker thread attributes */
+        // Counters
+        std::atomic<unsigned long> submittedCnt;
+        std::atomic<unsigned long> rejectedCnt;
+        std::atomic<unsigned long> succeededCnt;
+        std::atomic<unsigned long> failedCnt;
+        std::atomic<unsigned long> expiredCnt;
+        std::atomic<unsigned long> cancelledCnt;
+        std::atomic<long long> maxWaitTime;
+        std::atomic<long long> maxRunTime;
+
+        static void *workerThread(void *param);         /*!< Worker thread, makes calls one by one */
+
+        /**
+         * Make call, or only complete it if it is cancelled or expired
+         * @param job Job to run, deleted once completed
+         */
+        void run(Job *job);
+    public:
+        AckWorkerPool();
+
+        /**
+         * Stop workers
+         */
+        ~AckWorkerPool();
+
+        AckWorkerPool(const AckWorkerPool &) = delete;
+        AckWorkerPool &operator=(const AckWorkerPool &) = delete;
+
+        /**
+         * Launch worker threads. Does nothing if already running
+         * @param workers Number of workers, 1 to ACK_POOL_MAX_WORKERS
+         * @return true if pool is running
+         */
+        bool start(int workers = 1);
+
+        /**
+         * Wait end of the calls being made, at most THREAD_JOIN_TIMEOUT_MS
+         * each, then complete waiting calls as CANCELLED
+         */
+        void stop();
+
+        bool isRunning() const { return running.load(); }
+
+        /**
+         * Add a call. Never blocks
+         * @param name Call name, displayed on failure. Has to be a literal
+         * @param call Blocking call
+         * @param done Completion callback, can be nullptr
+         * @param arg Passed to call and done
+         * @param timeoutMs Time given to call to start [ms]
+         * @return Call token, nullptr if call was rejected. done is then not called
+         */
+        std::shared_ptr<ActionToken> submit(const char *name, Call call, Completion done, void *arg,
+                                            unsigned long timeoutMs = ACK_POOL_DEFAULT_TIMEOUT_MS);
+
+        /**
+         * Get pool counters
+         * @param stats Counters snapshot
+         */
+        void getStats(Stats &stats) const;
+
+        /**
+         * Display counters on console
+         */
+        void printStats() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_ACKWORKERPOOL_H
@@ -7,30 +7,63 @@
 
 #include "PackageManager.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "AckWorkerPool.h"
+#include "TelemetryCache.h"
+#include "ThreadManager.h"
 #include "../util/Log.h"
 
 using namespace M210;
 
 pthread_mutex_t PackageManager::packageManager_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t PackageManager::apply_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 PackageManager::PackageManager() {
-    for (bool &i : packageAvailable) {
-        i = true;
+    for (Subscription &subscription : subscriptions) {
+        subscription.state = FREE;
+        subscription.releasing = false;
+        subscription.cancelled = false;
+        subscription.starting = false;
+    }
+    for (int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        topicStates[i] = TopicState{0, 0, false, -1};
+        topicSize[i] = TopicDataBase[i].size;
+        topicMaxFreq[i] = TopicDataBase[i].maxFreq;
+    }
+    for (PackageState &package : packages) {
+        package = PackageState{0, false, false, false};
     }
 }
 
 void PackageManager::setVehicle(const Vehicle *vehicle) {
     this->vehicle = vehicle;
+    invalidateVerify();
+}
+
+void PackageManager::invalidateVerify() {
+    verified.store(false);
 }
 
-bool PackageManager::verify() const {
+bool PackageManager::verify() {
+    // Version does not change while link is up
+    if(verified.load())
+        return true;
     ACK::ErrorCode ack;
+    verifyCnt.fetch_add(1);
     ack = vehicle->subscribe->verify(timeout);
     if (ACK::getError(ack) != ACK::SUCCESS)  {
         DERROR("Version match failed !");
         ACK::getErrorCodeMessage(ack, __func__);
         return false;
     }
+    verified.store(true);
     return true;
 }
 
@@ -41,51 +74,477 @@ int PackageManager::subscribe(TopicName *topics, int numTopic, uint16_t frequenc
     if(!verify())
         return VERIFY_FAILED;
 
-    // Try to allocate package
-    int pkgIndex = allocatePackage();
-    if(pkgIndex == PACKAGE_UNAVAILABLE) {
-        DERROR("Cannot start package. All packages are used");
-        return PACKAGE_UNAVAILABLE;
-    }
+    pthread_mutex_lock(&apply_mutex);
+    pthread_mutex_lock(&packageManager_mutex);
+    int handle = addSubscription(topics, numTopic, frequency, enableTimestamp);
+    pthread_mutex_unlock(&packageManager_mutex);
+    pthread_mutex_unlock(&apply_mutex);
+    return handle;
+}
 
-    // Initialize current package
-    bool pkgStatus = vehicle->subscribe->initPackageFromTopicList(
-            pkgIndex, numTopic, topics,
-            enableTimestamp, frequency);
-    if (pkgStatus) {
-        // Subscribe to current package
-        ACK::ErrorCode ack = vehicle->subscribe->startPackage(pkgIndex, timeout);
-        if (ACK::getError(ack) != ACK::SUCCESS)
-        {
-            DERROR("Error starting package %u (%u Hz)", pkgIndex, frequency);
-            ACK::getErrorCodeMessage(ack, __func__);
-            unsubscribe(pkgIndex);
-            return START_PACKAGE_FAILED;
-        }
-    } else {
-        DERROR("Error initializing package %u (%u Hz)", pkgIndex, frequency);
-        releasePackage(pkgIndex);
-        return INIT_PACKAGE_FAILED;
+int PackageManager::subscribeAsync(const TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp,
+                                   std::shared_ptr<ActionToken> &ready) {
+    ready = nullptr;
+    if(!isVehicleInstanced())
+        return VEHICLE_NOT_INSTANCED;
+
+    pthread_mutex_lock(&packageManager_mutex);
+    int handle = reserveSubscription(topics, numTopic, frequency, enableTimestamp);
+    pthread_mutex_unlock(&packageManager_mutex);
+    if(handle < 0)
+        return handle;
+    // Handle is passed as argument value, nothing to allocate
+    ready = AckWorkerPool::instance().submit("subscribe", subscribeCall, subscribeDone,
+                                             (void *)(intptr_t)handle);
+    if(ready == nullptr) {
+        subscribeDone(ActionToken::CANCELLED, (void *)(intptr_t)handle);
+        return SUBSCRIPTION_UNAVAILABLE;
     }
-    return pkgIndex;
+    return handle;
+}
+
+bool PackageManager::subscribeCall(void *arg) {
+    PackageManager &manager = instance();
+    int handle = (int)(intptr_t)arg;
+    bool matched = manager.verify();
+    pthread_mutex_lock(&apply_mutex);
+    pthread_mutex_lock(&packageManager_mutex);
+    Subscription &subscription = manager.subscriptions[handle];
+    if(!matched)
+        subscription.cancelled = true;     // Freed without being activated
+    int ret = manager.activateSubscription(handle);
+    pthread_mutex_unlock(&packageManager_mutex);
+    pthread_mutex_unlock(&apply_mutex);
+    return ret >= 0;
 }
 
-int PackageManager::unsubscribe(int index) {
+void PackageManager::subscribeDone(ActionToken::State state, void *arg) {
+    if(state != ActionToken::CANCELLED)
+        return;
+    // Activation was not made, reserved subscription is freed
+    int handle = (int)(intptr_t)arg;
+    pthread_mutex_lock(&packageManager_mutex);
+    Subscription &subscription = instance().subscriptions[handle];
+    if(subscription.state == PENDING)
+        subscription.state = FREE;
+    pthread_mutex_unlock(&packageManager_mutex);
+}
+
+bool PackageManager::isReady(int handle) {
+    if(!validHandle(handle))
+        return false;
+    pthread_mutex_lock(&packageManager_mutex);
+    bool ready = subscriptions[handle].state == ACTIVE && !subscriptions[handle].starting;
+    pthread_mutex_unlock(&packageManager_mutex);
+    return ready;
+}
+
+int PackageManager::unsubscribe(int handle) {
     if(!isVehicleInstanced())
         return VEHICLE_NOT_INSTANCED;
 
-    if(!validIndex(index))
+    pthread_mutex_lock(&apply_mutex);
+    pthread_mutex_lock(&packageManager_mutex);
+    int ret = removeSubscription(handle);
+    pthread_mutex_unlock(&packageManager_mutex);
+    pthread_mutex_unlock(&apply_mutex);
+    return ret;
+}
+
+int PackageManager::addSubscription(const TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp) {
+    int handle = reserveSubscription(topics, numTopic, frequency, enableTimestamp);
+    if(handle < 0)
+        return handle;
+    return activateSubscription(handle);
+}
+
+int PackageManager::reserveSubscription(const TopicName *topics, int numTopic, uint16_t frequency,
+                                        bool enableTimestamp) {
+    if(numTopic <= 0 || numTopic > PACKAGE_MAX_TOPICS || frequency == 0) {
+        DERROR("Invalid subscription : %d topics at %u Hz, must be 1 to %d topics",
+               numTopic, frequency, PACKAGE_MAX_TOPICS);
+        return INVALID_TOPICS;
+    }
+    for(int i = 0; i < numTopic; i++) {
+        int topic = topics[i];
+        if(topic < 0 || topic >= TOTAL_TOPIC_NUMBER ||
+           topicSize[topic] + (enableTimestamp ? PACKAGE_TIMESTAMP_SIZE : 0) > PACKAGE_MAX_SIZE) {
+            DERROR("Invalid topic : [%d]", topic);
+            return INVALID_TOPICS;
+        }
+    }
+
+    // Try to allocate subscription
+    int handle = SUBSCRIPTION_UNAVAILABLE;
+    for(int i = 0; i < PACKAGE_MAX_SUBSCRIPTIONS; i++) {
+        if(subscriptions[i].state == FREE) {
+            handle = i;
+            break;
+        }
+    }
+    if(handle == SUBSCRIPTION_UNAVAILABLE) {
+        DERROR("Cannot subscribe. All subscriptions are used");
+        return SUBSCRIPTION_UNAVAILABLE;
+    }
+    Subscription &subscription = subscriptions[handle];
+    subscription.state = PENDING;
+    subscription.releasing = false;
+    subscription.cancelled = false;
+    subscription.starting = false;
+    subscription.frequency = frequency;
+    subscription.timestamp = enableTimestamp;
+    subscription.numTopic = numTopic;
+    for(int i = 0; i < numTopic; i++)
+        subscription.topics[i] = topics[i];
+    return handle;
+}
+
+int PackageManager::activateSubscription(int handle) {
+    Subscription &subscription = subscriptions[handle];
+    if(subscription.state != PENDING)
+        return INVALID_INDEX;
+    if(subscription.cancelled) {
+        subscription.state = FREE;
+        return SUBSCRIPTION_CANCELLED;
+    }
+    subscription.state = ACTIVE;
+    updateNeeds();
+
+    if(!plan()) {
+        subscription.state = FREE;
+        updateNeeds();
+        DERROR("Cannot start package. Topics do not fit in packages");
+        return PACKAGE_UNAVAILABLE;
+    }
+    // Not ready while ACKs are waited for without lock
+    subscription.starting = true;
+    int ret = applyPlan();
+    subscription.starting = false;
+    if(ret < 0) {
+        subscription.state = FREE;
+        updateNeeds();
+        // Topics of a failed package are placed again for other subscriptions
+        if(plan())
+            applyPlan();
+        return ret;
+    }
+    return handle;
+}
+
+int PackageManager::removeSubscription(int handle) {
+    if(!validHandle(handle))
         return INVALID_INDEX;
+    Subscription &subscription = subscriptions[handle];
+    if(subscription.state == FREE || subscription.cancelled) {
+        DERROR("Subscription %d is not used", handle);
+        return INVALID_INDEX;
+    }
+    subscription.releasing = false;
+    if(subscription.state == PENDING) {
+        // No topic sent yet, activation frees it
+        subscription.cancelled = true;
+        return 0;
+    }
+    subscription.state = FREE;
+    updateNeeds();
+
+    // Packages still sending a used topic are left as they are
+    for(int i = 0; i < packageCount; i++) {
+        if(packages[i].frequency == 0)
+            continue;
+        bool used = false;
+        for(const TopicState &topic : topicStates)
+            used |= topic.package == i && topic.refs > 0;
+        if(!used)
+            packages[i].dirty = true;
+    }
+    int ret = applyPlan();
+    // Topics of a failed package are placed again for other subscriptions
+    if(ret < 0 && plan())
+        applyPlan();
+    return ret;
+}
+
+void PackageManager::updateNeeds() {
+    for(TopicState &topic : topicStates) {
+        topic.refs = 0;
+        topic.frequency = 0;
+        topic.timestamp = false;
+    }
+    for(const Subscription &subscription : subscriptions) {
+        if(subscription.state != ACTIVE)
+            continue;
+        for(int i = 0; i < subscription.numTopic; i++) {
+            int index = subscription.topics[i];
+            TopicState &topic = topicStates[index];
+            uint16_t frequency = std::min(subscription.frequency, topicMaxFreq[index]);
+            topic.refs++;
+            topic.frequency = std::max(topic.frequency, frequency);
+            topic.timestamp |= subscription.timestamp;
+        }
+    }
+}
+
+size_t PackageManager::packageSize(int index) const {
+    size_t size = packages[index].timestamp ? PACKAGE_TIMESTAMP_SIZE : 0;
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        if(topicStates[i].package == index && topicStates[i].refs > 0)
+            size += topicSize[i];
+    }
+    return size;
+}
+
+bool PackageManager::canHold(int index, int topic) const {
+    const PackageState &package = packages[index];
+    const TopicState &state = topicStates[topic];
+    if(package.frequency < state.frequency || package.frequency > topicMaxFreq[topic])
+        return false;
+    size_t size = packageSize(index) + topicSize[topic];
+    if(state.timestamp && !package.timestamp)
+        size += PACKAGE_TIMESTAMP_SIZE;
+    return size <= PACKAGE_MAX_SIZE;
+}
+
+void PackageManager::place(int index, int topic) {
+    PackageState &package = packages[index];
+    TopicState &state = topicStates[topic];
+    if(package.frequency == 0) {
+        package.frequency = state.frequency;
+        package.timestamp = false;
+    }
+    package.timestamp |= state.timestamp;
+    package.dirty = true;
+    state.package = index;
+}
+
+void PackageManager::sortTopics(int *topics, int count) const {
+    // Insertion sort, there are only a few topics
+    for(int i = 1; i < count; i++) {
+        int topic = topics[i];
+        int j = i;
+        for(; j > 0; j--) {
+            const TopicState &previous = topicStates[topics[j - 1]];
+            const TopicState &current = topicStates[topic];
+            if(previous.frequency > current.frequency ||
+               (previous.frequency == current.frequency && topicSize[topics[j - 1]] >= topicSize[topic]))
+                break;
+            topics[j] = topics[j - 1];
+        }
+        topics[j] = topic;
+    }
+}
+
+bool PackageManager::plan() {
+    TopicState savedTopics[TOTAL_TOPIC_NUMBER];
+    PackageState savedPackages[DataSubscription::MAX_NUMBER_OF_PACKAGE];
+    memcpy(savedTopics, topicStates, sizeof(topicStates));
+    memcpy(savedPackages, packages, sizeof(packages));
+
+    // Topics already sent fast enough are shared, others are placed
+    int toPlace[TOTAL_TOPIC_NUMBER];
+    int count = 0;
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        TopicState &topic = topicStates[i];
+        if(topic.refs == 0)
+            continue;
+        int index = topic.package;
+        if(index >= 0 && packages[index].frequency >= topic.frequency &&
+           (packages[index].timestamp || !topic.timestamp))
+            continue;
+        if(index >= 0) {
+            // Package is too slow, topic leaves it
+            topic.package = -1;
+            packages[index].dirty = true;
+        }
+        toPlace[count++] = i;
+    }
+    sortTopics(toPlace, count);
+
+    for(int i = 0; i < count; i++) {
+        int topic = toPlace[i];
+        int index = -1;
+        // Package started again anyway first, then package with room, then free package
+        for(int j = 0; j < packageCount && index < 0; j++) {
+            if(packages[j].frequency != 0 && packages[j].dirty && canHold(j, topic))
+                index = j;
+        }
+        for(int j = 0; j < packageCount && index < 0; j++) {
+            if(packages[j].frequency != 0 && canHold(j, topic))
+                index = j;
+        }
+        for(int j = 0; j < packageCount && index < 0; j++) {
+            if(packages[j].frequency == 0)
+                index = j;
+        }
+        if(index < 0) {
+            memcpy(topicStates, savedTopics, sizeof(topicStates));
+            memcpy(packages, savedPackages, sizeof(packages));
+            if(repack())
+                return true;
+            memcpy(topicStates, savedTopics, sizeof(topicStates));
+            memcpy(packages, savedPackages, sizeof(packages));
+            return false;
+        }
+        place(index, topic);
+    }
+    return true;
+}
+
+bool PackageManager::repack() {
+    int previous[TOTAL_TOPIC_NUMBER];
+    PackageState before[DataSubscription::MAX_NUMBER_OF_PACKAGE];
+    memcpy(before, packages, sizeof(packages));
+
+    int topics[TOTAL_TOPIC_NUMBER];
+    int count = 0;
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        previous[i] = topicStates[i].package;
+        topicStates[i].package = -1;
+        if(topicStates[i].refs > 0)
+            topics[count++] = i;
+    }
+    for(int i = 0; i < packageCount; i++) {
+        packages[i].frequency = 0;
+        packages[i].timestamp = false;
+    }
+    sortTopics(topics, count);
+
+    // First fit decreasing
+    for(int i = 0; i < count; i++) {
+        int index = -1;
+        for(int j = 0; j < packageCount && index < 0; j++) {
+            if(packages[j].frequency != 0 && canHold(j, topics[i]))
+                index = j;
+        }
+        for(int j = 0; j < packageCount && index < 0; j++) {
+            if(packages[j].frequency == 0)
+                index = j;
+        }
+        if(index < 0)
+            return false;
+        place(index, topics[i]);
+    }
 
-    // Remove package from aircraft
-    ACK::ErrorCode ack = vehicle->subscribe->removePackage(index, timeout);
-    // Release package in local
-    releasePackage(index);
-    if (ACK::getError(ack)) {
-        DERROR("Error unsubscribing package %u", index);
-        return UNSUBSCRIPTION_FAILED;
+    // Only packages whose content changed are started again
+    for(int i = 0; i < packageCount; i++) {
+        packages[i].dirty = before[i].dirty || packages[i].frequency != before[i].frequency ||
+                            packages[i].timestamp != before[i].timestamp;
+    }
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        if(topicStates[i].refs == 0) {
+            // Unused topic is still sent until its package is started again
+            topicStates[i].package = previous[i];
+        } else if(topicStates[i].package != previous[i]) {
+            packages[topicStates[i].package].dirty = true;
+            if(previous[i] >= 0)
+                packages[previous[i]].dirty = true;
+        }
     }
+    return true;
+}
+
+int PackageManager::applyPlan() {
+    PackageCommand commands[DataSubscription::MAX_NUMBER_OF_PACKAGE];
+    int count = 0;
+    for(int i = 0; i < packageCount; i++) {
+        PackageState &package = packages[i];
+        if(!package.dirty)
+            continue;
+        package.dirty = false;
 
+        // Removed from aircraft, then started again with its used topics
+        PackageCommand &command = commands[count++];
+        command.index = i;
+        command.remove = package.started;
+        package.started = false;
+        command.numTopic = 0;
+        for(int j = 0; j < TOTAL_TOPIC_NUMBER; j++) {
+            if(topicStates[j].package != i)
+                continue;
+            if(topicStates[j].refs > 0)
+                command.topics[command.numTopic++] = (TopicName) j;
+            else
+                topicStates[j].package = -1;
+        }
+        if(command.numTopic == 0) {
+            package.frequency = 0;
+            package.timestamp = false;
+        }
+        command.timestamp = package.timestamp;
+        command.frequency = package.frequency;
+    }
+
+    // ACKs are waited for without lock, apply_mutex keeps plan unchanged meanwhile
+    int results[DataSubscription::MAX_NUMBER_OF_PACKAGE] = {};
+    if(count > 0 && (vehicle != nullptr || sendHook != nullptr)) {
+        pthread_mutex_unlock(&packageManager_mutex);
+        for(int i = 0; i < count; i++)
+            results[i] = sendHook != nullptr ? sendHook(commands[i]) : send(commands[i]);
+        pthread_mutex_lock(&packageManager_mutex);
+    }
+
+    int ret = 0;
+    for(int i = 0; i < count; i++) {
+        const PackageCommand &command = commands[i];
+        PackageState &package = packages[command.index];
+        if(results[i] < 0) {
+            ret = results[i];
+            if(command.numTopic == 0) {
+                // Still sent by aircraft, removal is tried again by next plan
+                package.started = true;
+                package.dirty = true;
+                continue;
+            }
+            // Topics are no longer sent
+            for(TopicState &topic : topicStates) {
+                if(topic.package == command.index)
+                    topic.package = -1;
+            }
+            package.frequency = 0;
+            package.timestamp = false;
+            continue;
+        }
+        if(command.numTopic == 0)
+            continue;
+        package.started = true;
+        packageStarts++;
+    }
+    return ret;
+}
+
+int PackageManager::send(PackageCommand &command) {
+    int i = command.index;
+    bool removed = true;
+    if(command.remove) {
+        ACK::ErrorCode ack = vehicle->subscribe->removePackage(i, timeout);
+        TelemetryCache::instance().unwatch(i);
+        if (ACK::getError(ack)) {
+            DERROR("Error unsubscribing package %u", i);
+            removed = false;
+        }
+    }
+    if(command.numTopic == 0)
+        return removed ? 0 : UNSUBSCRIPTION_FAILED;
+
+    bool pkgStatus = vehicle->subscribe->initPackageFromTopicList(
+            i, command.numTopic, command.topics,
+            command.timestamp, command.frequency);
+    if (!pkgStatus) {
+        DERROR("Error initializing package %u (%u Hz)", i, command.frequency);
+        return INIT_PACKAGE_FAILED;
+    }
+    // Cached topics are updated from the first package received
+    TelemetryCache::instance().watch(vehicle->subscribe, i, command.topics, command.numTopic);
+    ACK::ErrorCode ack = vehicle->subscribe->startPackage(i, timeout);
+    if (ACK::getError(ack) != ACK::SUCCESS) {
+        DERROR("Error starting package %u (%u Hz)", i, command.frequency);
+        ACK::getErrorCodeMessage(ack, __func__);
+        vehicle->subscribe->removePackage(i, timeout);
+        TelemetryCache::instance().unwatch(i);
+        // Flight controller may have restarted, version is matched again
+        invalidateVerify();
+        return START_PACKAGE_FAILED;
+    }
     return 0;
 }
 
@@ -97,47 +556,266 @@ bool PackageManager::isVehicleInstanced() const {
     return true;
 }
 
-bool PackageManager::validIndex(int index) const {
-    // Separate test for call with PACKAGE_UNAVAILABLE to avoid useless DERROR
-    if(index == PACKAGE_UNAVAILABLE)
+bool PackageManager::validHandle(int handle) const {
+    // Separate test for call with error code to avoid useless DERROR
+    if(handle < 0 && handle >= VEHICLE_NOT_INSTANCED)
         return false;
 
-    if(index < 0 || index >= DataSubscription::MAX_NUMBER_OF_PACKAGE) {
-        DERROR("Invalid index : [%d], must be in range 0 to %d.",
-               index, DataSubscription::MAX_NUMBER_OF_PACKAGE-1);
+    if(handle < 0 || handle >= PACKAGE_MAX_SUBSCRIPTIONS) {
+        DERROR("Invalid handle : [%d], must be in range 0 to %d.",
+               handle, PACKAGE_MAX_SUBSCRIPTIONS-1);
         return false;
     }
     return true;
 }
 
-int PackageManager::allocatePackage() {
+bool PackageManager::unsubscribeAsync(int handle) {
+    if(!isVehicleInstanced() || !validHandle(handle))
+        return false;
     pthread_mutex_lock(&packageManager_mutex);
-    for(int i = 0; i < DataSubscription::MAX_NUMBER_OF_PACKAGE; i++) {
-        if (packageAvailable[i]) {
-            packageAvailable[i] = false;
-            pthread_mutex_unlock(&packageManager_mutex);
-            return i;
-        }
-    }
+    const Subscription &subscription = subscriptions[handle];
+    bool marked = subscription.state != FREE && !subscription.cancelled && !subscription.releasing;
+    if(marked)
+        subscriptions[handle].releasing = true;
     pthread_mutex_unlock(&packageManager_mutex);
-    return PACKAGE_UNAVAILABLE;
+    if(!marked)
+        return false;
+    // Handle is passed as argument value, nothing to allocate
+    if(AckWorkerPool::instance().submit("removePackage", unsubscribeCall, unsubscribeDone,
+                                        (void *)(intptr_t)handle) == nullptr) {
+        unsubscribeDone(ActionToken::CANCELLED, (void *)(intptr_t)handle);
+        return false;
+    }
+    return true;
 }
 
-void PackageManager::releasePackage(int index) {
-    if(validIndex(index)) {
-        pthread_mutex_lock(&packageManager_mutex);
-        packageAvailable[index] = true;
-        pthread_mutex_unlock(&packageManager_mutex);
-    }
+bool PackageManager::unsubscribeCall(void *arg) {
+    return instance().unsubscribe((int)(intptr_t)arg) == 0;
+}
+
+void PackageManager::unsubscribeDone(ActionToken::State state, void *arg) {
+    if(state != ActionToken::CANCELLED)
+        return;
+    // Release was not made, subscription can be released again
+    int handle = (int)(intptr_t)arg;
+    pthread_mutex_lock(&packageManager_mutex);
+    instance().subscriptions[handle].releasing = false;
+    pthread_mutex_unlock(&packageManager_mutex);
 }
 
 
 void PackageManager::clear() {
-    for(int i = 0; i < DataSubscription::MAX_NUMBER_OF_PACKAGE; i++) {
-        if(!packageAvailable[i]) {
+    pthread_mutex_lock(&apply_mutex);
+    pthread_mutex_lock(&packageManager_mutex);
+    for(Subscription &subscription : subscriptions) {
+        // Pending subscriptions are freed by their activation
+        if(subscription.state == PENDING)
+            subscription.cancelled = true;
+        else
+            subscription.state = FREE;
+        subscription.releasing = false;
+    }
+    updateNeeds();
+    for(int i = 0; i < packageCount; i++) {
+        if(packages[i].started) {
             DSTATUS("Clear package : %u", i);
-            unsubscribe(i);
+            packages[i].dirty = true;
         }
     }
+    if(vehicle != nullptr)
+        applyPlan();
+    pthread_mutex_unlock(&packageManager_mutex);
+    pthread_mutex_unlock(&apply_mutex);
+}
+
+void PackageManager::clearAsync() {
+    for(int i = 0; i < PACKAGE_MAX_SUBSCRIPTIONS; i++) {
+        // Subscriptions not used or already being released are skipped
+        if(unsubscribeAsync(i))
+            DSTATUS("Clear subscription : %d", i);
+    }
 }
 
+void PackageManager::printStats() {
+    pthread_mutex_lock(&packageManager_mutex);
+    int used = 0;
+    for(const Subscription &subscription : subscriptions)
+        used += subscription.state != FREE;
+    unsigned long starts = packageStarts;
+    pthread_mutex_unlock(&packageManager_mutex);
+    DSTATUS("Package manager : %d subscriptions, %lu package starts, %lu version match requests",
+            used, starts, verifyCnt.load());
+}
+
+void PackageManager::unitTest() {
+    PackageManager manager;
+    TopicState *topics = manager.topicStates;
+    PackageState *packages = manager.packages;
+    TopicName status[] = {TOPIC_STATUS_FLIGHT, TOPIC_STATUS_DISPLAYMODE};
+    TopicName flight[] = {TOPIC_STATUS_FLIGHT};
+    TopicName gps[] = {TOPIC_GPS_FUSED};
+    TopicName quaternion[] = {TOPIC_QUATERNION};
+
+    // Synthetic sizes, two topics per package and two packages
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        manager.topicSize[i] = 150;
+        manager.topicMaxFreq[i] = 200;
+    }
+    manager.packageCount = 2;
+
+    // Topics of a subscription share a package
+    int a = manager.addSubscription(status, 2, 10, false);
+    assert(a >= 0);
+    assert(topics[TOPIC_STATUS_FLIGHT].package == 0 && topics[TOPIC_STATUS_DISPLAYMODE].package == 0);
+    assert(packages[0].started && packages[0].frequency == 10);
+
+    // Topic already sent fast enough costs no package start
+    unsigned long starts = manager.packageStarts;
+    int b = manager.addSubscription(flight, 1, 5, false);
+    assert(b >= 0 && b != a);
+    assert(topics[TOPIC_STATUS_FLIGHT].refs == 2);
+    assert(manager.packageStarts == starts);
+
+    // Faster topic takes free package, then fills it
+    int c = manager.addSubscription(gps, 1, 50, false);
+    assert(c >= 0 && topics[TOPIC_GPS_FUSED].package == 1 && packages[1].frequency == 50);
+    int d = manager.addSubscription(quaternion, 1, 50, false);
+    assert(d >= 0 && topics[TOPIC_QUATERNION].package == 1);
+    assert(manager.packageStarts == starts + 2);
+
+    // No package suits a faster flight status : all topics are packed again, fastest first
+    int e = manager.addSubscription(flight, 1, 100, false);
+    assert(e >= 0);
+    assert(packages[topics[TOPIC_STATUS_FLIGHT].package].frequency == 100);
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        int index = topics[i].package;
+        assert(topics[i].refs > 0 && index >= 0 && packages[index].frequency >= topics[i].frequency);
+    }
+    for(int i = 0; i < manager.packageCount; i++)
+        assert(packages[i].started && manager.packageSize(i) <= PACKAGE_MAX_SIZE);
+
+    // Package is removed with the last subscription using it
+    starts = manager.packageStarts;
+    assert(manager.removeSubscription(a) == 0);
+    assert(topics[TOPIC_STATUS_FLIGHT].refs == 2 && topics[TOPIC_STATUS_DISPLAYMODE].refs == 0);
+    assert(manager.removeSubscription(c) == 0);
+    assert(manager.removeSubscription(d) == 0);
+    assert(manager.packageStarts == starts);
+    int used = topics[TOPIC_STATUS_FLIGHT].package;
+    int freed = 1 - used;
+    assert(packages[used].started && packages[used].frequency == 100);
+    assert(!packages[freed].started && packages[freed].frequency == 0);
+
+    // Invalid requests
+    assert(manager.addSubscription(quaternion, 0, 10, false) == INVALID_TOPICS);
+    assert(manager.addSubscription(quaternion, 1, 0, false) == INVALID_TOPICS);
+    manager.topicSize[TOPIC_QUATERNION] = PACKAGE_MAX_SIZE;
+    assert(manager.addSubscription(quaternion, 1, 10, true) == INVALID_TOPICS);
+    assert(manager.removeSubscription(a) == INVALID_INDEX);
+    assert(manager.removeSubscription(PACKAGE_MAX_SUBSCRIPTIONS) == INVALID_INDEX);
+
+    // Shared topic until subscriptions are all used
+    int count = 2;
+    int handle;
+    while((handle = manager.addSubscription(flight, 1, 10, false)) >= 0)
+        count++;
+    assert(handle == SUBSCRIPTION_UNAVAILABLE && count == PACKAGE_MAX_SUBSCRIPTIONS);
+    assert(manager.packageStarts == starts);
+
+    // Topics not fitting in packages : subscription fails, nothing changes
+    PackageManager full;
+    for(int i = 0; i < TOTAL_TOPIC_NUMBER; i++) {
+        full.topicSize[i] = 150;
+        full.topicMaxFreq[i] = 200;
+    }
+    full.packageCount = 1;
+    assert(full.addSubscription(flight, 1, 10, false) >= 0);
+    assert(full.addSubscription(gps, 1, 50, false) >= 0);
+    assert(full.packages[0].frequency == 50 && full.packageStarts == 2);
+    assert(full.addSubscription(quaternion, 1, 10, false) == PACKAGE_UNAVAILABLE);
+    assert(full.topicStates[TOPIC_QUATERNION].refs == 0 && full.topicStates[TOPIC_QUATERNION].package == -1);
+    assert(full.packages[0].started && !full.packages[0].dirty && full.packageStarts == 2);
+
+    // Failed removal keeps package started, removal is tried again
+    static std::atomic<bool> removeFails;
+    removeFails.store(true);
+    PackageManager kept;
+    kept.packageCount = 1;
+    kept.sendHook = [](PackageCommand &command) -> int {
+        return command.numTopic == 0 && removeFails.load() ? UNSUBSCRIPTION_FAILED : 0;
+    };
+    // Commands are sent with packageManager_mutex released, it is held as by callers
+    pthread_mutex_lock(&packageManager_mutex);
+    handle = kept.addSubscription(gps, 1, 50, false);
+    assert(handle >= 0 && kept.packages[0].started);
+    assert(kept.removeSubscription(handle) == UNSUBSCRIPTION_FAILED);
+    assert(kept.packages[0].started && kept.packages[0].dirty);
+    removeFails.store(false);
+    assert(kept.applyPlan() == 0);
+    pthread_mutex_unlock(&packageManager_mutex);
+    assert(!kept.packages[0].started && !kept.packages[0].dirty);
+
+    // Reserved subscription sends nothing until activated
+    PackageManager async;
+    async.packageCount = 1;
+    handle = async.reserveSubscription(gps, 1, 50, false);
+    assert(handle >= 0 && async.subscriptions[handle].state == PENDING);
+    async.updateNeeds();
+    assert(async.topicStates[TOPIC_GPS_FUSED].refs == 0 && async.packageStarts == 0);
+    assert(async.activateSubscription(handle) == handle);
+    assert(async.subscriptions[handle].state == ACTIVE && async.packages[0].started);
+    assert(async.activateSubscription(handle) == INVALID_INDEX);
+
+    // Released while pending : freed by activation, packages unchanged
+    int pending = async.reserveSubscription(quaternion, 1, 50, false);
+    assert(pending >= 0 && pending != handle);
+    assert(async.removeSubscription(pending) == 0);
+    assert(async.removeSubscription(pending) == INVALID_INDEX);
+    assert(async.activateSubscription(pending) == SUBSCRIPTION_CANCELLED);
+    assert(async.subscriptions[pending].state == FREE);
+    assert(async.topicStates[TOPIC_QUATERNION].refs == 0 && async.packageStarts == 1);
+
+    // Lock is free while a slow ACK is waited for : control loop calls go on
+    static PackageManager slow;
+    static std::atomic<int> ackState;   // 1 while ACK is waited for, 2 once it may end
+    static int slowHandle;
+    ackState.store(0);
+    slow.packageCount = 1;
+    slow.sendHook = [](PackageCommand &command) -> int {
+        (void)command;
+        ackState.store(1);
+        while(ackState.load() != 2)
+            usleep(1000);
+        return 0;
+    };
+    slowHandle = slow.reserveSubscription(gps, 1, 50, false);
+    assert(slowHandle >= 0);
+    pthread_t threadId;
+    pthread_attr_t threadAttr;
+    auto activate = [](void *arg) -> void * {
+        (void)arg;
+        pthread_mutex_lock(&apply_mutex);
+        pthread_mutex_lock(&packageManager_mutex);
+        slow.activateSubscription(slowHandle);
+        pthread_mutex_unlock(&packageManager_mutex);
+        pthread_mutex_unlock(&apply_mutex);
+        return nullptr;
+    };
+    assert(ThreadManager::start("packageTest", &threadId, &threadAttr, activate, nullptr));
+    while(ackState.load() != 1)
+        usleep(1000);
+    assert(pthread_mutex_trylock(&packageManager_mutex) == 0);
+    pthread_mutex_unlock(&packageManager_mutex);
+    assert(!slow.isReady(slowHandle));
+    pthread_mutex_lock(&packageManager_mutex);
+    int reserved = slow.reserveSubscription(quaternion, 1, 10, false);
+    pthread_mutex_unlock(&packageManager_mutex);
+    assert(reserved >= 0 && reserved != slowHandle);
+    // Commands are serialized, a release waits for the ACK
+    assert(pthread_mutex_trylock(&apply_mutex) == EBUSY);
+    ackState.store(2);
+    ThreadManager::stop(&threadId, "packageTest");
+    assert(slow.isReady(slowHandle) && slow.packages[0].started && slow.packageStarts == 1);
+
+    DSTATUS("PackageManager test passed");
+}
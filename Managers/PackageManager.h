@@ -15,10 +15,18 @@
  * user to add as many Telemetry Topics per package as desired.
  *
  * PackageManager is a singleton class providing easy use of
- * package API. When user need a package, subscribe() method
- * return used packageId (0 to 5). Subscription errors
- * (no more package available, init or start errror from API, ...)
- * are handle.
+ * package API. Users subscribe to topics, not to packages :
+ * subscribe() returns a subscription handle. Topics requested by
+ * several users are sent once, each topic counts its subscriptions
+ * and is sent at the highest requested frequency. Topics are packed
+ * into as few packages as possible within the 300-Bytes budget :
+ * a topic already sent fast enough costs no ACK, a missing one is
+ * added to a package with room and suitable frequency, then to a
+ * free package. All topics are packed again, largest frequencies
+ * first, only when none fits. A package is started again only when
+ * its content changes and removed once its last topic is released.
+ * Subscription errors (packages full, init or start errror from
+ * API, ...) are handle.
  *
  * @example
  * Here is an example, user want STATUS_FLIGHT and
@@ -32,24 +40,49 @@
     int  numTopics          = sizeof(topics) / sizeof(topics[0]);
     boolean enableTimestamp = false;
 
-    int pkgIndex = PackageManager::instance().subscribe(topics,
+    int handle = PackageManager::instance().subscribe(topics,
         numTopics, frequency, enableTimestamp);
-    if(pkgIndex < 0) {
+    if(handle < 0) {
         DERROR("Monitored takeoff - Failed to start package");
         return false;
     }
     @endcode
  *
+ * Version match is requested once, on first subscription, then kept
+ * until setVehicle() or a package start is refused (flight controller
+ * restarted), see invalidateVerify().
+ * subscribeAsync() returns a handle at once : packages are started by
+ * AckWorkerPool and its token is done when topics are sent, so caller
+ * can send its own commands meanwhile.
+ *
+ * Values of subscribed topics are read from TelemetryCache, updated
+ * once per received package.
+ *
+ * Package commands are planned under packageManager_mutex, then sent to
+ * the aircraft without it : calls made from the control loop (isReady,
+ * subscribeAsync, unsubscribeAsync, clearAsync) never wait for an ACK.
+ * Commands themselves are serialized by apply_mutex.
+ *
  */
 
 #ifndef MATRICE210_PACKAGEMANAGER_H
 #define MATRICE210_PACKAGEMANAGER_H
 
 
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <pthread.h>
 
 #include <dji_vehicle.hpp>
 
+#include "../Action/ActionExecutor.h"
+
+#define PACKAGE_MAX_SIZE 300            /*!< Package buffer size [Byte] */
+#define PACKAGE_TIMESTAMP_SIZE 8        /*!< Size of package time in package [Byte] */
+#define PACKAGE_MAX_SUBSCRIPTIONS 16    /*!< Maximal number of subscriptions */
+#define PACKAGE_MAX_TOPICS 16           /*!< Maximal number of topics per subscription */
+
 using namespace DJI::OSDK;
 using namespace DJI::OSDK::Telemetry;
 
@@ -57,7 +90,10 @@ namespace M210 {
     class PackageManager : public Singleton<PackageManager> {
     public:
         enum RETURN_ERROR_CODE {        /*!< Error code values, have to be negative */
-            VEHICLE_NOT_INSTANCED = -7,
+            VEHICLE_NOT_INSTANCED = -10,
+            INVALID_TOPICS,
+            SUBSCRIPTION_CANCELLED,
+            SUBSCRIPTION_UNAVAILABLE,
             VERIFY_FAILED,
             INVALID_INDEX,
             START_PACKAGE_FAILED,
@@ -66,10 +102,56 @@ namespace M210 {
             PACKAGE_UNAVAILABLE     // -1
         };
     private:
+        enum SubscriptionState {
+            FREE,
+            PENDING,                    /*!< Reserved by subscribeAsync(), packages not started yet */
+            ACTIVE                      /*!< Topics are sent */
+        };
+        struct Subscription {           /*!< Topics requested by one user */
+            SubscriptionState state;
+            bool releasing;             /*!< Release submitted to AckWorkerPool */
+            bool cancelled;             /*!< Released while pending, freed when its activation is done */
+            bool starting;              /*!< Active, its packages are being started */
+            uint16_t frequency;         /*!< Requested frequency [Hz] */
+            bool timestamp;             /*!< Package time requested */
+            int numTopic;
+            TopicName topics[PACKAGE_MAX_TOPICS];
+        };
+        struct TopicState {             /*!< Needs of all subscriptions, and package sending topic */
+            int refs;                   /*!< Number of subscriptions using topic, 0 if unused */
+            uint16_t frequency;         /*!< Highest requested frequency, bounded by topic maximal frequency [Hz] */
+            bool timestamp;             /*!< A subscription requested package time */
+            int package;                /*!< Package sending topic, -1 if none */
+        };
+        struct PackageState {
+            uint16_t frequency;         /*!< Package frequency [Hz], 0 if package is free */
+            bool timestamp;             /*!< Package time is sent */
+            bool started;               /*!< Package is started on aircraft */
+            bool dirty;                 /*!< Content changed, package has to be started again */
+        };
+        struct PackageCommand {         /*!< Planned by applyPlan(), sent without packageManager_mutex */
+            int index;                  /*!< Package index */
+            bool remove;                /*!< Package is started on aircraft and has to be removed first */
+            int numTopic;               /*!< Topics to start package with, 0 to only remove it */
+            TopicName topics[TOTAL_TOPIC_NUMBER];
+            bool timestamp;
+            uint16_t frequency;         /*!< [Hz] */
+        };
+
         const Vehicle *vehicle = nullptr;
         int timeout{1};             /*!< DJI subscription method call timeout */
-        bool packageAvailable[DataSubscription::MAX_NUMBER_OF_PACKAGE]; /*!< Available packages */
-        static pthread_mutex_t packageManager_mutex; /*!< Protect package array on allocation/release operations */
+        std::atomic<bool> verified{false};          /*!< Version matched, until link is established again */
+        std::atomic<unsigned long> verifyCnt{0};    /*!< Number of version match requests sent */
+        int packageCount{DataSubscription::MAX_NUMBER_OF_PACKAGE};  /*!< Packages managed, lowered by unit test */
+        Subscription subscriptions[PACKAGE_MAX_SUBSCRIPTIONS];
+        TopicState topicStates[TOTAL_TOPIC_NUMBER];
+        PackageState packages[DataSubscription::MAX_NUMBER_OF_PACKAGE];
+        size_t topicSize[TOTAL_TOPIC_NUMBER];       /*!< Topic size in package [Byte] */
+        uint16_t topicMaxFreq[TOTAL_TOPIC_NUMBER];  /*!< Topic maximal frequency [Hz] */
+        unsigned long packageStarts{0};             /*!< Number of packages started, restarts included */
+        int (*sendHook)(PackageCommand &command){nullptr};  /*!< Replaces aircraft calls, set by unit test */
+        static pthread_mutex_t packageManager_mutex; /*!< Protect subscription, topic and package arrays */
+        static pthread_mutex_t apply_mutex;         /*!< Serialize package commands, taken before packageManager_mutex */
         /**
          * Verify if setVehicle() has been called
          * @return true is vehicle has been instanced
@@ -77,33 +159,121 @@ namespace M210 {
         bool isVehicleInstanced() const;
 
         /**
-         * Verify that index is a valid number
-         * Range is 0 to DataSubscription::MAX_NUMBER_OF_PACKAGE -1
-         * @param index Package index to verify
+         * Verify that handle is a valid number
+         * Range is 0 to PACKAGE_MAX_SUBSCRIPTIONS -1
+         * @param handle Subscription handle to verify
          * @return true if valid
          */
-        bool validIndex(int index) const;
+        bool validHandle(int handle) const;
+
+        /**
+        * Verify version match. Request is sent until it succeeds once,
+        * then result is kept until invalidateVerify()
+        * @return true if version match
+        */
+        bool verify();
+
+        /**
+         * Reserve a subscription, topics are not sent until it is activated.
+         * Called with packageManager_mutex locked
+         * @return Subscription handle, negative value of RETURN_ERROR_CODE if request is invalid
+         */
+        int reserveSubscription(const TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp);
 
         /**
-         * Verify that a package is available.
-         * See DataSubscription::MAX_NUMBER_OF_PACKAGE
-         * @return PackageManager::PACKAGE_UNAVAILABLE if all packages are used
-         * package number if a package was allocated
+         * Start packages whose content changed with a reserved subscription.
+         * Without vehicle, packages are only planned (unit test).
+         * Subscription is freed on failure, or if it was released while pending.
+         * Called with apply_mutex and packageManager_mutex locked
+         * @param handle Reserved subscription handle
+         * @return Subscription handle, negative value of RETURN_ERROR_CODE if subscription failed
          */
-        int allocatePackage();
+        int activateSubscription(int handle);
 
         /**
-         * Set package available for new allocation in package array
-         * @param index Package index to set available
-         *
+         * Reserve and activate a subscription.
+         * Called with apply_mutex and packageManager_mutex locked
+         * @return Subscription handle, negative value of RETURN_ERROR_CODE if subscription failed
          */
-        void releasePackage(int index);
+        int addSubscription(const TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp);
 
         /**
-        * Verify version match
-        * @return true if version match
-        */
-        bool verify() const;
+         * Release a subscription and remove packages left without topic.
+         * A pending subscription is only marked cancelled.
+         * Called with apply_mutex and packageManager_mutex locked
+         * @param handle Subscription handle
+         * @return 0 if success, negative value of RETURN_ERROR_CODE otherwise
+         */
+        int removeSubscription(int handle);
+
+        /**
+         * Compute topic references, frequencies and timestamps from subscriptions
+         */
+        void updateNeeds();
+
+        /**
+         * Package size with its topics still used [Byte]
+         * @param index Package index
+         */
+        size_t packageSize(int index) const;
+
+        /**
+         * Check that a topic can be sent by a package
+         * @param index Package index
+         * @param topic Topic to add
+         * @return true if package frequency suits topic and topic fits in package
+         */
+        bool canHold(int index, int topic) const;
+
+        /**
+         * Add a topic to a package, package is marked dirty
+         * @param index Package index, free package takes topic frequency
+         * @param topic Topic to add
+         */
+        void place(int index, int topic);
+
+        /**
+         * Sort topics by decreasing frequency, then decreasing size
+         * @param topics Topics to sort
+         * @param count Number of topics
+         */
+        void sortTopics(int *topics, int count) const;
+
+        /**
+         * Assign each used topic to a package. Packages whose content
+         * changes are marked dirty. Topics and packages are left unchanged
+         * if topics do not fit in packages
+         * @return false if topics do not fit in packages
+         */
+        bool plan();
+
+        /**
+         * Pack all used topics again, largest frequencies first
+         * @return false if topics do not fit in packages
+         */
+        bool repack();
+
+        /**
+         * Remove dirty packages from aircraft, then start them again
+         * with their topics still used. Called with apply_mutex and
+         * packageManager_mutex locked, the latter is unlocked while
+         * commands are sent
+         * @return 0 if success, negative value of RETURN_ERROR_CODE of the last failure
+         */
+        int applyPlan();
+
+        /**
+         * Send a package command to the aircraft and wait for its ACKs.
+         * Called without packageManager_mutex
+         * @param command Package to remove, then start again
+         * @return 0 if success, negative value of RETURN_ERROR_CODE otherwise
+         */
+        int send(PackageCommand &command);
+
+        static bool subscribeCall(void *arg);       /*!< AckWorkerPool call, arg is subscription handle */
+        static void subscribeDone(ActionToken::State state, void *arg);
+        static bool unsubscribeCall(void *arg);     /*!< AckWorkerPool call, arg is subscription handle */
+        static void unsubscribeDone(ActionToken::State state, void *arg);
     public:
         /**
         *  PackageManager is a singleton
@@ -111,34 +281,97 @@ namespace M210 {
         PackageManager();
 
         /**
-         * Has to be called before usage to define vehicle to send package
+         * Has to be called before usage to define vehicle to send package.
+         * Version has to match again
          * @param vehicle Pointer to used vehicle
          */
         void setVehicle(const Vehicle *vehicle);
 
         /**
-         * Try to allocate package. Setup members of package and start it
-         * @param topics List of Topic Names to subscribe in the package
+         * Version match is requested again on next subscription. Called
+         * by setVehicle() and when a package start is refused, since the
+         * flight controller may have restarted
+         */
+        void invalidateVerify();
+
+        /**
+         * Subscribe to topics. Topics already sent fast enough are shared,
+         * others are added to packages, started again if needed
+         * @param topics List of Topic Names to subscribe, at most PACKAGE_MAX_TOPICS
          * @param numTopic Number of topics in topics list
-         * @param frequency Package frequency
+         * @param frequency Requested frequency, topics may be sent faster
          * @param enableTimestamp Enable send of transmission package time
          * @return Negative value of PackageManager::RETURN_ERROR_CODE if subscription failed
-         * Positive package index if success
+         * Positive subscription handle if success
          */
         int subscribe(TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp);
 
         /**
-         * Unsubscribe from indexed topic
-         * @param index Package index
+         * Subscribe to topics without waiting for ACKs. Request is checked
+         * and subscription reserved at once, version match and packages
+         * start are submitted to AckWorkerPool. Handle can be released at
+         * any time, see isReady()
+         * @param topics List of Topic Names to subscribe, at most PACKAGE_MAX_TOPICS
+         * @param numTopic Number of topics in topics list
+         * @param frequency Requested frequency, topics may be sent faster
+         * @param enableTimestamp Enable send of transmission package time
+         * @param ready Token, SUCCEEDED once topics are sent, FAILED or
+         * CANCELLED if subscription failed. nullptr if request was rejected
+         * @return Negative value of PackageManager::RETURN_ERROR_CODE if request was rejected
+         * Positive subscription handle otherwise
+         */
+        int subscribeAsync(const TopicName *topics, int numTopic, uint16_t frequency, bool enableTimestamp,
+                           std::shared_ptr<ActionToken> &ready);
+
+        /**
+         * Check that topics of a subscription are sent
+         * @param handle Subscription handle
+         * @return true once packages of subscription are started
+         */
+        bool isReady(int handle);
+
+        /**
+         * Release a subscription. Packages left without topic are removed
+         * @param handle Subscription handle
          * @return Negative value of PackageManager::RETURN_ERROR_CODE if unsubscription failed
          * 0 if success
          */
-        int unsubscribe(int index);
+        int unsubscribe(int handle);
+
+        /**
+         * Submit subscription release to AckWorkerPool. Never blocks.
+         * Does nothing if subscription is not used or its release is
+         * already submitted
+         * @param handle Subscription handle
+         * @return false if release was not submitted
+         */
+        bool unsubscribeAsync(int handle);
+
+        /**
+         * Number of version match requests sent to aircraft
+         */
+        unsigned long getVerifyCount() const { return verifyCnt.load(); }
 
         /**
-         * Unsubscribe to all subscribed packages
+         * Display counters on console
+         */
+        void printStats();
+
+        /**
+         * Release all subscriptions and remove all packages
          */
         void clear();
+
+        /**
+         * Submit release of all subscriptions to AckWorkerPool. Never blocks
+         */
+        void clearAsync();
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
     };
 }
 #endif //MATRICE210_PACKAGEMANAGER_H
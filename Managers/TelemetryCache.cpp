@@ -0,0 +1,285 @@
+/*! @file TelemetryCache.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief TelemetryCache.h implementation
+ */
+
+#include "TelemetryCache.h"
+
+#include <cassert>
+#include <unistd.h>
+
+#include "ThreadManager.h"
+#include "../util/Log.h"
+#include "../util/timer.h"
+
+using namespace M210;
+
+TelemetryCache::TelemetryCache() {
+    pthread_mutex_init(&write_mutex, nullptr);
+    for(uint32_t &fields : packageFields)
+        fields = 0;
+    readCnt.store(0);
+    retryCnt.store(0);
+}
+
+TelemetryCache::~TelemetryCache() {
+    pthread_mutex_destroy(&write_mutex);
+}
+
+void TelemetryCache::setVehicle(Vehicle *vehicle) {
+    vehicle->broadcast->setUserBroadcastCallback(broadcastCallback, nullptr);
+}
+
+void TelemetryCache::watch(DataSubscription *subscription, int index, const TopicName *topics, int numTopic) {
+    if(index < 0 || index >= DataSubscription::MAX_NUMBER_OF_PACKAGE)
+        return;
+    uint32_t fields = 0;
+    for(int i = 0; i < numTopic; i++) {
+        Field field = fieldOf(topics[i]);
+        if(field != FIELD_COUNT)
+            fields |= 1u << field;
+    }
+    pthread_mutex_lock(&write_mutex);
+    packageFields[index] = fields;
+    pthread_mutex_unlock(&write_mutex);
+    // Package index is given back to callback
+    if(subscription != nullptr)
+        subscription->registerUserPackageUnpackCallback(index, packageCallback, (UserData)(intptr_t)index);
+}
+
+void TelemetryCache::unwatch(int index) {
+    if(index < 0 || index >= DataSubscription::MAX_NUMBER_OF_PACKAGE)
+        return;
+    pthread_mutex_lock(&write_mutex);
+    packageFields[index] = 0;
+    uint32_t carried = 1u << GLOBAL_POSITION;   // Broadcast is never stopped
+    for(uint32_t fields : packageFields)
+        carried |= fields;
+    if((staging.valid & ~carried) != 0) {
+        staging.valid &= carried;
+        publish();
+    }
+    pthread_mutex_unlock(&write_mutex);
+}
+
+void TelemetryCache::read(Snapshot &data) {
+    unsigned retries = snapshot.read(data);
+    readCnt.fetch_add(1, std::memory_order_relaxed);
+    if(retries != 0)
+        retryCnt.fetch_add(retries, std::memory_order_relaxed);
+}
+
+void TelemetryCache::publish() {
+    snapshot.write(staging);
+}
+
+void TelemetryCache::packageCallback(Vehicle *vehicle, RecvContainer recvFrame, UserData userData) {
+    (void)recvFrame;
+    auto index = (int)(intptr_t)userData;
+    TelemetryCache &cache = instance();
+    long long now = getMonotonicNs();
+    pthread_mutex_lock(&cache.write_mutex);
+    uint32_t fields = cache.packageFields[index];
+    Snapshot &staging = cache.staging;
+    // Each topic is copied once, whatever the number of readers
+    if(fields & (1u << FLIGHT_STATUS))
+        staging.flightStatus = vehicle->subscribe->getValue<TOPIC_STATUS_FLIGHT>();
+    if(fields & (1u << DISPLAY_MODE))
+        staging.displayMode = vehicle->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>();
+    if(fields & (1u << QUATERNION))
+        staging.quaternion = vehicle->subscribe->getValue<TOPIC_QUATERNION>();
+    if(fields & (1u << GPS_FUSED))
+        staging.gpsFused = vehicle->subscribe->getValue<TOPIC_GPS_FUSED>();
+    if(fields != 0) {
+        for(int field = 0; field < FIELD_COUNT; field++) {
+            if(fields & (1u << field))
+                staging.updateTime[field] = now;
+        }
+        staging.valid |= fields;
+        cache.publish();
+    }
+    pthread_mutex_unlock(&cache.write_mutex);
+}
+
+void TelemetryCache::broadcastCallback(Vehicle *vehicle, RecvContainer recvFrame, UserData userData) {
+    (void)recvFrame;
+    (void)userData;
+    TelemetryCache &cache = instance();
+    pthread_mutex_lock(&cache.write_mutex);
+    cache.staging.globalPosition = vehicle->broadcast->getGlobalPosition();
+    cache.staging.updateTime[GLOBAL_POSITION] = getMonotonicNs();
+    cache.staging.valid |= 1u << GLOBAL_POSITION;
+    cache.publish();
+    pthread_mutex_unlock(&cache.write_mutex);
+}
+
+TelemetryCache::Field TelemetryCache::fieldOf(TopicName topic) {
+    switch(topic) {
+        case TOPIC_STATUS_FLIGHT:
+            return FLIGHT_STATUS;
+        case TOPIC_STATUS_DISPLAYMODE:
+            return DISPLAY_MODE;
+        case TOPIC_QUATERNION:
+            return QUATERNION;
+        case TOPIC_GPS_FUSED:
+            return GPS_FUSED;
+        default:
+            return FIELD_COUNT;
+    }
+}
+
+void TelemetryCache::printStats(unsigned long ticks) const {
+    unsigned long reads = readCnt.load(std::memory_order_relaxed);
+    DSTATUS("Telemetry cache : %lu updates, %lu reads, %lu retries, %.2f reads per control tick",
+            snapshot.getWrites(), reads, retryCnt.load(std::memory_order_relaxed),
+            ticks != 0 ? (double)reads / ticks : 0.0);
+}
+
+namespace {
+    struct BenchWriter {
+        TelemetryCache *cache;
+        long periodUs;                  /*!< Time between two updates [us], 0 for continuous updates */
+        std::atomic<bool> running;
+    };
+}
+
+void *TelemetryCache::benchmarkWriter(void *param) {
+    auto writer = static_cast<BenchWriter *>(param);
+    TelemetryCache *cache = writer->cache;
+    double value = 0.0;
+    while(writer->running.load()) {
+        pthread_mutex_lock(&cache->write_mutex);
+        value += 1.0;
+        cache->staging.gpsFused.latitude = value;
+        cache->staging.gpsFused.longitude = value;
+        cache->staging.quaternion.q0 = (float)value;
+        cache->staging.updateTime[GPS_FUSED] = (long long)value;
+        cache->publish();
+        pthread_mutex_unlock(&cache->write_mutex);
+        if(writer->periodUs > 0)
+            usleep((useconds_t)writer->periodUs);
+    }
+    return nullptr;
+}
+
+void TelemetryCache::benchmark() {
+    const int reads = 1000000;
+    volatile double sink = 0.0;     // Keeps copies from being optimized out
+
+    // Before : each mission topic copied with getValue(), behind SDK mutex
+    pthread_mutex_t sdkMutex = PTHREAD_MUTEX_INITIALIZER;
+    TypeMap<TOPIC_GPS_FUSED>::type sdkGps{};
+    TypeMap<TOPIC_QUATERNION>::type sdkQuaternion{};
+    long long start = getMonotonicNs();
+    for(int i = 0; i < reads; i++) {
+        TypeMap<TOPIC_GPS_FUSED>::type gps;
+        TypeMap<TOPIC_QUATERNION>::type quaternion;
+        pthread_mutex_lock(&sdkMutex);
+        gps = sdkGps;
+        pthread_mutex_unlock(&sdkMutex);
+        pthread_mutex_lock(&sdkMutex);
+        quaternion = sdkQuaternion;
+        pthread_mutex_unlock(&sdkMutex);
+        sink = sink + gps.latitude + quaternion.q0;
+    }
+    double sdkNs = (double)(getMonotonicNs() - start) / reads;
+    DSTATUS("TelemetryCache benchmark, %d reads", reads);
+    DSTATUS("SDK getValue() behind a mutex     : 2 reads per tick, %6.1f ns per read", sdkNs / 2);
+
+    struct {
+        const char *name;
+        long periodUs;      /*!< -1 for no writer */
+    } cases[] = {
+            {"no writer                    ", -1},
+            {"writer at 50 Hz              ", 20000},
+            {"writer updating continuously ", 0}
+    };
+    for(auto &test : cases) {
+        TelemetryCache cache;
+        BenchWriter writer;
+        writer.cache = &cache;
+        writer.periodUs = test.periodUs;
+        writer.running.store(true);
+        pthread_t threadId;
+        pthread_attr_t threadAttr;
+        bool writing = test.periodUs >= 0 &&
+                       ThreadManager::start("cacheWriter", &threadId, &threadAttr, benchmarkWriter, &writer);
+        Snapshot data{};
+        start = getMonotonicNs();
+        for(int i = 0; i < reads; i++) {
+            cache.read(data);
+            sink = sink + data.gpsFused.latitude;
+            // Consistency : both fields come from the same update
+            assert(data.gpsFused.latitude == data.gpsFused.longitude);
+        }
+        double ns = (double)(getMonotonicNs() - start) / reads;
+        if(writing) {
+            writer.running.store(false);
+            ThreadManager::stop(&threadId, "cacheWriter");
+        }
+        DSTATUS("Cache read, %s: 1 read per tick,  %6.1f ns per read, %.4f retries per read, %lu updates",
+                test.name, ns, (double)cache.retryCnt.load() / reads, cache.snapshot.getWrites());
+    }
+    (void)sink;
+}
+
+void TelemetryCache::unitTest() {
+    TelemetryCache cache;
+    Snapshot data{};
+    TopicName status[] = {TOPIC_STATUS_FLIGHT, TOPIC_STATUS_DISPLAYMODE};
+    TopicName position[] = {TOPIC_QUATERNION, TOPIC_GPS_FUSED, TOPIC_STATUS_FLIGHT};
+
+    // Nothing received yet
+    cache.read(data);
+    assert(data.valid == 0);
+    assert(fieldOf(TOPIC_GPS_FUSED) == GPS_FUSED);
+
+    // Fields become valid on reception, as done by packageCallback()
+    cache.watch(nullptr, 0, status, 2);
+    cache.watch(nullptr, 1, position, 3);
+    assert(cache.packageFields[0] == ((1u << FLIGHT_STATUS) | (1u << DISPLAY_MODE)));
+    pthread_mutex_lock(&cache.write_mutex);
+    cache.staging.flightStatus = VehicleStatus::FlightStatus::IN_AIR;
+    cache.staging.gpsFused.latitude = 0.8;
+    cache.staging.gpsFused.longitude = 0.8;
+    cache.staging.updateTime[FLIGHT_STATUS] = 2000;
+    cache.staging.valid = cache.packageFields[0] | cache.packageFields[1];
+    cache.publish();
+    pthread_mutex_unlock(&cache.write_mutex);
+    cache.read(data);
+    assert(data.isValid(DISPLAY_MODE) && data.isValid(GPS_FUSED));
+    // Values received before a subscription are not fresh for it
+    assert(data.isFresh(FLIGHT_STATUS, 1999) && !data.isFresh(FLIGHT_STATUS, 2000));
+    assert(data.flightStatus == VehicleStatus::FlightStatus::IN_AIR);
+    assert(data.gpsFused.latitude == 0.8);
+
+    // Flight status is still carried by package 1, display mode is not
+    cache.unwatch(0);
+    cache.read(data);
+    assert(data.isValid(FLIGHT_STATUS) && !data.isValid(DISPLAY_MODE));
+    cache.unwatch(1);
+    cache.read(data);
+    assert(data.valid == 0);
+
+    // Reads made while values are written are consistent
+    BenchWriter writer;
+    writer.cache = &cache;
+    writer.periodUs = 0;
+    writer.running.store(true);
+    pthread_t threadId;
+    pthread_attr_t threadAttr;
+    assert(ThreadManager::start("cacheTest", &threadId, &threadAttr, benchmarkWriter, &writer));
+    long long end = getMonotonicNs() + 100000000LL;
+    while(getMonotonicNs() < end) {
+        cache.read(data);
+        assert(data.gpsFused.latitude == data.gpsFused.longitude);
+        assert((long long)data.gpsFused.latitude == data.updateTime[GPS_FUSED]);
+    }
+    writer.running.store(false);
+    ThreadManager::stop(&threadId, "cacheTest");
+    assert(cache.snapshot.getWrites() > 3);
+
+    DSTATUS("TelemetryCache test passed");
+}
@@ -0,0 +1,145 @@
+/*! @file TelemetryCache.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Latest telemetry values, updated once per received package.
+ *
+ *  PackageManager registers each started package here. When the SDK
+ *  has unpacked a package, its cached topics are read once with
+ *  getValue() and published as a new Snapshot. Global position comes
+ *  from broadcast, updated the same way.
+ *
+ *  Missions read a whole Snapshot with read() : flight status and display
+ *  mode, or quaternion and fused GPS, are taken from the same instant, and
+ *  readers never take the SDK lock nor wait for a writer (see SeqLock.h).
+ *
+ *  Only topics listed in Field are cached, add a field to cache a new one.
+ */
+
+#ifndef MATRICE210_TELEMETRYCACHE_H
+#define MATRICE210_TELEMETRYCACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <pthread.h>
+
+#include <dji_vehicle.hpp>
+
+#include "../util/SeqLock.h"
+
+using namespace DJI::OSDK;
+using namespace DJI::OSDK::Telemetry;
+
+namespace M210 {
+    class TelemetryCache : public Singleton<TelemetryCache> {
+    public:
+        enum Field {            /*!< Cached values */
+            FLIGHT_STATUS,      /*!< TOPIC_STATUS_FLIGHT */
+            DISPLAY_MODE,       /*!< TOPIC_STATUS_DISPLAYMODE */
+            QUATERNION,         /*!< TOPIC_QUATERNION */
+            GPS_FUSED,          /*!< TOPIC_GPS_FUSED */
+            GLOBAL_POSITION,    /*!< Broadcast global position */
+            FIELD_COUNT
+        };
+        struct Snapshot {       /*!< Copied by read() */
+            TypeMap<TOPIC_STATUS_FLIGHT>::type flightStatus;
+            TypeMap<TOPIC_STATUS_DISPLAYMODE>::type displayMode;
+            TypeMap<TOPIC_QUATERNION>::type quaternion;
+            TypeMap<TOPIC_GPS_FUSED>::type gpsFused;
+            GlobalPosition globalPosition;
+            uint32_t valid;                         /*!< Bit set of Field received from a package still subscribed */
+            long long updateTime[FIELD_COUNT];      /*!< Monotonic time each field was received [ns], 0 if never */
+
+            bool isValid(Field field) const { return (valid & (1u << field)) != 0; }
+
+            /**
+             * Field is valid and was received after a given time
+             * @param field Field to check
+             * @param since Monotonic time [ns], e.g. subscription time
+             * @return false for a value of a previous subscription
+             */
+            bool isFresh(Field field, long long since) const {
+                return isValid(field) && updateTime[field] > since;
+            }
+        };
+    private:
+        SeqLock<Snapshot> snapshot;                 /*!< Published values */
+        Snapshot staging{};                         /*!< Last published values, modified by writers */
+        pthread_mutex_t write_mutex;                /*!< Serialize writers, readers never take it */
+        uint32_t packageFields[DataSubscription::MAX_NUMBER_OF_PACKAGE]; /*!< Bit set of Field carried by each package */
+        // Counters
+        std::atomic<unsigned long> readCnt;
+        std::atomic<unsigned long> retryCnt;        /*!< Copies made again because of a concurrent write */
+
+        /**
+         * Publish staging. Called with write_mutex locked
+         */
+        void publish();
+
+        static void packageCallback(Vehicle *vehicle, RecvContainer recvFrame, UserData userData);
+        static void broadcastCallback(Vehicle *vehicle, RecvContainer recvFrame, UserData userData);
+        static void *benchmarkWriter(void *param);  /*!< Benchmark thread, publishes values as a package would */
+    public:
+        TelemetryCache();
+
+        ~TelemetryCache();
+
+        /**
+         * Cache global position on each broadcast
+         * @param vehicle Vehicle sending broadcast
+         */
+        void setVehicle(Vehicle *vehicle);
+
+        /**
+         * Cache topics of a package on each reception. Called by
+         * PackageManager before package is started
+         * @param subscription Vehicle subscription, nullptr to only set package topics
+         * @param index Package index
+         * @param topics Package topics, topics without Field are ignored
+         * @param numTopic Number of topics
+         */
+        void watch(DataSubscription *subscription, int index, const TopicName *topics, int numTopic);
+
+        /**
+         * Stop caching a package. Its fields are no longer valid unless
+         * another package carries them. Called by PackageManager
+         * @param index Package index
+         */
+        void unwatch(int index);
+
+        /**
+         * Copy latest values. Never locks
+         * @param data Snapshot to fill
+         */
+        void read(Snapshot &data);
+
+        /**
+         * Field caching a topic
+         * @param topic Topic name
+         * @return Field, FIELD_COUNT if topic is not cached
+         */
+        static Field fieldOf(TopicName topic);
+
+        /**
+         * Display counters on console
+         * @param ticks Control loop ticks, used to display reads per tick
+         */
+        void printStats(unsigned long ticks) const;
+
+        /**
+         * Measure read time without writer, with a writer updating at
+         * package rate and with a writer updating continuously. SDK
+         * getValue() copy behind a mutex is measured for comparison.
+         * Results are displayed on console
+         */
+        static void benchmark();
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_TELEMETRYCACHE_H
@@ -7,6 +7,16 @@
 
 #include "ThreadManager.h"
 
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
 #include <dji_vehicle.hpp>
 
 #include "../util/Log.h"
@@ -14,25 +24,194 @@
 
 using namespace M210;
 
-bool ThreadManager::start(string name, pthread_t *id, pthread_attr_t *attr, void *(*thread)(void *), void *arg) {
-    // todo remove attr parameter
+namespace {
+    const ThreadManager::ProfileSettings profiles[ThreadManager::PROFILE_COUNT] = {
+            // name         policy       priority cpu  stackSize
+            {"default",     SCHED_OTHER, 0,       -1,  256 * 1024},
+            // Above DJI serial reader, the thread sleeps between two orders
+            {"control",     SCHED_FIFO,  80,      -1,  256 * 1024},
+            {"background",  SCHED_BATCH, 0,       -1,  256 * 1024}
+    };
+
+    /**
+     * Signals starting shutdown
+     * @param signals Set to SIGINT and SIGTERM
+     */
+    void getShutdownSignals(sigset_t *signals) {
+        sigemptyset(signals);
+        sigaddset(signals, SIGINT);
+        sigaddset(signals, SIGTERM);
+    }
+}
+
+std::atomic<bool> ThreadManager::shutdownRequested{false};
+std::atomic<bool> ThreadManager::listenerRunning{false};
+pthread_t ThreadManager::listenerThreadID;
+void (*ThreadManager::onShutdown)(void *) = nullptr;
+void *ThreadManager::onShutdownArg = nullptr;
+
+bool ThreadManager::start(string name, pthread_t *id, pthread_attr_t *attr, void *(*thread)(void *), void *arg,
+                          Profile profile) {
+    const ProfileSettings &settings = getProfileSettings(profile);
     pthread_attr_init(attr);
     pthread_attr_setdetachstate(attr, PTHREAD_CREATE_JOINABLE);
+    const char *failedSetting = applyProfile(attr, settings);
+    if (failedSetting != nullptr) {
+        DERROR("Fail to set %s of %s profile for %s !", failedSetting, settings.name, name.c_str());
+        pthread_attr_destroy(attr);
+        pthread_attr_init(attr);
+        pthread_attr_setdetachstate(attr, PTHREAD_CREATE_JOINABLE);
+    }
 
-    int ret = pthread_create(id, nullptr, thread, arg);
+    int ret = pthread_create(id, attr, thread, arg);
+    pthread_attr_destroy(attr);
     if (ret != 0) {
-        DERROR("Fail to create thread for %s !", name.c_str());
+        DERROR("Fail to create thread for %s : %s !", name.c_str(), strerror(ret));
         return false;
     }
 
+    // Set after creation since pthread attributes do not accept SCHED_BATCH
+    setScheduling(*id, name, profile);
+
     ret = pthread_setname_np(*id, name.c_str());
     if (ret != 0)
         DERROR("Fail to set thread name for %s !", name.c_str());
 
-    DSTATUS("%s launched...", name.c_str());
+    DSTATUS("%s launched with %s profile...", name.c_str(), settings.name);
+    return true;
+}
+
+bool ThreadManager::setScheduling(pthread_t id, const string &name, Profile profile) {
+    const ProfileSettings &settings = getProfileSettings(profile);
+    if (settings.policy == SCHED_OTHER)
+        return true;
+    struct sched_param param{};
+    param.sched_priority = settings.priority;
+    int ret = pthread_setschedparam(id, settings.policy, &param);
+    if (ret != 0) {
+        DERROR("Fail to set scheduling of %s profile for %s : %s !",
+               settings.name, name.c_str(), strerror(ret));
+        if (ret == EPERM)
+            DERROR("Run as root or give CAP_SYS_NICE to keep control loop timing under load");
+        return false;
+    }
+    return true;
+}
+
+bool ThreadManager::stop(const pthread_t *id, const string &name, unsigned long timeoutMs) {
+    long long start = getMonotonicNs();
+    // Join deadline is given on system clock
+    timespec deadline{};
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    int ret = pthread_timedjoin_np(*id, nullptr, &deadline);
+    double elapsed = (getMonotonicNs() - start) / 1000000.0;
+    if (ret != 0) {
+        DERROR("%s not stopped after %.1f ms, left running : %s !", name.c_str(), elapsed, strerror(ret));
+        return false;
+    }
+    DSTATUS("%s stopped in %.1f ms", name.c_str(), elapsed);
     return true;
 }
 
-void ThreadManager::stop(const pthread_t *id) {
-    pthread_join(*id, nullptr);
+bool ThreadManager::startShutdownListener(void (*onShutdown)(void *), void *arg) {
+    if (listenerRunning.load())
+        return true;
+    ThreadManager::onShutdown = onShutdown;
+    onShutdownArg = arg;
+    // Threads launched from now on inherit the mask, only listener receives the signals
+    sigset_t signals;
+    getShutdownSignals(&signals);
+    int ret = pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    if (ret != 0) {
+        DERROR("Fail to block shutdown signals : %s !", strerror(ret));
+        return false;
+    }
+    // Output reader (tee in runMatrice210.sh) is stopped at the same time,
+    // writing shutdown logs must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    pthread_attr_t attr;
+    listenerRunning.store(true);
+    if (!start("shutdownThread", &listenerThreadID, &attr, shutdownListenerThread, nullptr, BACKGROUND)) {
+        listenerRunning.store(false);
+        return false;
+    }
+    return true;
+}
+
+void ThreadManager::requestShutdown(const char *reason) {
+    beginShutdown(reason);
+}
+
+void ThreadManager::stopShutdownListener() {
+    if (!listenerRunning.exchange(false))
+        return;
+    // Listener may still wait for a signal, give it one
+    pthread_kill(listenerThreadID, SIGTERM);
+    stop(&listenerThreadID, "shutdownThread");
+}
+
+void *ThreadManager::shutdownListenerThread(void *param) {
+    (void) param;
+    sigset_t signals;
+    getShutdownSignals(&signals);
+    int signal;
+    while (true) {
+        if (sigwait(&signals, &signal) != 0)
+            continue;
+        // Woken up by stopShutdownListener()
+        if (!listenerRunning.load())
+            break;
+        if (shutdownRequested.load()) {
+            // Shutdown is stuck or user is in a hurry
+            DERROR("%s received again, exit without cleanup", strsignal(signal));
+            _exit(1);
+        }
+        beginShutdown(strsignal(signal));
+    }
+    return nullptr;
+}
+
+void ThreadManager::beginShutdown(const char *reason) {
+    if (shutdownRequested.exchange(true))
+        return;
+    DSTATUS("Shutdown requested : %s", reason);
+    if (onShutdown != nullptr)
+        onShutdown(onShutdownArg);
+}
+
+bool ThreadManager::lockMemory() {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        DERROR("Fail to lock memory : %s !", strerror(errno));
+        DERROR("Run as root or raise RLIMIT_MEMLOCK to avoid page faults in control loop");
+        return false;
+    }
+    DSTATUS("Process memory locked");
+    return true;
+}
+
+const ThreadManager::ProfileSettings &ThreadManager::getProfileSettings(Profile profile) {
+    if (profile < 0 || profile >= PROFILE_COUNT)
+        return profiles[DEFAULT];
+    return profiles[profile];
+}
+
+const char *ThreadManager::applyProfile(pthread_attr_t *attr, const ProfileSettings &settings) {
+    // Smaller than default 8 MiB stacks, all locked in RAM when memory is locked
+    size_t stackSize = settings.stackSize < (size_t)PTHREAD_STACK_MIN ? (size_t)PTHREAD_STACK_MIN : settings.stackSize;
+    if (pthread_attr_setstacksize(attr, stackSize) != 0)
+        return "stack size";
+    if (settings.cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(settings.cpu, &cpus);
+        if (pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpus) != 0)
+            return "CPU affinity";
+    }
+    return nullptr;
 }
@@ -4,20 +4,48 @@
  *  @author Jonathan Michel
  *  @brief This class provides static method to launch thread
  *  and verify everything is fine. Use pthread.h implementation
+ *
+ *  Threads are launched with a profile setting scheduling policy and
+ *  priority, CPU affinity and stack size. Real-time profiles need root
+ *  or CAP_SYS_NICE, if scheduling cannot be set the error is displayed
+ *  and the thread keeps running with default scheduling.
+ *
+ *  Shutdown is cooperative : each thread loops on its own running flag,
+ *  its owner clears the flag, wakes the thread up and joins it with
+ *  stop(), which gives up after a deadline instead of hanging forever.
+ *  SIGINT and SIGTERM (systemctl stop, service restart) are received by
+ *  a dedicated thread, see startShutdownListener().
  */
 
 
 #ifndef MATRICE210_THREADMANAGER_H
 #define MATRICE210_THREADMANAGER_H
 
+#include <atomic>
 #include <pthread.h>
 #include <string>
 
+#define THREAD_JOIN_TIMEOUT_MS 1000 /*!< Default time given to a thread to end once asked to stop [ms] */
+
 using namespace std;
 
 namespace M210 {
     class ThreadManager {
     public:
+        enum Profile {      /*!< Thread profiles, see getProfileSettings() */
+            DEFAULT,        /*!< Inherited scheduling, small stack */
+            CONTROL,        /*!< Real-time, periodic orders sent to aircraft */
+            BACKGROUND,     /*!< Batch scheduling, console and disk writes */
+            PROFILE_COUNT
+        };
+        struct ProfileSettings {
+            const char *name;   /*!< Displayed profile name */
+            int policy;         /*!< Scheduling policy, SCHED_OTHER, SCHED_BATCH or SCHED_FIFO */
+            int priority;       /*!< Real-time priority, 1 to 99, SCHED_FIFO only */
+            int cpu;            /*!< CPU the thread is bound to, -1 for all CPUs */
+            size_t stackSize;   /*!< Stack size [bytes], locked in RAM with process memory */
+        };
+
         /**
          * Create and launch thread
          * @param name Thread name, restricted to 16 characters
@@ -26,17 +54,100 @@ namespace M210 {
        thread
          * @param thread Thread routine declared as follow : void *myThread(void *param)
          * @param arg Will be passed as argument to thread routine
+         * @param profile Scheduling, affinity and stack profile
          * @return True if thread creation and launch works, false otherwise
          */
-        static bool start(string name, pthread_t *tid, pthread_attr_t *attr, void *(*thread)(void *), void *arg);
+        static bool start(string name, pthread_t *tid, pthread_attr_t *attr, void *(*thread)(void *), void *arg,
+                          Profile profile = DEFAULT);
+
+        /**
+         * Set scheduling policy and priority of a profile to a running thread.
+         * Used by start() and for threads not created by ThreadManager
+         * @param id Thread id
+         * @param name Thread name, displayed on error
+         * @param profile Thread profile
+         * @return True if scheduling is set
+         */
+        static bool setScheduling(pthread_t id, const string &name, Profile profile);
+        /**
+         * Wait end of a thread already asked to stop, at most timeoutMs.
+         * Shutdown time is displayed. A thread still running after the
+         * deadline is left running and the error is displayed
+         * @param id Thread id to join
+         * @param name Thread name, displayed
+         * @param timeoutMs Maximal waiting time [ms]
+         * @return True if thread ended in time
+         */
+        static bool stop(const pthread_t *id, const string &name, unsigned long timeoutMs = THREAD_JOIN_TIMEOUT_MS);
+
+        /**
+         * Block SIGINT and SIGTERM and launch the thread waiting for them.
+         * Has to be called by main before any other thread is launched, so
+         * that all threads inherit the signal mask
+         * @param onShutdown Called once by listener thread when shutdown is
+         * requested, has to wake up main thread
+         * @param arg Passed as argument to onShutdown
+         * @return True if listener thread is running
+         */
+        static bool startShutdownListener(void (*onShutdown)(void *), void *arg);
+
+        /**
+         * Request shutdown as if SIGTERM was received. Never blocks
+         * @param reason Displayed reason
+         */
+        static void requestShutdown(const char *reason);
+
+        static bool isShutdownRequested() { return shutdownRequested.load(); }
+
+        /**
+         * Join shutdown listener thread. Called by main during shutdown
+         */
+        static void stopShutdownListener();
+
+        /**
+         * Lock current and future process memory in RAM, so a real-time
+         * thread never waits for a page fault. Must be called at startup,
+         * before threads are launched. Opt-in : threads created by the SDK
+         * keep default 8 MiB stacks, which are locked too
+         * @return True if memory is locked
+         */
+        static bool lockMemory();
+
+        /**
+         * Settings applied by a profile
+         * @param profile Thread profile
+         * @return Profile settings
+         */
+        static const ProfileSettings &getProfileSettings(Profile profile);
+    private:
+        static std::atomic<bool> shutdownRequested;     /*!< Set once, when shutdown starts */
+        static std::atomic<bool> listenerRunning;       /*!< Shutdown listener thread state */
+        static pthread_t listenerThreadID;              /*!< Shutdown listener thread id */
+        static void (*onShutdown)(void *);              /*!< Main thread wake up */
+        static void *onShutdownArg;                     /*!< onShutdown argument */
+
+        /**
+         * Shutdown listener thread, waits for SIGINT or SIGTERM
+         * @param param -
+         * @return -
+         */
+        static void *shutdownListenerThread(void *param);
+
+        /**
+         * Set shutdown flag and call onShutdown, once
+         * @param reason Displayed reason
+         */
+        static void beginShutdown(const char *reason);
+
         /**
-         * Stop thread
-         * Doesn't work - Unused
-         * @param id Thread id to stop
+         * Set thread attributes from profile settings, except scheduling
+         * which is set once thread is created
+         * @param attr Initialized thread attributes
+         * @param settings Profile settings
+         * @return Name of the failed setting, nullptr if all settings are set
          */
-         // todo Doesn't work, to bugfix, unused now
-        static void stop(const pthread_t *id);
+        static const char *applyProfile(pthread_attr_t *attr, const ProfileSettings &settings);
     };
 }
 
-#endif //MATRICE210_THREADMANAGER_H
\ No newline at end of file
+#endif //MATRICE210_THREADMANAGER_H
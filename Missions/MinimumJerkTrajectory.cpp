@@ -0,0 +1,97 @@
+/*! @file MinimumJerkTrajectory.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief MinimumJerkTrajectory.h implementation
+ */
+
+#include "MinimumJerkTrajectory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace M210;
+
+namespace {
+    const double PEAK_VELOCITY_RATIO = 1.875;       /*!< max(s'(u)) */
+    const double PEAK_ACCELERATION_RATIO = 5.7735;  /*!< max(|s''(u)|) */
+}
+
+double MinimumJerkTrajectory::profile(double u) {
+    if(u <= 0.0)
+        return 0.0;
+    if(u >= 1.0)
+        return 1.0;
+    double u3 = u * u * u;
+    return u3 * (10.0 - 15.0 * u + 6.0 * u * u);
+}
+
+void MinimumJerkTrajectory::plan(const Vector3f &offset, float yawOffset,
+                                 float maxVelocity, float maxAcceleration, float maxYawRate) {
+    this->offset = offset;
+    this->yawOffset = yawOffset;
+    double distance = sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+    double yawDistance = fabs(yawOffset);
+    duration = 0.0;
+    if(maxVelocity > 0)
+        duration = std::max(duration, PEAK_VELOCITY_RATIO * distance / maxVelocity);
+    if(maxAcceleration > 0)
+        duration = std::max(duration, sqrt(PEAK_ACCELERATION_RATIO * distance / maxAcceleration));
+    if(maxYawRate > 0)
+        duration = std::max(duration, PEAK_VELOCITY_RATIO * yawDistance / maxYawRate);
+}
+
+void MinimumJerkTrajectory::sample(double time, Vector3f &position, float &yaw) const {
+    double s = duration > 0 ? profile(time / duration) : 1.0;
+    position.x = (float)(offset.x * s);
+    position.y = (float)(offset.y * s);
+    position.z = (float)(offset.z * s);
+    yaw = (float)(yawOffset * s);
+}
+
+void MinimumJerkTrajectory::unitTest() {
+    MinimumJerkTrajectory trajectory;
+    Vector3f position{};
+    float yaw;
+
+    // 10 m at 2 m/s, velocity limited : T = 1.875 * 10 / 2
+    trajectory.plan(Vector3f{6.0, 8.0, 0.0}, 0.0, 2.0, 1.0, 30.0);
+    assert(fabs(trajectory.getDuration() - 9.375) < 1e-6);
+    trajectory.sample(0.0, position, yaw);
+    assert(position.x == 0.0f && position.y == 0.0f);
+    trajectory.sample(trajectory.getDuration() / 2, position, yaw);
+    assert(fabsf(position.x - 3.0f) < 1e-4 && fabsf(position.y - 4.0f) < 1e-4);
+    trajectory.sample(trajectory.getDuration() + 1.0, position, yaw);
+    assert(position.x == 6.0f && position.y == 8.0f);
+
+    // Limits are respected along the trajectory
+    double dt = trajectory.getDuration() / 1000;
+    double previousVelocity = 0.0;
+    Vector3f previous{};
+    for(int i = 1; i <= 1000; i++) {
+        trajectory.sample(i * dt, position, yaw);
+        double dx = position.x - previous.x, dy = position.y - previous.y;
+        double velocity = sqrt(dx * dx + dy * dy) / dt;
+        assert(velocity <= 2.0 + 1e-3);
+        assert(fabs(velocity - previousVelocity) / dt <= 1.0 + 1e-2);
+        previousVelocity = velocity;
+        previous = position;
+    }
+
+    // 1 m, acceleration limited ; 90 deg at 30 deg/s, yaw rate limited
+    trajectory.plan(Vector3f{0.0, 0.0, 1.0}, 0.0, 2.0, 1.0, 30.0);
+    assert(fabs(trajectory.getDuration() - sqrt(5.7735)) < 1e-6);
+    trajectory.plan(Vector3f{0.0, 0.0, 0.0}, -90.0, 2.0, 1.0, 30.0);
+    assert(fabs(trajectory.getDuration() - 5.625) < 1e-6);
+    trajectory.sample(trajectory.getDuration(), position, yaw);
+    assert(yaw == -90.0f);
+
+    // No movement
+    trajectory.plan(Vector3f{0.0, 0.0, 0.0}, 0.0, 2.0, 1.0, 30.0);
+    assert(trajectory.getDuration() == 0.0);
+    trajectory.sample(0.0, position, yaw);
+    assert(position.x == 0.0f && yaw == 0.0f);
+
+    DSTATUS("MinimumJerkTrajectory test passed");
+}
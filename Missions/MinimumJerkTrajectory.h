@@ -0,0 +1,69 @@
+/*! @file MinimumJerkTrajectory.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Time-parameterised minimum-jerk trajectory from rest to rest.
+ *
+ *  Position along the trajectory is start + offset * s(t / T) with
+ *  s(u) = 10u^3 - 15u^4 + 6u^5. Velocity and acceleration are null at
+ *  both ends. Duration T is the shortest one respecting velocity,
+ *  acceleration and yaw rate limits : peak velocity of the profile is
+ *  1.875 D / T and peak acceleration 5.774 D / T^2 for a distance D.
+ *  Yaw follows the same profile.
+ */
+
+#ifndef MATRICE210_MINIMUMJERKTRAJECTORY_H
+#define MATRICE210_MINIMUMJERKTRAJECTORY_H
+
+#include <dji_vehicle.hpp>
+
+using namespace DJI::OSDK;
+using namespace DJI::OSDK::Telemetry;
+
+namespace M210 {
+    class MinimumJerkTrajectory {
+    private:
+        Vector3f offset{};      /*!< Offset from start to end [m] */
+        float yawOffset{0.0};   /*!< Yaw offset from start to end [deg] */
+        double duration{0.0};   /*!< Trajectory duration [s] */
+
+        /**
+         * Normalised position along trajectory
+         * @param u Normalised time, 0 to 1
+         * @return Normalised position, 0 to 1
+         */
+        static double profile(double u);
+    public:
+        /**
+         * Compute trajectory duration from limits
+         * @param offset Offset from start to end [m]
+         * @param yawOffset Yaw offset from start to end [deg]
+         * @param maxVelocity Maximal velocity norm [m/s]
+         * @param maxAcceleration Maximal acceleration norm [m/s^2]
+         * @param maxYawRate Maximal yaw rate [deg/s]
+         */
+        void plan(const Vector3f &offset, float yawOffset,
+                  float maxVelocity, float maxAcceleration, float maxYawRate);
+
+        /**
+         * Offset from start at a given time, held after trajectory end
+         * @param time Time since trajectory start [s]
+         * @param position Offset from start [m]
+         * @param yaw Yaw offset from start [deg]
+         */
+        void sample(double time, Vector3f &position, float &yaw) const;
+
+        /**
+         * @return Trajectory duration [s]
+         */
+        double getDuration() const { return duration; }
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_MINIMUMJERKTRAJECTORY_H
@@ -7,8 +7,12 @@
 
 #include "MonitoredMission.h"
 
+#include <cassert>
+
 #include "../Aircraft/FlightController.h"
+#include "../Action/ActionExecutor.h"
 #include "../Managers/PackageManager.h"
+#include "../Managers/TelemetryCache.h"
 #include "../util/Log.h"
 #include "../util/timer.h"
 
@@ -16,10 +20,19 @@ using namespace M210;
 
 MonitoredMission::MonitoredMission(FlightController *flightController) {
     this->flightController = flightController;
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+MonitoredMission::~MonitoredMission() {
+    abort();
+    pthread_mutex_destroy(&mutex);
 }
 
-bool MonitoredMission::takeOff(int timeout) const {
-    LSTATUS("Take-off launched");
+bool MonitoredMission::start(Procedure procedure, int timeout) {
+    // New command replaces the procedure being monitored
+    abort();
+    if (procedure == TAKE_OFF)
+        LSTATUS("Take-off launched");
 
     /*/ Subscribe to package
             index : 0
@@ -33,156 +46,262 @@ bool MonitoredMission::takeOff(int timeout) const {
     };
     int numTopics = sizeof(topics) / sizeof(topics[0]);
 
-    int pkgIndex = PackageManager::instance().subscribe(topics, numTopics, frequency, false);
-    if (pkgIndex < 0) {
-        LERROR("Take-off - Failed to start package");
+    std::shared_ptr<ActionToken> ready;
+    long long requestTime = getMonotonicNs();
+    int handle = PackageManager::instance().subscribeAsync(topics, numTopics, frequency, false, ready);
+    if (handle < 0) {
+        LERROR(procedure == TAKE_OFF ? "Take-off - Failed to start package" : "Landing - Failed to start package");
         return false;
     }
 
-    // Start take-off
-    ACK::ErrorCode ack = flightController->getVehicle()->control->takeoff(timeout);
+    // Start take-off or landing while packages are started
+    ACK::ErrorCode ack = procedure == TAKE_OFF ?
+                         flightController->getVehicle()->control->takeoff(timeout) :
+                         flightController->getVehicle()->control->land(timeout);
     if (ACK::getError(ack) != ACK::SUCCESS) {
-        LERROR("Start take-off failed");
+        LERROR(procedure == TAKE_OFF ? "Start take-off failed" : "Start landing failed");
         ACK::getErrorCodeMessage(ack, __func__);
-        PackageManager::instance().unsubscribe(pkgIndex);
+        PackageManager::instance().unsubscribeAsync(handle);
         return false;
     }
 
-    // First check: Motors started
-    int motorsNotStarted = 0;
-    int timeoutCycles = 20;
-
-    while (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_FLIGHT>() !=
-           VehicleStatus::FlightStatus::ON_GROUND &&
-            flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-           VehicleStatus::DisplayMode::MODE_ENGINE_START &&
-           motorsNotStarted < timeoutCycles) {
-        motorsNotStarted++;
-        delay_ms(100);
+    pthread_mutex_lock(&mutex);
+    subscription = handle;
+    subscriptionReady = ready;
+    subscriptionTime = requestTime;
+    result = RUNNING;
+    // First step timeout is counted from subscription end, packages may
+    // still be started by AckWorkerPool
+    long long now = getMonotonicNs() / 1000000;
+    if (procedure == TAKE_OFF) {
+        enter(MOTORS_STARTING, now, -1);
+        firstTimeout = motorsTimeout;
+    } else {
+        enter(LANDING_STARTING, now, -1);
+        firstTimeout = landingTimeout;
     }
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
 
-    if (motorsNotStarted == timeoutCycles) {
-        LERROR("Take-off failed. Motors are not spinning");
-        // Cleanup
-        PackageManager::instance().unsubscribe(pkgIndex);
+bool MonitoredMission::update() {
+    // Cheap path, nothing is monitored
+    if (step.load() == IDLE)
         return false;
+    pthread_mutex_lock(&mutex);
+    if (step.load() != IDLE) {
+        ActionToken::State subscribed = subscriptionReady->getState();
+        if (subscribed == ActionToken::SUCCEEDED) {
+            long long now = getMonotonicNs() / 1000000;
+            if (firstTimeout >= 0) {
+                deadline = now + firstTimeout;
+                firstTimeout = -1;
+            }
+            // Flight status and display mode of the same package
+            TelemetryCache::Snapshot telemetry;
+            TelemetryCache::instance().read(telemetry);
+            if (telemetry.isFresh(TelemetryCache::FLIGHT_STATUS, subscriptionTime) &&
+                telemetry.isFresh(TelemetryCache::DISPLAY_MODE, subscriptionTime)) {
+                Result stepResult = advance(telemetry.flightStatus, telemetry.displayMode, now);
+                if (stepResult != RUNNING)
+                    finish(stepResult);
+            } else if (deadline != -1 && now >= deadline) {
+                // A value left by a previous subscription never moves a step on
+                LERROR("Monitoring stopped - No flight status received");
+                finish(FAILED);
+            }
+        } else if (subscribed == ActionToken::FAILED || subscribed == ActionToken::CANCELLED) {
+            LERROR("Monitoring stopped - Failed to start package");
+            finish(FAILED);
+        }
     }
+    bool running = step.load() != IDLE;
+    pthread_mutex_unlock(&mutex);
+    return running;
+}
 
-    // Second check: In air
-    int stillOnGround = 0;
-    timeoutCycles = 110;
-
-    while (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_FLIGHT>() !=
-           VehicleStatus::FlightStatus::IN_AIR &&
-           (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-            VehicleStatus::DisplayMode::MODE_ASSISTED_TAKEOFF ||
-                   flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-            VehicleStatus::DisplayMode::MODE_AUTO_TAKEOFF) &&
-           stillOnGround < timeoutCycles) {
-        stillOnGround++;
-        delay_ms(100);
+void MonitoredMission::abort() {
+    pthread_mutex_lock(&mutex);
+    switch (step.load()) {
+        case IDLE:
+            break;
+        case MOTORS_STARTING:
+        case LIFTING_OFF:
+        case CLIMBING:
+            LSTATUS("Take-off monitoring cancelled");
+            finish(CANCELLED);
+            break;
+        default:
+            LSTATUS("Landing monitoring cancelled");
+            finish(CANCELLED);
+            break;
     }
+    pthread_mutex_unlock(&mutex);
+}
 
-    if (stillOnGround == timeoutCycles) {
-        LERROR("Take-off failed. Aircraft is still on the ground, but the motors are spinning");
-        // Cleanup
-        PackageManager::instance().unsubscribe(pkgIndex);
-        return false;
-    }
+MonitoredMission::Result MonitoredMission::getResult() {
+    pthread_mutex_lock(&mutex);
+    Result current = result;
+    pthread_mutex_unlock(&mutex);
+    return current;
+}
 
-    // Final check: Finished take-off
-    while (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() ==
-           VehicleStatus::DisplayMode::MODE_ASSISTED_TAKEOFF ||
-           flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() ==
-           VehicleStatus::DisplayMode::MODE_AUTO_TAKEOFF) {
-        delay_ms(1000);
+MonitoredMission::Result MonitoredMission::advance(uint8_t flightStatus, uint8_t displayMode, long long now) {
+    bool timedOut = deadline != -1 && now >= deadline;
+    switch (step.load()) {
+        case MOTORS_STARTING:
+            // First check: Motors started
+            if (flightStatus == VehicleStatus::FlightStatus::ON_GROUND ||
+                displayMode == VehicleStatus::DisplayMode::MODE_ENGINE_START) {
+                enter(LIFTING_OFF, now, liftOffTimeout);
+            } else if (timedOut) {
+                LERROR("Take-off failed. Motors are not spinning");
+                return FAILED;
+            }
+            return RUNNING;
+        case LIFTING_OFF:
+            // Second check: In air
+            if (flightStatus == VehicleStatus::FlightStatus::IN_AIR) {
+                enter(CLIMBING, now, -1);
+            } else if (timedOut) {
+                LERROR("Take-off failed. Aircraft is still on the ground, but the motors are spinning");
+                return FAILED;
+            }
+            return RUNNING;
+        case CLIMBING:
+            // Final check: Finished take-off
+            if (displayMode == VehicleStatus::DisplayMode::MODE_ASSISTED_TAKEOFF ||
+                displayMode == VehicleStatus::DisplayMode::MODE_AUTO_TAKEOFF)
+                return RUNNING;
+            if (displayMode != VehicleStatus::DisplayMode::MODE_P_GPS ||
+                displayMode != VehicleStatus::DisplayMode::MODE_ATTITUDE) {
+                LSTATUS("Successful take-off!");
+                return SUCCEEDED;
+            }
+            LERROR("Take-off finished, but the aircraft is in an unexpected mode. Please connect DJI GO");
+            return FAILED;
+        case LANDING_STARTING:
+            // First check: Landing started
+            if (displayMode == VehicleStatus::DisplayMode::MODE_AUTO_LANDING) {
+                enter(DESCENDING, now, -1);
+            } else if (timedOut) {
+                LERROR("Landing failed. Aircraft is still in the air");
+                return FAILED;
+            }
+            return RUNNING;
+        case DESCENDING:
+            // Second check: Finished landing
+            if (displayMode == VehicleStatus::DisplayMode::MODE_AUTO_LANDING &&
+                flightStatus == VehicleStatus::FlightStatus::IN_AIR)
+                return RUNNING;
+            if (displayMode != VehicleStatus::DisplayMode::MODE_P_GPS ||
+                displayMode != VehicleStatus::DisplayMode::MODE_ATTITUDE) {
+                LSTATUS("Successful landing!");
+                return SUCCEEDED;
+            }
+            LERROR("Landing finished, but the aircraft is in an unexpected mode. Please connect DJI GO");
+            return FAILED;
+        default:
+            return result;
     }
+}
 
-    if (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-        VehicleStatus::DisplayMode::MODE_P_GPS ||
-        flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-        VehicleStatus::DisplayMode::MODE_ATTITUDE) {
-        LSTATUS("Successful take-off!");
-    } else {
-        LERROR("Take-off finished, but the aircraft is in an unexpected mode. Please connect DJI GO");
-        PackageManager::instance().unsubscribe(pkgIndex);
-        return false;
+void MonitoredMission::finish(Result result) {
+    this->result = result;
+    step.store(IDLE);
+    deadline = -1;
+    firstTimeout = -1;
+    // Cleanup, called from control loop : removal ACK is not waited for
+    if (subscription >= 0) {
+        PackageManager::instance().unsubscribeAsync(subscription);
+        subscription = -1;
     }
+    subscriptionReady = nullptr;
+}
 
-    // Cleanup
-    PackageManager::instance().unsubscribe(pkgIndex);
-
-    return true;
+void MonitoredMission::enter(Step next, long long now, long timeout) {
+    deadline = timeout < 0 ? -1 : now + timeout;
+    step.store(next);
 }
 
-/**
- *  Monitored landing. Return true if success
-*/
-bool MonitoredMission::landing(int timeout) const {
-    /*/ Subscribe to package
-            index : 0
-            frequency : 10Hz
-            content : flight status and flight mode
-    //*/
-    uint16_t frequency = 10;
-    TopicName topics[] = {
-            TOPIC_STATUS_FLIGHT,
-            TOPIC_STATUS_DISPLAYMODE
-    };
-    int numTopics = sizeof(topics) / sizeof(topics[0]);
-    int pkgIndex = PackageManager::instance().subscribe(topics, numTopics, frequency, false);
-    if (pkgIndex < 0) {
-        LERROR("Landing - Failed to start package");
-        return false;
-    }
+void MonitoredMission::unitTest() {
+    MonitoredMission mission(nullptr);
+    const uint8_t onGround = VehicleStatus::FlightStatus::ON_GROUND;
+    const uint8_t stopped = VehicleStatus::FlightStatus::STOPED;
+    const uint8_t inAir = VehicleStatus::FlightStatus::IN_AIR;
+    const uint8_t gps = VehicleStatus::DisplayMode::MODE_P_GPS;
+    const uint8_t autoTakeOff = VehicleStatus::DisplayMode::MODE_AUTO_TAKEOFF;
+    const uint8_t autoLanding = VehicleStatus::DisplayMode::MODE_AUTO_LANDING;
+    const uint8_t engineStart = VehicleStatus::DisplayMode::MODE_ENGINE_START;
+    long long now = 1000;
 
-    // Start landing
-    ACK::ErrorCode landingStatus = flightController->getVehicle()->control->land(timeout);
-    if (ACK::getError(landingStatus) != ACK::SUCCESS) {
-        LERROR("Start landing failed");
-        ACK::getErrorCodeMessage(landingStatus, __func__);
-        return false;
-    }
+    // Nothing monitored
+    assert(!mission.update());
+    assert(mission.advance(stopped, gps, now) == SUCCEEDED);
 
-    // First check: Landing started
-    int landingNotStarted = 0;
-    int timeoutCycles = 20;
+    // Take-off, each step is left as soon as telemetry says so
+    mission.enter(MOTORS_STARTING, now, mission.motorsTimeout);
+    assert(mission.advance(stopped, gps, now + 100) == RUNNING);
+    assert(mission.getStep() == MOTORS_STARTING);
+    assert(mission.advance(stopped, engineStart, now + 200) == RUNNING);
+    assert(mission.getStep() == LIFTING_OFF);
+    assert(mission.advance(onGround, autoTakeOff, now + 300) == RUNNING);
+    assert(mission.advance(inAir, autoTakeOff, now + 400) == RUNNING);
+    assert(mission.getStep() == CLIMBING);
+    // No timeout while climbing
+    assert(mission.advance(inAir, autoTakeOff, now + 60000) == RUNNING);
+    assert(mission.advance(inAir, gps, now + 60020) == SUCCEEDED);
 
-    while (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-           VehicleStatus::DisplayMode::MODE_AUTO_LANDING &&
-           landingNotStarted < timeoutCycles) {
-        landingNotStarted++;
-        delay_ms(100);
-    }
+    // Motors timeout
+    mission.enter(MOTORS_STARTING, now, mission.motorsTimeout);
+    assert(mission.advance(stopped, gps, now + mission.motorsTimeout - 1) == RUNNING);
+    assert(mission.advance(stopped, gps, now + mission.motorsTimeout) == FAILED);
 
-    if (landingNotStarted == timeoutCycles) {
-        LERROR("Landing failed. Aircraft is still in the air");
-        // Cleanup before return
-        PackageManager::instance().unsubscribe(pkgIndex);
-        return false;
-    }
+    // Lift-off timeout, counted from motors start
+    mission.enter(MOTORS_STARTING, now, mission.motorsTimeout);
+    assert(mission.advance(onGround, engineStart, now + 1000) == RUNNING);
+    assert(mission.advance(onGround, engineStart, now + 1000 + mission.liftOffTimeout - 1) == RUNNING);
+    assert(mission.advance(onGround, engineStart, now + 1000 + mission.liftOffTimeout) == FAILED);
 
-    // Second check: Finished landing
-    while (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() ==
-           VehicleStatus::DisplayMode::MODE_AUTO_LANDING &&
-           flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_FLIGHT>() ==
-           VehicleStatus::FlightStatus::IN_AIR) {
-        delay_ms(1000);
-    }
+    // Landing
+    mission.enter(LANDING_STARTING, now, mission.landingTimeout);
+    assert(mission.advance(inAir, gps, now + 100) == RUNNING);
+    assert(mission.advance(inAir, autoLanding, now + 200) == RUNNING);
+    assert(mission.getStep() == DESCENDING);
+    assert(mission.advance(inAir, autoLanding, now + 30000) == RUNNING);
+    assert(mission.advance(onGround, autoLanding, now + 30020) == SUCCEEDED);
+    mission.enter(LANDING_STARTING, now, mission.landingTimeout);
+    assert(mission.advance(inAir, gps, now + mission.landingTimeout) == FAILED);
 
-    if (flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-        VehicleStatus::DisplayMode::MODE_P_GPS ||
-        flightController->getVehicle()->subscribe->getValue<TOPIC_STATUS_DISPLAYMODE>() !=
-        VehicleStatus::DisplayMode::MODE_ATTITUDE) {
-        LSTATUS("Successful landing!");
-    } else {
-        LERROR("Landing finished, but the aircraft is in an unexpected mode. Please connect DJI GO");
-        PackageManager::instance().unsubscribe(pkgIndex);
-        return false;
-    }
+    // Abort ends monitoring
+    mission.abort();
+    assert(!mission.isRunning());
+    assert(mission.getResult() == CANCELLED);
+    assert(!mission.update());
 
-    // Cleanup
-    PackageManager::instance().unsubscribe(pkgIndex);
+    // Motors timeout is counted once packages are started
+    mission.subscriptionReady = std::make_shared<ActionToken>();
+    mission.result = RUNNING;
+    mission.enter(MOTORS_STARTING, now, -1);
+    mission.firstTimeout = mission.motorsTimeout;
+    assert(mission.update());
+    assert(mission.deadline == -1);
+    mission.subscriptionReady->setState(ActionToken::SUCCEEDED);
+    long long subscribed = getMonotonicNs() / 1000000;
+    assert(mission.update());
+    assert(mission.deadline >= subscribed + mission.motorsTimeout);
+    assert(mission.firstTimeout == -1);
+    mission.abort();
+    assert(mission.getResult() == CANCELLED);
 
-    return true;
+    // Telemetry older than subscription is not used, step times out waiting
+    mission.subscriptionReady = std::make_shared<ActionToken>();
+    mission.subscriptionReady->setState(ActionToken::SUCCEEDED);
+    mission.subscriptionTime = getMonotonicNs();
+    mission.result = RUNNING;
+    mission.enter(MOTORS_STARTING, getMonotonicNs() / 1000000, 0);
+    assert(!mission.update());
+    assert(mission.getResult() == FAILED);
+
+    DSTATUS("MonitoredMission test passed");
 }
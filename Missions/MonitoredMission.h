@@ -3,38 +3,128 @@
  *  @date Jul 25 2018
  *  @author Jonathan Michel
  *  @brief This class provides monitored take-off and landing
- *  implementation. Note that methods are blocking.
+ *  implementation. A procedure is started by start(), which sends the
+ *  command to the aircraft, then followed by update() on each control
+ *  loop tick : flight status and display mode are read once and the
+ *  procedure moves to its next step, or ends on success, failure, timeout
+ *  or abort(). No thread waits for the aircraft during the procedure.
  */
 
 #ifndef MATRICE210_MONITOREDMISSION_H
 #define MATRICE210_MONITOREDMISSION_H
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <pthread.h>
+
 #include <dji_vehicle.hpp>
 
 using namespace DJI::OSDK;
 
 namespace M210 {
     class FlightController;
+    class ActionToken;
 
     class MonitoredMission {
+    public:
+        enum Procedure {        /*!< Monitored procedures */
+            TAKE_OFF,
+            LANDING
+        };
+        enum Step {             /*!< Procedure step, advanced by update() */
+            IDLE,               /*!< No procedure, no subscription */
+            MOTORS_STARTING,    /*!< Take-off sent, waiting for motors */
+            LIFTING_OFF,        /*!< Motors spinning, waiting to be in air */
+            CLIMBING,           /*!< In air, waiting for take-off end */
+            LANDING_STARTING,   /*!< Landing sent, waiting for auto landing mode */
+            DESCENDING          /*!< Auto landing, waiting to be on ground */
+        };
+        enum Result {           /*!< Result of the last procedure */
+            RUNNING,
+            SUCCEEDED,
+            FAILED,
+            CANCELLED
+        };
     private:
         FlightController *flightController;
+        std::atomic<int> step{IDLE};        /*!< Current Step, read without lock by update() */
+        Result result{SUCCEEDED};           /*!< Result of the last procedure */
+        pthread_mutex_t mutex;              /*!< Protect procedure between start(), update() and abort() */
+        long long deadline{-1};             /*!< Absolute time current step fails [ms], -1 if none */
+        long firstTimeout{-1};              /*!< Timeout of first step, counted once telemetry is received [ms], -1 if counting */
+        long motorsTimeout{2000};           /*!< Time given to motors to start [ms] */
+        long liftOffTimeout{11000};         /*!< Time given to aircraft to leave the ground [ms] */
+        long landingTimeout{2000};          /*!< Time given to aircraft to enter auto landing [ms] */
+        int subscription{-1};               /*!< PackageManager subscription handle, -1 if none */
+        long long subscriptionTime{0};      /*!< Monotonic time subscription was requested [ns], older telemetry is ignored */
+        std::shared_ptr<ActionToken> subscriptionReady; /*!< Done once packages are started */
+
+        /**
+         * Move current step on, from telemetry read once
+         * @param flightStatus TOPIC_STATUS_FLIGHT value
+         * @param displayMode TOPIC_STATUS_DISPLAYMODE value
+         * @param now Absolute time [ms]
+         * @return RUNNING while procedure is not finished
+         */
+        Result advance(uint8_t flightStatus, uint8_t displayMode, long long now);
+
+        /**
+         * End procedure, submit subscription release. Called with mutex locked
+         * @param result Procedure result
+         */
+        void finish(Result result);
+
+        /**
+         * Enter a step
+         * @param next New step
+         * @param now Absolute time [ms]
+         * @param timeout Time given to leave the step [ms], -1 for none
+         */
+        void enter(Step next, long long now, long timeout);
     public:
         explicit MonitoredMission(FlightController *flightController);
 
+        ~MonitoredMission();
+
         /**
-         * Monitored take-off. Blocking call
+         * Subscribe to flight status, send take-off or landing command and
+         * start monitoring. Waits only for the command ACK, packages are
+         * started meanwhile by AckWorkerPool. A running procedure is
+         * cancelled first
+         * @param procedure Take-off or landing
          * @param timeout Timeout used on SDK method calls [s]
-         * @return true if success
+         * @return false if subscription or command failed
          */
-        bool takeOff(int timeout = 1) const;
+        bool start(Procedure procedure, int timeout = 1);
 
         /**
-         *  Monitored landing. Blocking call
-         * @param timeout Timeout used on SDK method calls [s]
-         * @return true if success
+         * Follow running procedure, called on each control loop tick.
+         * Telemetry is read once from TelemetryCache, once packages are started.
+         * A step only moves on with flight status and display mode received
+         * after subscription, it keeps waiting for them under its timeout.
+         * Never waits, returns at once if no procedure is running
+         * @return true while a procedure is running
+         */
+        bool update();
+
+        /**
+         * Stop monitoring running procedure, aircraft is not
+         * commanded. Subscription is released
+         */
+        void abort();
+
+        bool isRunning() const { return step.load() != IDLE; }
+
+        Step getStep() const { return (Step)step.load(); }
+
+        Result getResult();
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
          */
-        bool landing(int timeout = 1) const;
+        static void unitTest();
     };
 }
 #endif //MATRICE210_MONITOREDMISSION_H
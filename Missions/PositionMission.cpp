@@ -13,19 +13,19 @@
 
 using namespace M210;
 
-PositionMission::PositionMission(FlightController *flightController) {
+PositionMission::PositionMission(FlightController *flightController) : interpolator(true) {
     this->flightController = flightController;
 }
 
 void PositionMission::move(const Vector3f *position, float yaw) {
     LSTATUS("PositionMission move : x = % .2f m, y = % .2f m, z = % .2f m, % .2f deg",
         position->x, position->y, position->z, yaw);
-    this->position.x = position->x;
-    this->position.y = position->y;
-    this->position.z = position->z;
-    this->yaw = yaw;
+    interpolator.setTarget(*position, yaw, getMonotonicNs());
 }
 
 void PositionMission::update() {
+    Vector3f position{};
+    float yaw;
+    interpolator.sample(getMonotonicNs(), position, yaw);
     flightController->positionAndYawCtrl(&position, yaw);
 }
@@ -12,6 +12,8 @@
 
 #include <dji_vehicle.hpp>
 
+#include "SetpointInterpolator.h"
+
 using namespace DJI;
 using namespace DJI::OSDK;
 using namespace DJI::OSDK::Telemetry;
@@ -22,8 +24,7 @@ namespace M210 {
     class PositionMission {
     private:
         FlightController *flightController;
-        Vector3f position;
-        float yaw;
+        SetpointInterpolator interpolator;  /*!< Upsample setpoints to control rate */
     public:
         explicit PositionMission(FlightController *flightController);
         /**
@@ -39,6 +40,20 @@ namespace M210 {
          * Has to be called continuously
          */
         void update();
+
+        /**
+         * Forget previous setpoints, next one is applied without interpolation.
+         * Has to be called when mission is started
+         */
+        void reset() { interpolator.reset(); }
+
+        /**
+         * Enable or disable setpoints interpolation
+         * @param enable Interpolation state
+         */
+        void setInterpolation(bool enable) { interpolator.setEnabled(enable); }
+
+        bool isInterpolating() const { return interpolator.isEnabled(); }
     };
 }
 
@@ -11,7 +11,9 @@
 
 #include <dji_telemetry.hpp>
 
+#include "../Managers/AckWorkerPool.h"
 #include "../Managers/PackageManager.h"
+#include "../Managers/TelemetryCache.h"
 #include "../Aircraft/FlightController.h"
 #include "../Gps/GpsManip.h"
 #include "../Gps/GpsAxis.h"
@@ -22,119 +24,235 @@ using namespace M210;
 
 PositionOffsetMission::PositionOffsetMission(FlightController *flightController) {
     this->flightController = flightController;
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+PositionOffsetMission::~PositionOffsetMission() {
+    pthread_mutex_destroy(&mutex);
 }
 
 bool PositionOffsetMission::move(const Vector3f *offset, float yaw,
                                  float posThreshold, float yawThreshold) {
-    // Ensure an other mission is not running
-    stop();
     LSTATUS("PositionOffsetMission move : x = % .2f m, y = % .2f m, z = % .2f m, yaw = % .2f deg",
             offset->x, offset->y, offset->z, yaw);
+    pthread_mutex_lock(&mutex);
     vehicle = flightController->getVehicle();
     setOffset(offset, yaw);
     setThreshold(posThreshold, yawThreshold);
 
-    if(!missionRunning) {
-        /*/ Subscribe to package
-                index : 0
-                frequency : 50Hz
-                content : quaternion, fused lat/lon and altitude
-        //*/
-        uint16_t frequency = 50;
-        TopicName topics[] = {
-                TOPIC_QUATERNION,
-                TOPIC_GPS_FUSED
-        };
-        int numTopic = sizeof(topics) / sizeof(topics[0]);
-
-        pkgIndex = PackageManager::instance().subscribe(topics, numTopic, frequency,
-                                                                   false);
-        if (pkgIndex < 0) {
-            LERROR("PositionOffset mission aborted");
-            return false;
-        }
+    bool started = true;
+    switch (phase) {
+        case IDLE:
+            started = startAcquisition();
+            break;
+        case SUBSCRIBING:
+        case ACQUIRING:
+            // Origin is not taken yet, new target is used directly
+            break;
+        case MOVING:
+            // Ensure an other mission is not running, new one starts after braking
+            stop();
+            movePending = true;
+            break;
+        case BRAKING:
+            movePending = true;
+            break;
+    }
+    pthread_mutex_unlock(&mutex);
+
+    // update() has now to be called continuously
 
-        missionRunning = true;
+    return started;
+}
+
+bool PositionOffsetMission::update() {
+    bool destinationReached = false;
+    pthread_mutex_lock(&mutex);
+    switch (phase) {
+        case IDLE:
+        case SUBSCRIBING:
+            break;
+        case ACQUIRING:
+            // Wait for data to come in, origin is never taken from values
+            // of a previous subscription
+            if (getTimeMs() - acquisitionTime >= acquisitionDelay && !startMoving() &&
+                getTimeMs() - acquisitionTime >= acquisitionDelay + missionTimeout) {
+                LERROR("PositionOffset mission aborted - No position received");
+                PackageManager::instance().unsubscribeAsync(handle);
+                phase = IDLE;
+                movePending = false;
+            }
+            break;
+        case MOVING:
+            destinationReached = updateMoving();
+            break;
+        case BRAKING:
+            updateBraking();
+            break;
     }
+    pthread_mutex_unlock(&mutex);
+    return destinationReached;
+}
 
-    startTime = getTimeMs();
+void PositionOffsetMission::abort() {
+    pthread_mutex_lock(&mutex);
+    if (phase != IDLE) {
+        // Topics being subscribed are released by subscription completion
+        if (phase != SUBSCRIBING)
+            PackageManager::instance().unsubscribeAsync(handle);
+        phase = IDLE;
+        movePending = false;
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+PositionOffsetMission::Phase PositionOffsetMission::getPhase() {
+    pthread_mutex_lock(&mutex);
+    Phase current = phase;
+    pthread_mutex_unlock(&mutex);
+    return current;
+}
+
+bool PositionOffsetMission::startAcquisition() {
+    // Subscription and broadcast wait for ACKs, called from action or control loop
+    auto subscription = new Subscription{this, ++acquisitionId, -1};
+    telemetrySince = getMonotonicNs();
+    if (AckWorkerPool::instance().submit("positionOffsetSubscription", subscriptionCall,
+                                         subscriptionDone, subscription) == nullptr) {
+        delete subscription;
+        LERROR("PositionOffset mission aborted");
+        return false;
+    }
+    phase = SUBSCRIBING;
+    return true;
+}
+
+bool PositionOffsetMission::subscriptionCall(void *arg) {
+    auto subscription = static_cast<Subscription *>(arg);
+    /*/ Subscribe to package
+            index : 0
+            frequency : 50Hz
+            content : quaternion, fused lat/lon and altitude
+    //*/
+    uint16_t frequency = 50;
+    TopicName topics[] = {
+            TOPIC_QUATERNION,
+            TOPIC_GPS_FUSED
+    };
+    int numTopic = sizeof(topics) / sizeof(topics[0]);
+
+    int handle = PackageManager::instance().subscribe(topics, numTopic, frequency, false);
+    if (handle < 0)
+        return false;
 
     // Broadcast height is used since relative height through subscription arrived
-    if (!FlightController::startGlobalPositionBroadcast(vehicle))
+    if (!FlightController::startGlobalPositionBroadcast(subscription->mission->vehicle))
     {
         LERROR("Failed to start global position broadcast");
         // Cleanup before return
-        PackageManager::instance().unsubscribe(pkgIndex);
+        PackageManager::instance().unsubscribe(handle);
         return false;
     }
+    subscription->handle = handle;
+    return true;
+}
 
-    // Wait for data to come in
-    delay_ms(500);
+void PositionOffsetMission::subscriptionDone(ActionToken::State state, void *arg) {
+    auto subscription = static_cast<Subscription *>(arg);
+    PositionOffsetMission *mission = subscription->mission;
+    pthread_mutex_lock(&mission->mutex);
+    if (mission->phase == SUBSCRIBING && subscription->id == mission->acquisitionId) {
+        if (state == ActionToken::SUCCEEDED) {
+            mission->handle = subscription->handle;
+            mission->acquisitionTime = getTimeMs();
+            mission->phase = ACQUIRING;
+        } else {
+            LERROR("PositionOffset mission aborted");
+            mission->phase = IDLE;
+            mission->movePending = false;
+        }
+    } else if (subscription->handle >= 0) {
+        // Mission aborted, or restarted, while subscribing
+        PackageManager::instance().unsubscribeAsync(subscription->handle);
+    }
+    pthread_mutex_unlock(&mission->mutex);
+    delete subscription;
+}
 
+namespace {
+    /**
+     * Mission telemetry is valid and was received after a given time
+     * @param telemetry Snapshot read
+     * @param since Monotonic time [ns]
+     */
+    bool isPositionFresh(const TelemetryCache::Snapshot &telemetry, long long since) {
+        return telemetry.isFresh(TelemetryCache::QUATERNION, since) &&
+               telemetry.isFresh(TelemetryCache::GPS_FUSED, since) &&
+               telemetry.isFresh(TelemetryCache::GLOBAL_POSITION, since);
+    }
+}
+
+bool PositionOffsetMission::startMoving() {
+    TelemetryCache::Snapshot telemetry;
+    TelemetryCache::instance().read(telemetry);
+    if (!isPositionFresh(telemetry, telemetrySince))
+        return false;
     // Global position retrieved via subscription
-    Telemetry::TypeMap<TOPIC_GPS_FUSED>::type currentSubscriptionGPS
-        = vehicle->subscribe->getValue<TOPIC_GPS_FUSED>();
-    originGpsPosition = currentSubscriptionGPS;
+    originGpsPosition = telemetry.gpsFused;
 
     resetMissionCounters();
 
-    // Basic receding setpoint position control with the setpoint always x [m] away
-    // from the current position - until aircraft get within a threshold of the goal.
-    // From that point on, the remaining distance is sent as the setpoint
-    if (offset->x > 0)
-        positionToMove.x = (offset->x < setPointDistance) ?
-                           offset->x : setPointDistance;
-    else if (offset->x < 0)
-        positionToMove.x = (offset->x > -1 * setPointDistance) ?
-                           offset->x : -1 * setPointDistance;
-    else
-        positionToMove.x = 0;
-
-    if (offset->y > 0)
-        positionToMove.y = (offset->y < setPointDistance) ?
-                           offset->y : setPointDistance;
-    else if (offset->y < 0)
-        positionToMove.y = (offset->y > -1 * setPointDistance) ?
-                           offset->y : -1 * setPointDistance;
-    else
-        positionToMove.y = 0;
-
     // Get the broadcast global position since we need the height for position z
     // Since subscription cannot give us a relative height, use broadcast.
-    Telemetry::GlobalPosition currentBroadcastGP;
-    currentBroadcastGP = vehicle->broadcast->getGlobalPosition();
-    positionToMove.z = currentBroadcastGP.height + offset->z;
-
-    // update() has now to be called continuously
+    originHeight = telemetry.globalPosition.height;
+    originYaw = (float)(GpsManip::toEulerAngle(telemetry.quaternion).z * RAD2DEG);
+
+    // Receding setpoint starts from offset clamped to setpoint distance
+    positionToMove.x = recedingSetpoint(targetOffset.x, targetOffset.x, setPointDistance);
+    positionToMove.y = recedingSetpoint(targetOffset.y, targetOffset.y, setPointDistance);
+    // Strategy never changes while moving
+    strategy = nextStrategy.load();
+    float yawOffset = (float)remainder(targetYaw - originYaw, 360.0);
+    trajectory.plan(targetOffset, yawOffset, maxVelocity, maxAcceleration, maxYawRate);
+    if (strategy == MINIMUM_JERK)
+        LSTATUS("PositionOffsetMission trajectory : %.1f s", trajectory.getDuration());
+    computeSetpoint(0.0, Vector3f{0.0, 0.0, 0.0});
 
+    startTime = getTimeMs();
+    lastUpdateTime = startTime;
+    phase = MOVING;
     return true;
 }
 
-bool PositionOffsetMission::update() {
-    if(!missionRunning)
-        return false;
-
+bool PositionOffsetMission::updateMoving() {
     bool destinationReached = false;
     // Time management
     long long currentTime = getTimeMs();
     long long elapsedTime = currentTime - startTime;
 
-    if(elapsedTime < missionTimeout) {
-        flightController->positionAndYawCtrl(&positionToMove, (float32_t) targetYaw);
+    long timeout = missionTimeout;
+    if (strategy == MINIMUM_JERK)
+        timeout += (long)(trajectory.getDuration() * 1000);
+
+    if(elapsedTime < timeout) {
+        flightController->positionAndYawCtrl(&positionToMove, (float32_t) yawToMove);
 
         // Calculate duration since last update was made
         long updateDiffTime = long(currentTime - lastUpdateTime);
         lastUpdateTime = currentTime;
 
-        // Get current position in required coordinates and units
-        Telemetry::TypeMap<TOPIC_QUATERNION>::type currentQuaternion
-                = vehicle->subscribe->getValue<TOPIC_QUATERNION>();
-        double currentYaw = GpsManip::toEulerAngle(currentQuaternion).z * RAD2DEG;
-        Telemetry::TypeMap<TOPIC_GPS_FUSED>::type currentGpsPosition
-                = vehicle->subscribe->getValue<TOPIC_GPS_FUSED>();
+        // Get current position in required coordinates and units, attitude and
+        // position of the same package
+        TelemetryCache::Snapshot telemetry;
+        TelemetryCache::instance().read(telemetry);
+        // Offset is not computed from values left once packages are stopped,
+        // orders are kept until telemetry is back or timeout
+        if (!isPositionFresh(telemetry, telemetrySince))
+            return false;
+        double currentYaw = GpsManip::toEulerAngle(telemetry.quaternion).z * RAD2DEG;
 
         Telemetry::Vector3f currentOffset =
-                GpsManip::offsetFromGpsOffset(originGpsPosition, currentGpsPosition);
+                GpsManip::offsetFromGpsOffset(originGpsPosition, telemetry.gpsFused);
 
         Vector2 v{currentOffset.x, currentOffset.y};
         Vector2 projectedV = GpsAxis::instance().revertVector(v);
@@ -144,12 +262,9 @@ bool PositionOffsetMission::update() {
         double yOffsetRemaining = targetOffset.y - projectedV.y;
         double zOffsetRemaining = targetOffset.z - (-currentOffset.z);
 
-        // See if we need to modify the setpoint
-        if (abs(xOffsetRemaining) < setPointDistance)
-            positionToMove.x = (float) xOffsetRemaining;
-
-        if (abs(yOffsetRemaining) < setPointDistance)
-            positionToMove.y = (float) yOffsetRemaining;
+        // Orders sent on next update
+        Vector3f current{(float)projectedV.x, (float)projectedV.y, -currentOffset.z};
+        computeSetpoint(elapsedTime / 1000.0, current);
 
         if (abs(xOffsetRemaining) < posThreshold &&
             abs(yOffsetRemaining) < posThreshold &&
@@ -190,17 +305,63 @@ bool PositionOffsetMission::update() {
 }
 
 void PositionOffsetMission::stop() {
-    if(missionRunning) {
+    if(phase == MOVING) {
         brakeCnt = 0;
-        while (brakeCnt < withinBoundsRequirement) {
-            vehicle->control->emergencyBrake();
-            delay_ms(20);
-            brakeCnt += 20;
-        }
+        lastUpdateTime = getTimeMs();
+        phase = BRAKING;
+        vehicle->control->emergencyBrake();
+    }
+}
 
-        PackageManager::instance().unsubscribe(pkgIndex);
-        missionRunning = false;
+void PositionOffsetMission::updateBraking() {
+    long long currentTime = getTimeMs();
+    brakeCnt += long(currentTime - lastUpdateTime);
+    lastUpdateTime = currentTime;
+    if (brakeCnt < withinBoundsRequirement) {
+        vehicle->control->emergencyBrake();
+        return;
     }
+
+    if (movePending) {
+        // Topics are kept, origin of the pending move is taken after acquisition
+        movePending = false;
+        acquisitionTime = currentTime;
+        telemetrySince = getMonotonicNs();
+        phase = ACQUIRING;
+    } else {
+        PackageManager::instance().unsubscribeAsync(handle);
+        phase = IDLE;
+    }
+}
+
+void PositionOffsetMission::computeSetpoint(double elapsed, const Vector3f &current) {
+    if (strategy == RECEDING) {
+        positionToMove.x = recedingSetpoint(targetOffset.x - current.x, positionToMove.x, setPointDistance);
+        positionToMove.y = recedingSetpoint(targetOffset.y - current.y, positionToMove.y, setPointDistance);
+        positionToMove.z = originHeight + targetOffset.z;
+        yawToMove = targetYaw;
+        return;
+    }
+    Vector3f desired{};
+    float desiredYaw;
+    trajectory.sample(elapsed + trajectoryLead, desired, desiredYaw);
+    // x and y orders are relative to current position, z is absolute height
+    positionToMove.x = desired.x - current.x;
+    positionToMove.y = desired.y - current.y;
+    positionToMove.z = originHeight + desired.z;
+    yawToMove = (float)remainder(originYaw + desiredYaw, 360.0);
+}
+
+float PositionOffsetMission::recedingSetpoint(double remaining, float previous, int setPointDistance) {
+    // Remaining distance is sent once it is smaller than setpoint distance,
+    // otherwise setpoint is kept
+    if (fabs(remaining) < setPointDistance)
+        return (float)remaining;
+    if (previous > setPointDistance)
+        return (float)setPointDistance;
+    if (previous < -setPointDistance)
+        return (float)-setPointDistance;
+    return previous;
 }
 
 void PositionOffsetMission::resetMissionCounters() {
@@ -218,4 +379,84 @@ void PositionOffsetMission::setOffset(const Vector3f* offset, double yaw) {
 void PositionOffsetMission::setThreshold(float posThreshold, double yawThreshold) {
    this->posThreshold = posThreshold;
    this->yawThreshold = yawThreshold;
-}
\ No newline at end of file
+}
+namespace {
+    /**
+     * Position controller of the aircraft on one axis, as modelled for the
+     * benchmark : velocity order proportional to position order, saturated,
+     * reached with a first order lag and an acceleration limit. Position is
+     * measured with a delay. Parameters are estimations, not DJI values
+     */
+    struct SimulatedAxis {
+        const double gain = 1.0;            /*!< Velocity order by position order [1/s] */
+        const double maxVelocity = 3.0;     /*!< [m/s] */
+        const double maxAcceleration = 2.0; /*!< [m/s^2] */
+        const double lag = 0.3;             /*!< Velocity time constant [s] */
+        static const int delaySteps = 5;    /*!< Position measure delay [steps] */
+        double position = 0.0;
+        double velocity = 0.0;
+        double measures[delaySteps] = {};   /*!< Last positions, circular */
+        int step = 0;
+
+        double measure() const { return measures[step % delaySteps]; }
+
+        void update(double order, double dt) {
+            double velocityOrder = order * gain;
+            velocityOrder = velocityOrder > maxVelocity ? maxVelocity :
+                            (velocityOrder < -maxVelocity ? -maxVelocity : velocityOrder);
+            double acceleration = (velocityOrder - velocity) / lag;
+            acceleration = acceleration > maxAcceleration ? maxAcceleration :
+                           (acceleration < -maxAcceleration ? -maxAcceleration : acceleration);
+            velocity += acceleration * dt;
+            position += velocity * dt;
+            measures[step % delaySteps] = position;
+            step++;
+        }
+    };
+}
+
+void PositionOffsetMission::benchmark() {
+    const double dt = 0.02;         // 50 Hz
+    const double maxTime = 60.0;    // [s]
+    const float offsets[] = {1.0, 2.0, 5.0, 10.0, 20.0};
+    const Strategy strategies[] = {RECEDING, MINIMUM_JERK};
+
+    DSTATUS("PositionOffsetMission benchmark, simulated position controller, x axis");
+    for (Strategy strategy : strategies) {
+        for (float distance : offsets) {
+            PositionOffsetMission mission(nullptr);
+            Vector3f offset{distance, 0.0, 0.0};
+            mission.strategy = strategy;
+            mission.setOffset(&offset, 0.0);
+            mission.positionToMove.x = recedingSetpoint(offset.x, offset.x, mission.setPointDistance);
+            mission.positionToMove.y = 0.0;
+            mission.trajectory.plan(offset, 0.0, mission.maxVelocity,
+                                    mission.maxAcceleration, mission.maxYawRate);
+            mission.computeSetpoint(0.0, Vector3f{0.0, 0.0, 0.0});
+
+            SimulatedAxis axis;
+            double overshoot = 0.0;
+            double enterTime = -1.0;    // Time aircraft entered threshold [s]
+            double reachedTime = -1.0;
+            for (double time = dt; time < maxTime && reachedTime < 0; time += dt) {
+                axis.update(mission.positionToMove.x, dt);
+                if (axis.position - distance > overshoot)
+                    overshoot = axis.position - distance;
+                double measured = axis.measure();
+                // Same bounds requirement as update()
+                if (fabs(distance - measured) < mission.posThreshold) {
+                    if (enterTime < 0)
+                        enterTime = time;
+                    if ((time - enterTime) * 1000 >= mission.withinBoundsRequirement)
+                        reachedTime = enterTime;
+                } else {
+                    enterTime = -1.0;
+                }
+                mission.computeSetpoint(time, Vector3f{(float)measured, 0.0, 0.0});
+            }
+            DSTATUS("%-12s %5.1f m : target reached in %5.2f s, overshoot %.2f m",
+                    strategy == RECEDING ? "Receding" : "MinimumJerk", distance,
+                    reachedTime, overshoot);
+        }
+    }
+}
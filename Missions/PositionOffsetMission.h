@@ -3,9 +3,21 @@
  *  @date Jul 05 2018
  *  @author Jonathan Michel
  *  @brief Calculate the inputs to send the position controller.
- *  Basic receding setpoint position control with the setpoint always 2m away
- *  from the current position - until aircraft get within a threshold of the goal.
- *  From that point on, the remaining distance is sent as the setpoint.
+ *  Two strategies are available :
+ *  - RECEDING (default) : basic receding setpoint position control with the
+ *  setpoint always 2m away from the current position - until aircraft get
+ *  within a threshold of the goal. From that point on, the remaining distance
+ *  is sent as the setpoint.
+ *  - MINIMUM_JERK : a minimum-jerk trajectory from current position
+ *  to the goal is planned under velocity and acceleration limits, see
+ *  MinimumJerkTrajectory.h. Each update sends the offset between the
+ *  trajectory, sampled slightly ahead to compensate controller lag, and the
+ *  current position. After trajectory end, remaining distance is sent.
+ *  It has not been flown yet, it is enabled on purpose (console 'o').
+ *  Requests never wait on the aircraft : data acquisition and braking are
+ *  mission phases advanced by update(), on each control loop tick.
+ *  Subscription ACKs are waited for by AckWorkerPool, acquisition starts
+ *  from its completion.
  */
 
 #ifndef MATRICE210_POSITIONOFFSETMISSION_H
@@ -14,6 +26,12 @@
 // DJI OSDK includes
 #include <dji_vehicle.hpp>
 
+#include <atomic>
+#include <pthread.h>
+
+#include "MinimumJerkTrajectory.h"
+#include "../Action/ActionExecutor.h"
+
 using namespace DJI::OSDK;
 using namespace DJI::OSDK::Telemetry;
 
@@ -23,6 +41,18 @@ namespace M210 {
     class FlightController;
 
     class PositionOffsetMission {
+    public:
+        enum Strategy {     /*!< Setpoint generation strategy */
+            RECEDING,
+            MINIMUM_JERK
+        };
+        enum Phase {        /*!< Mission phase, advanced by update() */
+            IDLE,           /*!< No mission, no subscription */
+            SUBSCRIBING,    /*!< Subscription submitted to AckWorkerPool, waiting for its ACKs */
+            ACQUIRING,      /*!< Waiting for telemetry before origin is taken */
+            MOVING,         /*!< Sending position orders */
+            BRAKING         /*!< Sending brake orders, then next move or idle */
+        };
     private:
         FlightController *flightController{nullptr};
         Vehicle *vehicle{nullptr};
@@ -30,33 +60,59 @@ namespace M210 {
         Vector3f targetOffset{};        /*!< Offset desired [m] */
         float targetYaw{0.0};           /*!< yaw desired [deg] */
         Vector3f positionToMove;        /*!< Position orders sent to aircraft [m] */
+        float yawToMove{0.0};           /*!< Yaw order sent to aircraft [deg] */
         // There is a deadband in position control
         // the z cmd is absolute height
         // while x and y are in relative
         float zDeadband{0.12};
         // Mission parameters
-        bool missionRunning{false};         /*!< Prevent mission to be launched multiples times */
-        long missionTimeout{10000};         /*!< Timeout to finish mission [ms] */
+        Phase phase{IDLE};                  /*!< Current mission phase */
+        bool movePending{false};            /*!< A move waits for braking end */
+        pthread_mutex_t mutex;              /*!< Protect mission between requests and update() */
+        long acquisitionDelay{500};         /*!< Time given to telemetry to come in [ms] */
+        long missionTimeout{10000};         /*!< Timeout to finish mission, counted from trajectory end [ms] */
         long outOfBoundsLimit{200};         /*!< Limit time to consider aircraft as out of bounds [ms] */
         long withinBoundsRequirement{1000}; /*!< Requirement time to consider target as reached [ms] */
         int setPointDistance{2};            /*!< Set point distance [m] */
         float posThreshold{0.2};            /*!< Position threshold [m] */
         double yawThreshold{1.0};           /*!< Yaw threshold [deg] */
+        // Trajectory parameters
+        Strategy strategy{RECEDING};        /*!< Setpoint generation strategy of current mission */
+        std::atomic<Strategy> nextStrategy{RECEDING}; /*!< Strategy selected for next missions */
+        float maxVelocity{3.0};             /*!< Trajectory velocity limit [m/s] */
+        float maxAcceleration{1.5};         /*!< Trajectory acceleration limit [m/s^2] */
+        float maxYawRate{30.0};             /*!< Trajectory yaw rate limit [deg/s] */
+        float trajectoryLead{1.0};          /*!< Trajectory is sampled ahead of time to compensate controller lag [s] */
+        MinimumJerkTrajectory trajectory;   /*!< Planned trajectory, from origin position */
+        float originHeight{0.0};            /*!< Height at mission start [m] */
+        float originYaw{0.0};               /*!< Yaw at mission start [deg] */
         // Missions values
         long long startTime{0};         /*!< Mission absolute start time [ms] */
+        long long acquisitionTime{0};   /*!< Absolute time acquisition started [ms] */
+        long long telemetrySince{0};    /*!< Monotonic time acquisition was requested [ns], older telemetry is not used */
         long long lastUpdateTime{0};    /*!< Last absolute time update method was called [ms] */
         long withinBoundsCnt{0};        /*!< Within bounds counter [ms] */
         long outOfBoundsCnt{0};         /*!< Out of bounds counter [ms]*/
         long brakeCnt{0};               /*!< Brake counter [ms] */
         // Subscription
+        struct Subscription {           /*!< AckWorkerPool call argument */
+            PositionOffsetMission *mission;
+            unsigned long id;           /*!< acquisitionId when submitted */
+            int handle;                 /*!< Subscription handle, -1 if none */
+        };
         Telemetry::TypeMap<TOPIC_GPS_FUSED>::type originGpsPosition;
-        int pkgIndex{0};                /*!< Package index used by subscription */
+        int handle{-1};                 /*!< PackageManager subscription handle */
+        unsigned long acquisitionId{0}; /*!< Last submitted subscription, older ones are released on completion */
     public:
         explicit PositionOffsetMission(FlightController *flightController);
 
+        ~PositionOffsetMission();
+
         /**
          * Allows user to move aircraft of an offset from current location.
          * The aircraft will move to that position and stay there.
+         * Returns immediately : if a mission is running, aircraft brakes first
+         * and the new mission starts when braking is done.
          * @param offset Relative offset vector to move [m]
          * Vector is relative to the ground
          * x face to north, y face to east, z face to sky
@@ -73,13 +129,92 @@ namespace M210 {
          * @return true if destination is reached, false otherwise
          */
         bool update();
+
+        /**
+         * Drop mission without braking, used when aircraft is stopped by
+         * other means. Package subscription is released
+         */
+        void abort();
+
+        Phase getPhase();
+
+        /**
+         * Select setpoint generation strategy, applied on next move()
+         * @param strategy Setpoint generation strategy
+         */
+        void setStrategy(Strategy strategy) { nextStrategy.store(strategy); }
+
+        Strategy getStrategy() const { return nextStrategy.load(); }
+
+        /**
+         * Simulate time-to-target of both strategies on a modelled position
+         * controller, for different offsets. Results are displayed on console
+         */
+        static void benchmark();
     private:
+        /**
+         * Compute position and yaw orders
+         * @param elapsed Time since mission start [s]
+         * @param current Current offset from origin [m], z face to sky
+         */
+        void computeSetpoint(double elapsed, const Vector3f &current);
+
+        /**
+         * Receding setpoint on one axis
+         * @param remaining Remaining distance [m]
+         * @param previous Previous setpoint [m]
+         * @param setPointDistance Setpoint distance [m]
+         * @return New setpoint [m]
+         */
+        static float recedingSetpoint(double remaining, float previous, int setPointDistance);
+
         /**
          * Stop aircraft and mission.
-         * Send brake order multiple times
+         * Enter braking phase, brake orders are sent by update()
+         * during withinBoundsRequirement
          */
         void stop();
 
+        /**
+         * Submit telemetry subscription of a new mission, acquisition
+         * starts once it is done. Never blocks
+         * @return false if subscription cannot be submitted
+         */
+        bool startAcquisition();
+
+        /**
+         * AckWorkerPool call, subscribe to package and start broadcast
+         * @param arg Subscription
+         * @return false if subscription or broadcast failed
+         */
+        static bool subscriptionCall(void *arg);
+
+        /**
+         * AckWorkerPool completion, start acquisition or release package
+         * if mission was aborted meanwhile
+         * @param state Call state
+         * @param arg Subscription, deleted
+         */
+        static void subscriptionDone(ActionToken::State state, void *arg);
+
+        /**
+         * Take origin and plan trajectory, once telemetry came in
+         * @return false if quaternion, fused GPS or height were not received since acquisition was requested
+         */
+        bool startMoving();
+
+        /**
+         * Send brake order, finish braking once done
+         */
+        void updateBraking();
+
+        /**
+         * Send position orders and check destination. Destination is
+         * not checked while telemetry is no longer received
+         * @return true if destination is reached, false otherwise
+         */
+        bool updateMoving();
+
         // Mission functions
        /**
          * Reset all mission time counters
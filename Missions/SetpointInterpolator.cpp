@@ -0,0 +1,144 @@
+/*! @file SetpointInterpolator.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief SetpointInterpolator.h implementation
+ */
+
+#include "SetpointInterpolator.h"
+
+#include <cassert>
+#include <cmath>
+
+using namespace M210;
+
+SetpointInterpolator::SetpointInterpolator(bool yawIsAngle) : yawIsAngle(yawIsAngle) {
+    pthread_mutex_init(&mutex, nullptr);
+}
+
+SetpointInterpolator::~SetpointInterpolator() {
+    pthread_mutex_destroy(&mutex);
+}
+
+float SetpointInterpolator::yawDelta(float a, float b) const {
+    float delta = b - a;
+    if(yawIsAngle) {
+        delta = fmodf(delta, 360.0f);
+        if(delta > 180.0f)
+            delta -= 360.0f;
+        else if(delta <= -180.0f)
+            delta += 360.0f;
+    }
+    return delta;
+}
+
+void SetpointInterpolator::setTarget(const Vector3f &setpoint, float yaw, long long nowNs) {
+    pthread_mutex_lock(&mutex);
+    long long interval = nowNs - startTime;
+    if(enabled && initialized && interval < INTERPOLATION_MAX_DURATION_MS * 1000000LL) {
+        // Ramp starts from command currently sent
+        interpolate(nowNs, from, fromYaw);
+        duration = interval;
+    } else {
+        from = setpoint;
+        fromYaw = yaw;
+        duration = 0;
+    }
+    to = setpoint;
+    toYaw = yaw;
+    startTime = nowNs;
+    initialized = true;
+    pthread_mutex_unlock(&mutex);
+}
+
+void SetpointInterpolator::sample(long long nowNs, Vector3f &command, float &yaw) const {
+    pthread_mutex_lock(&mutex);
+    interpolate(nowNs, command, yaw);
+    pthread_mutex_unlock(&mutex);
+}
+
+void SetpointInterpolator::reset() {
+    pthread_mutex_lock(&mutex);
+    initialized = false;
+    pthread_mutex_unlock(&mutex);
+}
+
+void SetpointInterpolator::setEnabled(bool enable) {
+    pthread_mutex_lock(&mutex);
+    enabled = enable;
+    pthread_mutex_unlock(&mutex);
+}
+
+bool SetpointInterpolator::isEnabled() const {
+    pthread_mutex_lock(&mutex);
+    bool enable = enabled;
+    pthread_mutex_unlock(&mutex);
+    return enable;
+}
+
+void SetpointInterpolator::interpolate(long long nowNs, Vector3f &command, float &yaw) const {
+    long long elapsed = nowNs - startTime;
+    if(duration <= 0 || elapsed >= duration) {
+        command = to;
+        yaw = toYaw;
+        return;
+    }
+    float ratio = elapsed <= 0 ? 0.0f : (float)elapsed / (float)duration;
+    command.x = from.x + (to.x - from.x) * ratio;
+    command.y = from.y + (to.y - from.y) * ratio;
+    command.z = from.z + (to.z - from.z) * ratio;
+    yaw = fromYaw + yawDelta(fromYaw, toYaw) * ratio;
+    if(yawIsAngle) {
+        // Keep yaw in ]-180, 180]
+        if(yaw > 180.0f)
+            yaw -= 360.0f;
+        else if(yaw <= -180.0f)
+            yaw += 360.0f;
+    }
+}
+
+void SetpointInterpolator::unitTest() {
+    const long long ms = 1000000;
+    Vector3f command{};
+    float yaw;
+
+    // Disabled until enabled
+    SetpointInterpolator velocity(false);
+    assert(!velocity.isEnabled());
+    velocity.setEnabled(true);
+
+    // First setpoint is applied at once
+    velocity.setTarget(Vector3f{1.0, 0.0, 0.0}, 10.0, 1000 * ms);
+    velocity.sample(1000 * ms, command, yaw);
+    assert(command.x == 1.0f && yaw == 10.0f);
+
+    // Setpoints 100 ms apart, ramp over 100 ms then hold
+    velocity.setTarget(Vector3f{3.0, 0.0, -1.0}, 30.0, 1100 * ms);
+    velocity.sample(1100 * ms, command, yaw);
+    assert(command.x == 1.0f && yaw == 10.0f);
+    velocity.sample(1150 * ms, command, yaw);
+    assert(fabsf(command.x - 2.0f) < 1e-4 && fabsf(command.z + 0.5f) < 1e-4 && fabsf(yaw - 20.0f) < 1e-4);
+    velocity.sample(1300 * ms, command, yaw);
+    assert(command.x == 3.0f && command.z == -1.0f && yaw == 30.0f);
+
+    // Setpoint after a long pause is applied at once
+    velocity.setTarget(Vector3f{0.0, 0.0, 0.0}, 0.0, 2000 * ms);
+    velocity.sample(2000 * ms, command, yaw);
+    assert(command.x == 0.0f && yaw == 0.0f);
+
+    // Yaw angle goes through shortest arc
+    SetpointInterpolator position(true);
+    position.setEnabled(true);
+    position.setTarget(Vector3f{0.0, 0.0, 0.0}, 170.0, 1000 * ms);
+    position.setTarget(Vector3f{0.0, 0.0, 0.0}, -170.0, 1100 * ms);
+    position.sample(1150 * ms, command, yaw);
+    assert(fabsf(fabsf(yaw) - 180.0f) < 1e-3);
+
+    // Disabled interpolation applies setpoints at once
+    position.setEnabled(false);
+    position.setTarget(Vector3f{1.0, 1.0, 1.0}, 0.0, 1200 * ms);
+    position.sample(1200 * ms, command, yaw);
+    assert(command.y == 1.0f && yaw == 0.0f);
+
+    DSTATUS("SetpointInterpolator test passed");
+}
@@ -0,0 +1,111 @@
+/*! @file SetpointInterpolator.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Upsample sparse setpoints into one command by control tick.
+ *
+ *  Mobile sends setpoints slower than the control rate. When a new
+ *  setpoint is set, command moves linearly from its current value to the
+ *  setpoint over the interval measured between the two last setpoints,
+ *  then holds the setpoint. No value is extrapolated.
+ *
+ *  Interpolation delays the full setpoint of at most one setpoint interval,
+ *  bounded by INTERPOLATION_MAX_DURATION_MS. First setpoint after reset()
+ *  and setpoints coming after a long pause are applied at once.
+ *
+ *  Interpolation is disabled by default, console 'i' enables it.
+ *
+ *  Setpoints are set by Action::process thread and sampled by flight
+ *  controller thread, both are protected by a mutex.
+ */
+
+#ifndef MATRICE210_SETPOINTINTERPOLATOR_H
+#define MATRICE210_SETPOINTINTERPOLATOR_H
+
+#include <pthread.h>
+
+#include <dji_vehicle.hpp>
+
+#define INTERPOLATION_MAX_DURATION_MS 200   /*!< Longest ramp between two setpoints [ms] */
+
+using namespace DJI::OSDK;
+using namespace DJI::OSDK::Telemetry;
+
+namespace M210 {
+    class SetpointInterpolator {
+    private:
+        const bool yawIsAngle;      /*!< Yaw is an angle [deg] interpolated on the shortest arc, otherwise a rate */
+        bool enabled{false};        /*!< Interpolation state, setpoints are applied at once if disabled */
+        bool initialized{false};    /*!< A setpoint has been set since reset */
+        Vector3f from{};            /*!< Command when last setpoint has been set */
+        float fromYaw{0.0};
+        Vector3f to{};              /*!< Last setpoint */
+        float toYaw{0.0};
+        long long startTime{0};     /*!< Time last setpoint has been set [ns] */
+        long long duration{0};      /*!< Ramp duration [ns] */
+        mutable pthread_mutex_t mutex;  /*!< Protect setpoints */
+
+        /**
+         * Interpolated command, mutex has to be locked
+         * @param nowNs Monotonic time [ns]
+         * @param command Interpolated command
+         * @param yaw Interpolated yaw
+         */
+        void interpolate(long long nowNs, Vector3f &command, float &yaw) const;
+
+        /**
+         * Yaw difference from a to b
+         * @param a Start yaw
+         * @param b End yaw
+         * @return Difference, in ]-180, 180] deg if yaw is an angle
+         */
+        float yawDelta(float a, float b) const;
+    public:
+        /**
+         * @param yawIsAngle True if yaw is an absolute angle [deg], false if it is a rate
+         */
+        explicit SetpointInterpolator(bool yawIsAngle);
+
+        ~SetpointInterpolator();
+
+        SetpointInterpolator(const SetpointInterpolator &) = delete;
+        SetpointInterpolator &operator=(const SetpointInterpolator &) = delete;
+
+        /**
+         * Start a ramp from current command to a new setpoint
+         * @param setpoint New setpoint
+         * @param yaw New yaw setpoint
+         * @param nowNs Monotonic time [ns]
+         */
+        void setTarget(const Vector3f &setpoint, float yaw, long long nowNs);
+
+        /**
+         * Command to send at a given time
+         * @param nowNs Monotonic time [ns]
+         * @param command Interpolated command
+         * @param yaw Interpolated yaw
+         */
+        void sample(long long nowNs, Vector3f &command, float &yaw) const;
+
+        /**
+         * Forget previous setpoints, next one will be applied at once
+         */
+        void reset();
+
+        /**
+         * Enable or disable interpolation. Takes effect on next setpoint
+         * @param enable Interpolation state
+         */
+        void setEnabled(bool enable);
+
+        bool isEnabled() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_SETPOINTINTERPOLATOR_H
@@ -12,19 +12,19 @@
 
 using namespace M210;
 
-VelocityMission::VelocityMission(FlightController *flightController) {
+VelocityMission::VelocityMission(FlightController *flightController) : interpolator(false) {
     this->flightController = flightController;
 }
 
 void VelocityMission::move(const Vector3f *velocity, float yaw) {
     LSTATUS("VelocityMission move : x = % .2f m/s, y = % .2f m/s, z = % .2f m/s, yaw = % .2f deg/s",
         velocity->x, velocity->y, velocity->z, yaw);
-    this->velocity.x = velocity->x;
-    this->velocity.y = velocity->y;
-    this->velocity.z = velocity->z;
-    this->yaw = yaw;
+    interpolator.setTarget(*velocity, yaw, getMonotonicNs());
 }
 
 void VelocityMission::update() {
+    Vector3f velocity{};
+    float yaw;
+    interpolator.sample(getMonotonicNs(), velocity, yaw);
     flightController->velocityAndYawRateCtrl(&velocity, yaw);
 }
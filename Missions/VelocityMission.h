@@ -11,6 +11,8 @@
 
 #include <dji_vehicle.hpp>
 
+#include "SetpointInterpolator.h"
+
 using namespace DJI;
 using namespace DJI::OSDK;
 using namespace DJI::OSDK::Telemetry;
@@ -21,8 +23,7 @@ namespace M210 {
     class VelocityMission {
     private:
         FlightController *flightController;
-        Vector3f velocity;
-        float yaw;
+        SetpointInterpolator interpolator;  /*!< Upsample setpoints to control rate */
     public:
         explicit VelocityMission(FlightController *flightController);
 
@@ -42,6 +43,20 @@ namespace M210 {
          * aircraft. DJI recommend to send orders at 50Hz
          */
         void update();
+
+        /**
+         * Forget previous setpoints, next one is applied without interpolation.
+         * Has to be called when mission is started
+         */
+        void reset() { interpolator.reset(); }
+
+        /**
+         * Enable or disable setpoints interpolation
+         * @param enable Interpolation state
+         */
+        void setInterpolation(bool enable) { interpolator.setEnabled(enable); }
+
+        bool isInterpolating() const { return interpolator.isEnabled(); }
     };
 }
 
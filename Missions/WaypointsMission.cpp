@@ -14,8 +14,11 @@
 #include "dji_linux_helpers.hpp"
 
 #include "../Aircraft/FlightController.h"
+#include "../Managers/AckWorkerPool.h"
 #include "../Managers/PackageManager.h"
+#include "../Managers/TelemetryCache.h"
 #include "../Action/Action.h"
+#include "../Action/ActionExecutor.h"
 #include "../util/timer.h"
 #include "../util/Log.h"
 
@@ -29,7 +32,7 @@ M210::WaypointMission::WaypointMission(FlightController *flightController) {
     index = 0;
 }
 
-bool M210::WaypointMission::start() {
+bool M210::WaypointMission::start(const ActionToken *token) {
     LSTATUS("Start Waypoints Mission : %u waypoints", index);
     ACK::ErrorCode initAck = flightController->getVehicle()->missionManager->init(
             DJI_MISSION_TYPE::WAYPOINT, 1, &waypointsSettings);
@@ -43,6 +46,10 @@ bool M210::WaypointMission::start() {
 
     // Upload waypoints
     for (auto &wp : waypointsList) {
+        if (ActionToken::cancelled(token)) {
+            LSTATUS("Waypoints mission start cancelled");
+            return false;
+        }
         LSTATUS("Upload Waypoint (Lon Lat Att): %f \t%f \t%f ", wp.latitude,
                 wp.longitude, wp.altitude);
         ACK::WayPointIndex wpDataACK =
@@ -54,6 +61,12 @@ bool M210::WaypointMission::start() {
         }
     }
 
+    // Aircraft may have been stopped during upload
+    if (ActionToken::cancelled(token)) {
+        LSTATUS("Waypoints mission start cancelled");
+        return false;
+    }
+
     // Start mission
     ACK::ErrorCode ack = flightController->getVehicle()->missionManager->wpMission->start(1);
     if (ACK::getError(ack)) {
@@ -88,7 +101,9 @@ void M210::WaypointMission::currentPosition(GlobalPosition &position) {
 
     // Get ultrasonic height in m from broadcast
     // todo get height from subscription package and remove broadcast
-    GlobalPosition globalPosition = flightController->getVehicle()->broadcast->getGlobalPosition();
+    TelemetryCache::Snapshot telemetry;
+    TelemetryCache::instance().read(telemetry);
+    const GlobalPosition &globalPosition = telemetry.globalPosition;
     position.longitude = globalPosition.longitude;
     position.latitude = globalPosition.latitude;
     position.altitude = globalPosition.altitude;
@@ -196,6 +211,17 @@ bool M210::WaypointMission::stop() {
     return true;
 }
 
+bool M210::WaypointMission::stopCall(void *arg) {
+    return static_cast<WaypointMission *>(arg)->stop();
+}
+
+void M210::WaypointMission::stopAsync() {
+    // Verify is mission is initialized
+    if(!isMissionInitialized())
+        return;
+    AckWorkerPool::instance().submit("waypointsStop", stopCall, nullptr, this);
+}
+
 bool M210::WaypointMission::pause() {
     // Verify is mission is initialized
     if(!isMissionInitialized())
@@ -228,28 +254,24 @@ bool M210::WaypointMission::resume() {
     return true;
 }
 
-void M210::WaypointMission::action(unsigned int task) {
+bool M210::WaypointMission::action(unsigned int task, const ActionToken *token) {
     switch (task) {
         case Action::MissionAction::ADD:
-            add();
-            break;
+            return add();
         case Action::MissionAction::RESET:
             reset();
-            break;
+            return true;
         case Action::MissionAction::START:
-            start();
-            break;
+            return start(token);
         case Action::MissionAction::STOP:
-            stop();
-            break;
+            return stop();
         case Action::MissionAction::PAUSE:
-            pause();
-            break;
+            return pause();
         case Action::MissionAction::RESUME:
-            resume();
-            break;
+            return resume();
         default:
             LERROR("Waypoints mission unknown action");
+            return false;
     }
 }
 
@@ -28,6 +28,7 @@ using namespace DJI::OSDK::Telemetry;
 
 namespace M210 {
     class FlightController;
+    class ActionToken;
 
     class WaypointMission {
     private:
@@ -65,10 +66,12 @@ namespace M210 {
         /**
          * Initialize waypoints mission, upload waypoints list
          * and start mission
+         * @param token Checked between waypoints uploads, mission is
+         * not started if cancelled. Can be nullptr
          * @return true is mission has successfully started,
          * false if a problem occurred
          */
-        bool start();
+        bool start(const ActionToken *token);
         /**
          * Pause waypoints mission
          * @return true is mission has successfully been paused,
@@ -87,6 +90,12 @@ namespace M210 {
          * false if a problem occurred
          */
         bool stop();
+        /**
+         * AckWorkerPool call
+         * @param arg Waypoints mission
+         * @return true is mission has successfully been stopped
+         */
+        static bool stopCall(void *arg);
 
     public:
         /**
@@ -97,8 +106,15 @@ namespace M210 {
         /**
          * Modify action flow with a mission task
          * @param task Task to do, value of Action::MissionAction structure
+         * @param token Used by start task, can be nullptr
+         * @return true if task succeeded
+         */
+        bool action(unsigned int task, const ActionToken *token = nullptr);
+        /**
+         * Submit stop order to AckWorkerPool, used when aircraft is
+         * stopped. Never blocks
          */
-        void action(unsigned int task);
+        void stopAsync();
     };
 }
 
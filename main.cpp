@@ -18,6 +18,7 @@
  * \image html img/Full.jpg "UML Full"
 */
 
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -25,16 +26,29 @@
 #include <dji_vehicle.hpp>
 
 #include "Aircraft/FlightController.h"
+#include "Aircraft/TransitionLog.h"
 #include "Action/Action.h"
 #include "Action/ActionData.h"
+#include "Action/ActionDataPool.h"
+#include "Action/ActionExecutor.h"
+#include "Action/ActionJournal.h"
+#include "Action/ControlArbiter.h"
+#include "Managers/AckWorkerPool.h"
 #include "Managers/PackageManager.h"
+#include "Managers/TelemetryCache.h"
+#include "Managers/ThreadManager.h"
 #include "Communication/Console.h"
 #include "Communication/Mobile.h"
 #include "Communication/Uart.h"
 #include "Gps/GeodeticCoord.h"
+#include "Missions/MinimumJerkTrajectory.h"
+#include "Missions/MonitoredMission.h"
+#include "Missions/SetpointInterpolator.h"
+#include "util/EventLoop.h"
+#include "util/Histogram.h"
 #include "util/Log.h"
-
-bool running = true;
+#include "util/PeriodicScheduler.h"
+#include "util/timer.h"
 
 using namespace M210;
 
@@ -42,6 +56,42 @@ FlightController *flightController;
 Console* console;
 Mobile *mobileCommunication;
 
+/**
+ * Called by shutdown listener thread on SIGINT or SIGTERM, makes main loop return
+ * @param arg Event loop of the single-threaded runtime, nullptr with threads
+ */
+static void wakeUpMain(void *arg) {
+    if(arg != nullptr)
+        static_cast<EventLoop *>(arg)->stop();
+    else
+        Action::instance().interrupt();
+}
+
+/**
+ * Stop threads, release aircraft subscriptions and flush logs once main loop
+ * has returned. Each thread is given THREAD_JOIN_TIMEOUT_MS to end.
+ * Aircraft is not commanded : no brake is sent and a running mission is
+ * left to the flight controller
+ * @param uart Uart to stop
+ */
+static void shutdown(Uart &uart) {
+    long long start = getMonotonicNs();
+    flightController->stopFlightControllerThread();
+    if(console != nullptr)
+        console->stopThread();
+    uart.stopRxThread();
+    Action::instance().shutdown();
+    ThreadManager::stopShutdownListener();
+    // Removals not made yet are made by clear()
+    AckWorkerPool::instance().stop();
+    // Packages left on aircraft would be refused to next start
+    PackageManager::instance().clear();
+    ActionJournal::instance().stop();
+    DSTATUS("Shutdown done in %.1f ms", (getMonotonicNs() - start) / 1000000.0);
+    fflush(stdout);
+    fflush(stderr);
+}
+
 /*!
  *  main
  */
@@ -49,13 +99,52 @@ int main(int argc, char** argv)
 {
     // Unit test for action data class
     ActionData::unitTest();
+    ActionDataPool::unitTest();
+    ActionExecutor::unitTest();
+    ActionJournal::unitTest();
+    AckWorkerPool::unitTest();
+    TelemetryCache::unitTest();
+    PackageManager::unitTest();
     Action::unitTest();
+    ControlArbiter::unitTest();
     GeodeticCoord::unitTest();
+    EventLoop::unitTest();
+    Histogram::unitTest();
+    PeriodicScheduler::unitTest();
+    SetpointInterpolator::unitTest();
+    TransitionLog::unitTest();
+    MinimumJerkTrajectory::unitTest();
+    MonitoredMission::unitTest();
     /* Todo add unit tests
      *      - Subscription
      *      - MOC
      */
 
+    // Replay mode, no aircraft needed : matrice210 replay <journal> [fast]
+    if(argc >= 3 && strcmp(argv[1], "replay") == 0) {
+        bool realTime = !(argc >= 4 && strcmp(argv[3], "fast") == 0);
+        return ActionJournal::replayBenchmark(argv[2], realTime) ? 0 : 1;
+    }
+
+    // Single-threaded runtime : matrice210 <console> loop
+    // Action queue, control loop, uart and console are driven by one epoll loop
+    bool loopRuntime = argc >= 3 && strcmp(argv[2], "loop") == 0;
+    // Action journal and memory locking are opt-in : matrice210 <console> [loop] [journal] [lock]
+    bool journal = false;
+    bool lock = false;
+    for(int i = 2; i < argc; i++) {
+        journal |= strcmp(argv[i], "journal") == 0;
+        lock |= strcmp(argv[i], "lock") == 0;
+    }
+    EventLoop loop;
+
+    // Before threads are launched, they inherit the signal mask
+    ThreadManager::startShutdownListener(wakeUpMain, loopRuntime ? &loop : nullptr);
+
+    // Before threads are launched, their stacks are locked too
+    if(lock)
+        ThreadManager::lockMemory();
+
     // Initialize flight controller
     flightController = new FlightController();
     flightController->setupVehicle(argc, argv);
@@ -63,13 +152,22 @@ int main(int argc, char** argv)
     // Singleton configuration
     M210::Log::instance().setFlightController(flightController);
     M210::PackageManager::instance().setVehicle(flightController->getVehicle());
+    M210::TelemetryCache::instance().setVehicle(flightController->getVehicle());
+    // Single worker, calls reach the aircraft in submission order
+    M210::AckWorkerPool::instance().start(1);
     M210::Action::instance().setFlightController(flightController);
+    // Record all actions, see ActionJournal.h to replay them
+    if(journal)
+        M210::ActionJournal::instance().start();
 
     // Console thread
     // If program was called with 1 as argument
-    if(argc == 2 && strtol(argv[1], nullptr, 10)) {
+    if(argc >= 2 && strtol(argv[1], nullptr, 10)) {
         console =  new Console(flightController);
-        console->launchThread();
+        if(!loopRuntime)
+            console->launchThread();
+        else
+            console->attach(loop);
     }
 
     // Mobile-Onboard Communication
@@ -80,17 +178,31 @@ int main(int argc, char** argv)
     // STM32 Communication thread
     Uart uart("/dev/ttyUSB0", 115200);
     uart.setFlightController(flightController);
-    uart.launchRxThread();
+    if(!loopRuntime)
+        uart.launchRxThread();
+    else
+        uart.attach(loop);
     //*/
 
     flightController->obtainCtrlAuthority();
+    if(loopRuntime) {
+        flightController->attach(loop);
+        Action::instance().attach(loop);
+        // Main thread takes the control thread scheduling, it runs the control loop
+        ThreadManager::setScheduling(pthread_self(), "main", ThreadManager::CONTROL);
+        DSTATUS("Single-threaded runtime running...");
+        loop.run();
+        shutdown(uart);
+        return 0;
+    }
     flightController->launchFlightControllerThread();
 
-    while(running) {
+    while(!ThreadManager::isShutdownRequested()) {
         // Process action queue
         Action::instance().process();
         //*/
     }
 
+    shutdown(uart);
     return 0;
 }
\ No newline at end of file
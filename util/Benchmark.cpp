@@ -0,0 +1,48 @@
+/*! @file Benchmark.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Benchmark.h implementation
+ */
+
+#include "Benchmark.h"
+
+#include <algorithm>
+
+#include <dji_vehicle.hpp>
+
+using namespace M210;
+
+Benchmark::Benchmark(const string &name, size_t expectedSamples) : name(name) {
+    samples.reserve(expectedSamples);
+}
+
+void Benchmark::add(long long durationNs) {
+    samples.push_back(durationNs);
+}
+
+long long Benchmark::percentile(double percent) const {
+    if(samples.empty())
+        return 0;
+    vector<long long> sorted(samples);
+    sort(sorted.begin(), sorted.end());
+    auto index = (size_t)(percent / 100.0 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+long long Benchmark::average() const {
+    if(samples.empty())
+        return 0;
+    long long sum = 0;
+    for(long long s : samples)
+        sum += s;
+    return sum / (long long)samples.size();
+}
+
+void Benchmark::print() const {
+    DSTATUS("%s : %u samples, min %.1f us, avg %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us",
+            name.c_str(), (unsigned)samples.size(),
+            percentile(0) / 1000.0, average() / 1000.0,
+            percentile(50) / 1000.0, percentile(99) / 1000.0,
+            percentile(100) / 1000.0);
+}
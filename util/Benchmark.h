@@ -0,0 +1,60 @@
+/*! @file Benchmark.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief This class collects duration samples and displays
+ *  a summary (min, average, percentiles, max) on the console.
+ *
+ *  Used by benchmark methods of the other classes. Samples are
+ *  stored in memory reserved before the measure to avoid
+ *  allocations while measuring.
+ */
+
+#ifndef MATRICE210_BENCHMARK_H
+#define MATRICE210_BENCHMARK_H
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace M210 {
+    class Benchmark {
+    private:
+        string name;                /*!< Displayed benchmark name */
+        vector<long long> samples;  /*!< Measured durations [ns] */
+    public:
+        /**
+         * Create benchmark
+         * @param name Displayed name
+         * @param expectedSamples Number of samples to reserve memory for
+         */
+        explicit Benchmark(const string &name, size_t expectedSamples = 0);
+
+        /**
+         * Add a duration sample
+         * @param durationNs Measured duration [ns]
+         */
+        void add(long long durationNs);
+
+        /**
+         * Return percentile of the samples
+         * @param percent Percentile to compute, 0 to 100
+         * @return Duration [ns], 0 if there is no sample
+         */
+        long long percentile(double percent) const;
+
+        /**
+         * Return average of the samples
+         * @return Average duration [ns], 0 if there is no sample
+         */
+        long long average() const;
+
+        /**
+         * Display samples summary on console [us]
+         */
+        void print() const;
+    };
+}
+
+#endif //MATRICE210_BENCHMARK_H
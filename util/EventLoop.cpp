@@ -0,0 +1,164 @@
+/*! @file EventLoop.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief EventLoop.h implementation
+ */
+
+#include "EventLoop.h"
+
+#include <cassert>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <dji_vehicle.hpp>
+
+#include "Log.h"
+
+using namespace M210;
+
+EventLoop::EventLoop() {
+    for(Source &source : sources)
+        source.fd = -1;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd == -1) {
+        int errsv = errno;  // save error code
+        DERROR("Event loop epoll creation failed, error : %i", errsv);
+    }
+    stopFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(stopFd == -1) {
+        int errsv = errno;  // save error code
+        DERROR("Event loop eventfd creation failed, error : %i", errsv);
+    } else {
+        add(stopFd, EPOLLIN, stopHandler, this);
+    }
+}
+
+EventLoop::~EventLoop() {
+    if(stopFd != -1)
+        close(stopFd);
+    if(epollFd != -1)
+        close(epollFd);
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler handler, void *arg) {
+    if(fd < 0 || epollFd == -1)
+        return false;
+    for(Source &source : sources) {
+        if(source.fd != -1)
+            continue;
+        source.handler = handler;
+        source.arg = arg;
+        struct epoll_event event{};
+        event.events = events;
+        event.data.ptr = &source;
+        if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == -1) {
+            int errsv = errno;  // save error code
+            DERROR("Event loop cannot watch fd %i, error : %i", fd, errsv);
+            return false;
+        }
+        source.fd = fd;
+        return true;
+    }
+    DERROR("Event loop is full, fd %i not added", fd);
+    return false;
+}
+
+bool EventLoop::remove(int fd) {
+    for(Source &source : sources) {
+        if(source.fd == fd) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+            source.fd = -1;
+            return true;
+        }
+    }
+    return false;
+}
+
+void EventLoop::run() {
+    struct epoll_event events[EVENT_LOOP_MAX_SOURCES];
+    while(true) {
+        int ready = epoll_wait(epollFd, events, EVENT_LOOP_MAX_SOURCES, -1);
+        if(ready == -1) {
+            if(errno == EINTR)
+                continue;
+            int errsv = errno;  // save error code
+            DERROR("Event loop wait failed, error : %i", errsv);
+            return;
+        }
+        wakeUps.fetch_add(1, std::memory_order_relaxed);
+        for(int i = 0; i < ready; i++) {
+            auto source = static_cast<Source *>(events[i].data.ptr);
+            // Source may have been removed by a previous handler
+            if(source->fd == -1)
+                continue;
+            dispatched.fetch_add(1, std::memory_order_relaxed);
+            source->handler(source->fd, events[i].events, source->arg);
+        }
+        if(stopping.exchange(false))
+            return;
+    }
+}
+
+void EventLoop::stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    if(write(stopFd, &one, sizeof(one)) != sizeof(one))
+        DERROR("Event loop stop failed");
+}
+
+void EventLoop::stopHandler(int fd, uint32_t events, void *arg) {
+    (void)events;
+    (void)arg;
+    uint64_t value;
+    if(read(fd, &value, sizeof(value)) == -1 && errno != EAGAIN)
+        DERROR("Event loop stop read failed");
+}
+
+namespace {
+    struct TestSource {
+        int count = 0;
+        EventLoop *loop = nullptr;
+    };
+
+    void testHandler(int fd, uint32_t events, void *arg) {
+        auto test = static_cast<TestSource *>(arg);
+        assert(events & EPOLLIN);
+        uint64_t value;
+        assert(read(fd, &value, sizeof(value)) == sizeof(value));
+        test->count += (int)value;
+        if(test->count >= 3)
+            test->loop->stop();
+    }
+}
+
+void EventLoop::unitTest() {
+    EventLoop loop;
+    TestSource test;
+    test.loop = &loop;
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    assert(fd != -1);
+    assert(loop.add(fd, EPOLLIN, testHandler, &test));
+
+    // Handler is called from run(), which returns once stopped
+    uint64_t value = 3;
+    assert(write(fd, &value, sizeof(value)) == sizeof(value));
+    loop.run();
+    assert(test.count == 3);
+    assert(loop.getDispatched() >= 1);
+
+    // Removed source is not watched anymore, stop() before run() returns at once
+    assert(loop.remove(fd));
+    assert(!loop.remove(fd));
+    assert(write(fd, &value, sizeof(value)) == sizeof(value));
+    loop.stop();
+    unsigned long dispatched = loop.getDispatched();
+    loop.run();
+    close(fd);
+    assert(test.count == 3);
+    assert(loop.getDispatched() == dispatched + 1);
+
+    DSTATUS("EventLoop test passed");
+}
@@ -0,0 +1,105 @@
+/*! @file EventLoop.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Single thread epoll loop, used by the single-threaded runtime.
+ *
+ *  Sources are file descriptors (eventfd, timerfd, serial device, stdin)
+ *  registered with a handler. run() waits on epoll and calls the handlers
+ *  of ready sources, one after the other, in the calling thread. Handlers
+ *  must never block : they read what is ready and return.
+ *
+ *  Producers running in other threads (DJI callbacks) only write an
+ *  eventfd, the loop is the only consumer.
+ */
+
+#ifndef MATRICE210_EVENTLOOP_H
+#define MATRICE210_EVENTLOOP_H
+
+#include <atomic>
+#include <cstdint>
+
+#define EVENT_LOOP_MAX_SOURCES 8    /*!< Maximal number of registered file descriptors */
+
+namespace M210 {
+    class EventLoop {
+    public:
+        /**
+         * Called by run() when a source is ready
+         * @param fd Ready file descriptor
+         * @param events Ready epoll events (EPOLLIN, EPOLLERR...)
+         * @param arg Argument given to add()
+         */
+        typedef void (*Handler)(int fd, uint32_t events, void *arg);
+    private:
+        struct Source {
+            int fd;             /*!< Registered file descriptor, -1 if slot is free */
+            Handler handler;    /*!< Called when fd is ready */
+            void *arg;          /*!< Handler argument */
+        };
+        int epollFd;                        /*!< epoll instance */
+        int stopFd;                         /*!< eventfd written by stop() */
+        Source sources[EVENT_LOOP_MAX_SOURCES]; /*!< Registered sources, only modified by loop thread */
+        std::atomic<bool> stopping{false};  /*!< Set by stop(), run() returns after current handlers */
+        std::atomic<unsigned long> wakeUps{0};  /*!< Number of epoll_wait() returns */
+        std::atomic<unsigned long> dispatched{0};   /*!< Number of handlers called */
+
+        static void stopHandler(int fd, uint32_t events, void *arg);
+    public:
+        /**
+         * Create epoll instance and stop eventfd
+         */
+        EventLoop();
+
+        /**
+         * Close epoll instance and stop eventfd. Registered file
+         * descriptors are not closed
+         */
+        ~EventLoop();
+
+        EventLoop(const EventLoop &) = delete;
+        EventLoop &operator=(const EventLoop &) = delete;
+
+        /**
+         * Register a file descriptor
+         * @param fd File descriptor, should be non-blocking
+         * @param events epoll events to wait for, usually EPOLLIN
+         * @param handler Called from run() when fd is ready
+         * @param arg Handler argument
+         * @return false if no slot is free or epoll refused fd
+         */
+        bool add(int fd, uint32_t events, Handler handler, void *arg);
+
+        /**
+         * Unregister a file descriptor
+         * @param fd File descriptor
+         * @return false if fd was not registered
+         */
+        bool remove(int fd);
+
+        /**
+         * Wait for ready sources and call their handlers until stop()
+         * is called. Has to be called from a single thread
+         */
+        void run();
+
+        /**
+         * Make run() return after the handlers being called, or the
+         * next run() if loop is not running. Can be called from any
+         * thread or from a handler
+         */
+        void stop();
+
+        unsigned long getWakeUps() const { return wakeUps.load(); }
+
+        unsigned long getDispatched() const { return dispatched.load(); }
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_EVENTLOOP_H
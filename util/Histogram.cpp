@@ -0,0 +1,104 @@
+/*! @file Histogram.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Histogram.h implementation
+ */
+
+#include "Histogram.h"
+
+#include <cassert>
+
+#include <dji_vehicle.hpp>
+
+using namespace M210;
+
+Histogram::Histogram() {
+    reset();
+}
+
+unsigned Histogram::bucketOf(uint64_t valueUs) {
+    if(valueUs < HISTOGRAM_SUB_BUCKETS)
+        return (unsigned)valueUs;
+    auto magnitude = (unsigned)(63 - __builtin_clzll(valueUs));
+    if(magnitude > HISTOGRAM_MAX_MAGNITUDE)
+        return HISTOGRAM_BUCKETS - 1;
+    // Keep the HISTOGRAM_SUB_BITS bits following the highest one
+    unsigned shift = magnitude - HISTOGRAM_SUB_BITS;
+    auto sub = (unsigned)(valueUs >> shift) - HISTOGRAM_SUB_BUCKETS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint64_t Histogram::lowestValueOf(unsigned bucket) {
+    if(bucket < HISTOGRAM_SUB_BUCKETS)
+        return bucket;
+    unsigned shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    uint64_t sub = bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+    return sub << shift;
+}
+
+void Histogram::record(long long valueNs) {
+    uint64_t valueUs = valueNs > 0 ? (uint64_t)valueNs / 1000 : 0;
+    buckets[bucketOf(valueUs)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(valueUs, std::memory_order_relaxed);
+    uint64_t previous = max.load(std::memory_order_relaxed);
+    while(valueUs > previous && !max.compare_exchange_weak(previous, valueUs, std::memory_order_relaxed));
+}
+
+void Histogram::reset() {
+    for(std::atomic<uint32_t> &bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getAverage() const {
+    uint64_t n = getCount();
+    return n > 0 ? sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+uint64_t Histogram::percentile(double percent) const {
+    uint64_t n = getCount();
+    if(n == 0)
+        return 0;
+    // Rank of the value, first value has rank 1
+    auto rank = (uint64_t)(percent / 100.0 * n + 0.5);
+    if(rank < 1)
+        rank = 1;
+    uint64_t seen = 0;
+    for(unsigned bucket = 0; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if(seen >= rank)
+            return lowestValueOf(bucket);
+    }
+    return getMax();
+}
+
+void Histogram::unitTest() {
+    // Each bucket starts where previous one ends
+    for(unsigned bucket = 1; bucket < HISTOGRAM_BUCKETS; bucket++) {
+        assert(lowestValueOf(bucket) > lowestValueOf(bucket - 1));
+        assert(bucketOf(lowestValueOf(bucket)) == bucket);
+        assert(bucketOf(lowestValueOf(bucket) - 1) == bucket - 1);
+    }
+
+    // 1 to 1000 us, relative precision is better than 1 / HISTOGRAM_SUB_BUCKETS
+    Histogram histogram;
+    for(long long us = 1; us <= 1000; us++)
+        histogram.record(us * 1000);
+    assert(histogram.getCount() == 1000);
+    assert(histogram.getMax() == 1000);
+    assert(histogram.getAverage() == 500);
+    uint64_t p50 = histogram.percentile(50);
+    uint64_t p99 = histogram.percentile(99);
+    assert(p50 <= 500 && p50 >= 500 - 500 / HISTOGRAM_SUB_BUCKETS);
+    assert(p99 <= 990 && p99 >= 990 - 990 / HISTOGRAM_SUB_BUCKETS);
+
+    histogram.reset();
+    assert(histogram.getCount() == 0);
+    assert(histogram.percentile(50) == 0);
+
+    DSTATUS("Histogram test passed");
+}
@@ -0,0 +1,94 @@
+/*! @file Histogram.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Fixed memory latency histogram, HDR style.
+ *
+ *  Values are counted in microseconds in log-linear buckets : each power
+ *  of 2 is split in HISTOGRAM_SUB_BUCKETS buckets, so a recorded value is
+ *  known with a relative precision of about 6 %, from 1 us to about 2 min.
+ *  Recording is lock-free and can be done from any thread, nothing is
+ *  allocated. Counters are not reset atomically, a percentile read while
+ *  values are recorded is approximate.
+ */
+
+#ifndef MATRICE210_HISTOGRAM_H
+#define MATRICE210_HISTOGRAM_H
+
+#include <atomic>
+#include <cstdint>
+
+#define HISTOGRAM_SUB_BITS 4                            /*!< Each power of 2 is split in 2^HISTOGRAM_SUB_BITS buckets */
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS) /*!< Buckets by power of 2 */
+#define HISTOGRAM_MAX_MAGNITUDE 26                      /*!< Highest power of 2 counted, bigger values go in last bucket */
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_MAGNITUDE - HISTOGRAM_SUB_BITS + 2) * HISTOGRAM_SUB_BUCKETS)
+
+namespace M210 {
+    class Histogram {
+    private:
+        std::atomic<uint32_t> buckets[HISTOGRAM_BUCKETS];   /*!< Number of values by bucket */
+        std::atomic<uint64_t> count;                        /*!< Number of recorded values */
+        std::atomic<uint64_t> sum;                          /*!< Sum of recorded values [us] */
+        std::atomic<uint64_t> max;                          /*!< Highest recorded value [us] */
+
+        /**
+         * Bucket of a value
+         * @param valueUs Value [us]
+         * @return Bucket index
+         */
+        static unsigned bucketOf(uint64_t valueUs);
+
+        /**
+         * Lowest value counted by a bucket
+         * @param bucket Bucket index
+         * @return Value [us]
+         */
+        static uint64_t lowestValueOf(unsigned bucket);
+    public:
+        Histogram();
+
+        Histogram(const Histogram &) = delete;
+        Histogram &operator=(const Histogram &) = delete;
+
+        /**
+         * Count a value, negative values are counted as 0
+         * @param valueNs Value [ns]
+         */
+        void record(long long valueNs);
+
+        /**
+         * Set all counters to 0
+         */
+        void reset();
+
+        /**
+         * @return Number of recorded values
+         */
+        uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+
+        /**
+         * @return Highest recorded value [us]
+         */
+        uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+
+        /**
+         * @return Average of recorded values [us], 0 if there is no value
+         */
+        uint64_t getAverage() const;
+
+        /**
+         * Return percentile of recorded values, lowest value of the bucket
+         * @param percent Percentile to compute, 0 to 100
+         * @return Value [us], 0 if there is no value
+         */
+        uint64_t percentile(double percent) const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_HISTOGRAM_H
@@ -0,0 +1,221 @@
+/*! @file PeriodicScheduler.cpp
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief PeriodicScheduler.h implementation
+ */
+
+#include "PeriodicScheduler.h"
+
+#include <cassert>
+#include <cerrno>
+#include <ctime>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <dji_vehicle.hpp>
+
+#include "Log.h"
+#include "timer.h"
+
+using namespace M210;
+
+PeriodicScheduler::PeriodicScheduler(const char *name, long long periodNs) :
+        name(name), period(periodNs) {
+    reset();
+    start();
+}
+
+PeriodicScheduler::~PeriodicScheduler() {
+    if(timerFd != -1)
+        close(timerFd);
+}
+
+void PeriodicScheduler::setPeriod(long long periodNs) {
+    if(periodNs == period.load())
+        return;
+    period.store(periodNs);
+    deadline = lastWakeTime + periodNs;
+    if(timerFd != -1)
+        armTimer();
+}
+
+void PeriodicScheduler::start() {
+    lastWakeTime = getMonotonicNs();
+    deadline = lastWakeTime + period;
+    if(timerFd != -1)
+        armTimer();
+}
+
+int PeriodicScheduler::openTimer() {
+    if(timerFd != -1)
+        return timerFd;
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(timerFd == -1) {
+        int errsv = errno;  // save error code
+        DERROR("%s timer creation failed, error : %i", name, errsv);
+    }
+    return timerFd;
+}
+
+void PeriodicScheduler::armTimer() {
+    // First expiration on the grid, then periodic : the kernel keeps the grid
+    struct itimerspec spec{};
+    spec.it_value.tv_sec = deadline / 1000000000LL;
+    spec.it_value.tv_nsec = deadline % 1000000000LL;
+    spec.it_interval.tv_sec = period.load() / 1000000000LL;
+    spec.it_interval.tv_nsec = period.load() % 1000000000LL;
+    if(timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) == -1) {
+        int errsv = errno;  // save error code
+        DERROR("%s timer setting failed, error : %i", name, errsv);
+    }
+}
+
+void PeriodicScheduler::suspendTimer() {
+    if(timerFd == -1)
+        return;
+    struct itimerspec spec{};
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+}
+
+bool PeriodicScheduler::timerExpired() {
+    uint64_t expirations = 0;
+    // Timer can have been re-armed since it was seen readable
+    if(read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations) || expirations == 0)
+        return true;
+    long long period = this->period.load();
+    cycles++;
+    long long now = getMonotonicNs();
+    long long measured = now - lastWakeTime;
+    if(expirations > 1) {
+        // Loop was busy during whole periods
+        overruns++;
+        overrun.record(now - deadline);
+        missedPeriods += (unsigned long)(expirations - 1);
+        jitter.record(measured - period);
+    } else {
+        jitter.record(measured > period ? measured - period : period - measured);
+    }
+    deadline += (long long)expirations * period;
+    lastWakeTime = now;
+    return expirations == 1;
+}
+
+bool PeriodicScheduler::waitNextPeriod() {
+    long long period = this->period.load();
+    cycles++;
+    long long now = getMonotonicNs();
+    if(now >= deadline) {
+        // Work lasted longer than the period, next cycle starts now
+        overruns++;
+        overrun.record(now - deadline);
+        long long missed = (now - deadline) / period;
+        missedPeriods += (unsigned long)missed;
+        deadline += (missed + 1) * period;
+        jitter.record(now - lastWakeTime - period);
+        lastWakeTime = now;
+        return false;
+    }
+
+    struct timespec ts{};
+    ts.tv_sec = deadline / 1000000000LL;
+    ts.tv_nsec = deadline % 1000000000LL;
+    // Absolute sleep can be resumed as is after a signal
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+
+    now = getMonotonicNs();
+    long long measured = now - lastWakeTime;
+    jitter.record(measured > period ? measured - period : period - measured);
+    lastWakeTime = now;
+    deadline += period;
+    return true;
+}
+
+void PeriodicScheduler::reset() {
+    jitter.reset();
+    overrun.reset();
+    cycles.store(0);
+    overruns.store(0);
+    missedPeriods.store(0);
+}
+
+void PeriodicScheduler::print() const {
+    DSTATUS("%s : period %.1f ms, %lu cycles, %lu overruns, %lu missed periods",
+            name, period.load() / 1000000.0, cycles.load(), overruns.load(), missedPeriods.load());
+    DSTATUS("  Jitter [us]  avg %6lu, p50 %6lu, p90 %6lu, p99 %6lu, max %6lu",
+            (unsigned long)jitter.getAverage(), (unsigned long)jitter.percentile(50),
+            (unsigned long)jitter.percentile(90), (unsigned long)jitter.percentile(99),
+            (unsigned long)jitter.getMax());
+    if(overrun.getCount() != 0) {
+        DSTATUS("  Overrun [us] avg %6lu, p50 %6lu, p90 %6lu, p99 %6lu, max %6lu",
+                (unsigned long)overrun.getAverage(), (unsigned long)overrun.percentile(50),
+                (unsigned long)overrun.percentile(90), (unsigned long)overrun.percentile(99),
+                (unsigned long)overrun.getMax());
+    }
+}
+
+void PeriodicScheduler::sendToMobile() const {
+    // Mobile log messages are limited to 100 characters
+    LSTATUS("%s : %lu cycles, %lu overruns, %lu missed",
+            name, cycles.load(), overruns.load(), missedPeriods.load());
+    LSTATUS("Jitter : p50 %lu us, p99 %lu us, max %lu us",
+            (unsigned long)jitter.percentile(50), (unsigned long)jitter.percentile(99),
+            (unsigned long)jitter.getMax());
+}
+
+void PeriodicScheduler::unitTest() {
+    const long long periodNs = 5000000;
+    PeriodicScheduler scheduler("Test scheduler", periodNs);
+
+    // Work shorter than period does not change the period
+    long long start = getMonotonicNs();
+    for(int i = 0; i < 10; i++) {
+        delay_ms(1);
+        assert(scheduler.waitNextPeriod());
+    }
+    long long elapsed = getMonotonicNs() - start;
+    assert(elapsed >= 10 * periodNs);
+    assert(scheduler.getCycles() == 10);
+    assert(scheduler.getOverruns() == 0);
+    assert(scheduler.getJitter().getCount() == 10);
+
+    // Work of 2.4 periods, at least one whole period is missed
+    delay_ms(12);
+    assert(!scheduler.waitNextPeriod());
+    assert(scheduler.getOverruns() == 1);
+    assert(scheduler.getMissedPeriods() >= 1);
+    assert(scheduler.getOverrun().getCount() == 1);
+
+    // Restart after suspension is not an overrun
+    delay_ms(12);
+    scheduler.start();
+    assert(scheduler.waitNextPeriod());
+    assert(scheduler.getOverruns() == 1);
+
+    // New period applies from last wake up
+    scheduler.setPeriod(2 * periodNs);
+    start = getMonotonicNs();
+    assert(scheduler.waitNextPeriod());
+    assert(getMonotonicNs() - start >= periodNs);
+
+    // Timer follows the same grid, a late read counts missed periods
+    int fd = scheduler.openTimer();
+    assert(fd != -1);
+    scheduler.setPeriod(periodNs);
+    scheduler.reset();
+    scheduler.start();
+    uint64_t expirations;
+    assert(read(fd, &expirations, sizeof(expirations)) == -1);
+    delay_ms(6);
+    assert(scheduler.timerExpired());
+    delay_ms(12);
+    assert(!scheduler.timerExpired());
+    assert(scheduler.getCycles() == 2);
+    assert(scheduler.getOverruns() == 1);
+    assert(scheduler.getMissedPeriods() >= 1);
+    scheduler.suspendTimer();
+    delay_ms(6);
+    assert(read(fd, &expirations, sizeof(expirations)) == -1);
+
+    DSTATUS("PeriodicScheduler test passed");
+}
@@ -0,0 +1,137 @@
+/*! @file PeriodicScheduler.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Absolute time periodic scheduler used by control loops.
+ *
+ *  Wake up times are computed from the start time on CLOCK_MONOTONIC and
+ *  waited with clock_nanosleep(TIMER_ABSTIME), so the period does not
+ *  depend on the duration of the work done between two waits and does not
+ *  drift. If the work lasts longer than a period, the cycle is an overrun :
+ *  next cycle starts immediately, whole missed periods are skipped to stay
+ *  on the time grid.
+ *
+ *  Period jitter (difference between measured and nominal period) and
+ *  overrun durations are counted in Histograms that can be read while
+ *  the scheduler runs.
+ *
+ *  In an event loop, the same time grid is given by a timerfd, see
+ *  openTimer(). timerExpired() is then called instead of waitNextPeriod(),
+ *  periods elapsed before the loop read the timer are counted as missed.
+ */
+
+#ifndef MATRICE210_PERIODICSCHEDULER_H
+#define MATRICE210_PERIODICSCHEDULER_H
+
+#include <atomic>
+
+#include "Histogram.h"
+
+namespace M210 {
+    class PeriodicScheduler {
+    private:
+        const char *name;                   /*!< Displayed scheduler name */
+        std::atomic<long long> period;      /*!< Nominal period [ns] */
+        long long deadline;                 /*!< Next wake up time [ns] */
+        long long lastWakeTime;             /*!< Last time waitNextPeriod() returned [ns] */
+        Histogram jitter;                   /*!< Absolute difference between measured and nominal period */
+        Histogram overrun;                  /*!< Lateness of the overrun cycles */
+        std::atomic<unsigned long> cycles;          /*!< Number of cycles */
+        std::atomic<unsigned long> overruns;        /*!< Number of overrun cycles */
+        std::atomic<unsigned long> missedPeriods;   /*!< Number of skipped periods */
+        int timerFd{-1};                    /*!< Timer armed on the time grid, -1 if not opened */
+
+        /**
+         * Arm timer on the time grid, from deadline
+         */
+        void armTimer();
+    public:
+        /**
+         * Create scheduler, start() has to be called before first wait
+         * @param name Displayed name
+         * @param periodNs Nominal period [ns]
+         */
+        PeriodicScheduler(const char *name, long long periodNs);
+
+        /**
+         * Close timer, if opened
+         */
+        ~PeriodicScheduler();
+
+        PeriodicScheduler(const PeriodicScheduler &) = delete;
+        PeriodicScheduler &operator=(const PeriodicScheduler &) = delete;
+
+        /**
+         * (Re)start time grid now, first period ends one period later.
+         * Must be called after the loop has been suspended, otherwise
+         * the suspension is counted as an overrun
+         */
+        void start();
+
+        /**
+         * Sleep until the end of the current period
+         * @return false if period was already over (overrun), true otherwise
+         */
+        bool waitNextPeriod();
+
+        /**
+         * Create a timerfd following the time grid, started by start().
+         * Used instead of waitNextPeriod() to wait on the grid in an event loop
+         * @return Non-blocking timerfd, -1 on error
+         */
+        int openTimer();
+
+        /**
+         * Disarm timer until next start(), while the loop is suspended
+         */
+        void suspendTimer();
+
+        /**
+         * Read timer and update statistics, once timer fd is readable
+         * @return false if periods were missed (overrun), true otherwise
+         */
+        bool timerExpired();
+
+        /**
+         * Set all statistics to 0
+         */
+        void reset();
+
+        /**
+         * Change period, next period ends one new period after previous wake up.
+         * Must be called from the thread waiting on the scheduler
+         * @param periodNs Nominal period [ns]
+         */
+        void setPeriod(long long periodNs);
+
+        long long getPeriod() const { return period.load(); }
+
+        unsigned long getCycles() const { return cycles.load(); }
+
+        unsigned long getOverruns() const { return overruns.load(); }
+
+        unsigned long getMissedPeriods() const { return missedPeriods.load(); }
+
+        const Histogram &getJitter() const { return jitter; }
+
+        const Histogram &getOverrun() const { return overrun; }
+
+        /**
+         * Display statistics on console [us]
+         */
+        void print() const;
+
+        /**
+         * Send statistics summary to mobile
+         */
+        void sendToMobile() const;
+
+        /**
+         * Unit test to check that class is working. Called at the
+         * beginning of the program. Assert if a test fails
+         */
+        static void unitTest();
+    };
+}
+
+#endif //MATRICE210_PERIODICSCHEDULER_H
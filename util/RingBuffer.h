@@ -0,0 +1,126 @@
+/*! @file RingBuffer.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Bounded lock-free queue with a fixed number of cells.
+ *
+ *  Each cell holds a sequence number telling producers and consumers
+ *  if the cell is free or filled for their current position.
+ *  Positions are reserved with a compare and swap, so multiple
+ *  producers and multiple consumers can use the queue without lock.
+ *  Nothing is allocated after construction.
+ *  Size has to be a power of 2.
+ */
+
+#ifndef MATRICE210_RINGBUFFER_H
+#define MATRICE210_RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#define RING_BUFFER_CACHE_LINE 64   /*!< Used to keep producer and consumer positions on separate cache lines */
+
+namespace M210 {
+    template <typename T, size_t Size>
+    class RingBuffer {
+        static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "RingBuffer size must be a power of 2");
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;   /*!< Cell state relative to queue positions */
+            T data;                         /*!< Stored value */
+        };
+        Cell buffer[Size];                                                  /*!< Queue cells */
+        alignas(RING_BUFFER_CACHE_LINE) std::atomic<size_t> enqueuePos;     /*!< Next position to write */
+        alignas(RING_BUFFER_CACHE_LINE) std::atomic<size_t> dequeuePos;     /*!< Next position to read */
+    public:
+        RingBuffer() {
+            for(size_t i = 0; i < Size; i++)
+                buffer[i].sequence.store(i, std::memory_order_relaxed);
+            enqueuePos.store(0, std::memory_order_relaxed);
+            dequeuePos.store(0, std::memory_order_relaxed);
+        }
+
+        RingBuffer(const RingBuffer &) = delete;
+        RingBuffer &operator=(const RingBuffer &) = delete;
+
+        /**
+         * Add value to queue. Never blocks
+         * @param data Value to add
+         * @return false if queue is full, true otherwise
+         */
+        bool push(const T &data) {
+            Cell *cell;
+            size_t pos = enqueuePos.load(std::memory_order_relaxed);
+            while(true) {
+                cell = &buffer[pos & (Size - 1)];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+                if(diff == 0) {
+                    // Cell is free, try to reserve it
+                    if(enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if(diff < 0) {
+                    // Cell still used by previous lap, queue is full
+                    return false;
+                } else {
+                    // Another producer took this position
+                    pos = enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->data = data;
+            // Publish cell to consumers
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Remove oldest value from queue. Never blocks
+         * @param data Removed value
+         * @return false if queue is empty, true otherwise
+         */
+        bool pop(T &data) {
+            Cell *cell;
+            size_t pos = dequeuePos.load(std::memory_order_relaxed);
+            while(true) {
+                cell = &buffer[pos & (Size - 1)];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+                if(diff == 0) {
+                    // Cell is filled, try to reserve it
+                    if(dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                } else if(diff < 0) {
+                    // Cell not yet written, queue is empty
+                    return false;
+                } else {
+                    // Another consumer took this position
+                    pos = dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+            data = cell->data;
+            // Give cell back to producers for next lap
+            cell->sequence.store(pos + Size, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Approximate number of values in queue, exact when
+         * no other thread is using the queue
+         * @return Number of values
+         */
+        size_t count() const {
+            size_t in = enqueuePos.load(std::memory_order_relaxed);
+            size_t out = dequeuePos.load(std::memory_order_relaxed);
+            return (in > out) ? in - out : 0;
+        }
+
+        /**
+         * Queue capacity
+         * @return Maximal number of values
+         */
+        static constexpr size_t capacity() { return Size; }
+    };
+}
+
+#endif //MATRICE210_RINGBUFFER_H
@@ -0,0 +1,78 @@
+/*! @file SeqLock.h
+ *  @version 1.0
+ *  @date Oct 16 2026
+ *  @author Jonathan Michel
+ *  @brief Value shared by writers with readers that never lock.
+ *
+ *  Value is double buffered. Writer copies the new value in the slot
+ *  readers are not using, then publishes it by incrementing sequence,
+ *  whose low bit is the published slot. Reader copies the published
+ *  slot between two reads of the sequence and starts again only if a
+ *  write has been published meanwhile, as the writer may then be reusing
+ *  the slot. A write in progress never makes readers retry : a real-time
+ *  reader which preempted the writer on its core reads the published
+ *  slot at once instead of spinning until the writer runs again.
+ *  Writers have to be serialized by caller.
+ *  Value has to be trivially copyable, it is copied with memcpy.
+ */
+
+#ifndef MATRICE210_SEQLOCK_H
+#define MATRICE210_SEQLOCK_H
+
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+namespace M210 {
+    template <typename T>
+    class SeqLock {
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock value must be trivially copyable");
+    private:
+        std::atomic<unsigned long> sequence;    /*!< Number of writes, low bit is the published slot */
+        T slots[2];                             /*!< Published value and value being written */
+    public:
+        SeqLock() : sequence(0), slots() {}
+
+        SeqLock(const SeqLock &) = delete;
+        SeqLock &operator=(const SeqLock &) = delete;
+
+        /**
+         * Replace value. Never blocks, callers have to be serialized
+         * @param data New value
+         */
+        void write(const T &data) {
+            unsigned long seq = sequence.load(std::memory_order_relaxed) + 1;
+            // Previous publication is visible before the slot it released is modified
+            std::atomic_thread_fence(std::memory_order_release);
+            memcpy(&slots[seq & 1], &data, sizeof(T));
+            sequence.store(seq, std::memory_order_release);
+        }
+
+        /**
+         * Copy value. Never locks nor waits for a write in progress, copy
+         * is made again if a write has been published during the copy
+         * @param data Consistent copy of value
+         * @return Number of copies made again
+         */
+        unsigned read(T &data) const {
+            unsigned retries = 0;
+            while(true) {
+                unsigned long before = sequence.load(std::memory_order_acquire);
+                memcpy(&data, &slots[before & 1], sizeof(T));
+                // Copy is done before sequence is read again
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == before)
+                    return retries;
+                retries++;
+            }
+        }
+
+        /**
+         * Number of writes, used by readers to know if value changed
+         * @return Write count
+         */
+        unsigned long getWrites() const { return sequence.load(std::memory_order_acquire); }
+    };
+}
+
+#endif //MATRICE210_SEQLOCK_H
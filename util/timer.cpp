@@ -9,6 +9,7 @@
 
 #include <sys/time.h>
 #include <unistd.h>
+#include <ctime>
 
 long long  getTimeMs() {
     struct timeval tp{};
@@ -18,6 +19,12 @@ long long  getTimeMs() {
     return ms;
 }
 
+long long getMonotonicNs() {
+    struct timespec ts{};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 void delay_ms(unsigned int durationMs) {
     usleep(durationMs * 1000);
 }
\ No newline at end of file
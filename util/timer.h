@@ -14,6 +14,13 @@
  */
 long long getTimeMs();
 
+/**
+ * Return current monotonic time. Not affected by system time
+ * changes, use it to measure durations
+ * @return Current monotonic time [ns]
+ */
+long long getMonotonicNs();
+
 /**
  * Thread sleep
  * @param durationMs sleep duration [ms]